@@ -69,6 +69,7 @@ struct Object
     cv::Mat     m_mask;      // object mask (CV_8U type)
     float       m_angle;     // object orientation
     cv::Point3f m_speed;     // changes in image and depth
+    cv::Mat     m_cov;       // covariance of a predicted m_bb (4x4 CV_32F over x, y, width, height), empty if unknown
 };
 
 /**
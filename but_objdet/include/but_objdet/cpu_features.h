@@ -0,0 +1,81 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _CPU_FEATURES_
+#define _CPU_FEATURES_
+
+/**
+ * Kernels using instructions which not every CPU supports (AVX2, POPCNT).
+ *
+ * If built with BUT_OBJDET_AVX2 (the CMake option of the same name), such
+ * kernels are compiled alone for the instructions (BUT_OBJDET_TARGET_AVX2
+ * and BUT_OBJDET_TARGET_POPCNT on the functions), the rest of the code is
+ * compiled for any CPU, and the kernels are called only if the CPU running
+ * the code supports the instructions (cpuHasAvx2, cpuHasPopcnt). Otherwise
+ * BUT_OBJDET_CPU_DISPATCH is not defined and only the portable code is built.
+ *
+ * Code shared by both versions which passes vectors by value (e.g. templates
+ * instantiated for a vector type) is declared BUT_OBJDET_ALWAYS_INLINE,
+ * so that it is compiled as a part of the kernel (vectors are passed
+ * differently in code compiled for AVX).
+ */
+#if defined(BUT_OBJDET_AVX2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define BUT_OBJDET_CPU_DISPATCH 1
+#define BUT_OBJDET_TARGET_AVX2 __attribute__((target("avx2")))
+#define BUT_OBJDET_TARGET_POPCNT __attribute__((target("popcnt")))
+#define BUT_OBJDET_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace but_objdet
+{
+
+/**
+ * True if the CPU supports AVX2.
+ */
+inline bool cpuHasAvx2()
+{
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+    return has;
+}
+
+/**
+ * True if the CPU supports POPCNT.
+ */
+inline bool cpuHasPopcnt()
+{
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("popcnt") != 0);
+    return has;
+}
+
+}
+
+#else
+
+#define BUT_OBJDET_ALWAYS_INLINE inline
+
+#endif
+
+#endif // _CPU_FEATURES_
@@ -0,0 +1,167 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _ASSIGNMENT_
+#define _ASSIGNMENT_
+
+#include <vector>
+
+namespace but_objdet
+{
+
+/**
+ * A sparse cost matrix stored by rows (only the allowed row-column pairs
+ * are stored). Rows are added one by one:
+ *   reset(cols); { addEntry(col, cost)...; endRow(); }...
+ */
+struct SparseCostMatrix
+{
+    int rows; // Number of rows (detections)
+    int cols; // Number of columns (predictions)
+    std::vector<int> rowStart; // Offsets of rows in colIdx/cost (rows + 1)
+    std::vector<int> colIdx; // Column of an entry
+    std::vector<float> cost; // Cost of an entry
+
+    SparseCostMatrix() { reset(0); }
+
+    /**
+     * Removes all entries and sets the number of columns.
+     */
+    void reset(int nCols)
+    {
+        rows = 0;
+        cols = nCols;
+        rowStart.assign(1, 0);
+        colIdx.clear();
+        cost.clear();
+    }
+
+    /**
+     * Adds an entry to the current row.
+     */
+    void addEntry(int col, float c)
+    {
+        colIdx.push_back(col);
+        cost.push_back(c);
+    }
+
+    /**
+     * Closes the current row.
+     */
+    void endRow()
+    {
+        rowStart.push_back(colIdx.size());
+        rows++;
+    }
+};
+
+/**
+ * A solver of the linear assignment problem on a sparse cost matrix.
+ * Each row is assigned either to a distinct column or left unassigned
+ * (for the unassignedCost), so that the total cost is minimal.
+ *
+ * It uses shortest augmenting paths (Jonker-Volgenant / Hungarian method)
+ * with Dijkstra search over the stored entries only, preceded by a greedy
+ * assignment of rows to their cheapest free columns. The working memory is
+ * kept between calls.
+ */
+class AssignmentSolver
+{
+public:
+    AssignmentSolver();
+
+    /**
+     * Solves the assignment problem.
+     * @param costs  Cost matrix (only the stored entries can be assigned).
+     * @param unassignedCost  Cost of leaving a row unassigned.
+     * @param rowToCol  (output) Column assigned to each row (-1 = unassigned).
+     */
+    void solve(const SparseCostMatrix &costs, float unassignedCost, std::vector<int> &rowToCol);
+
+    /**
+     * Solves the assignment problem starting from the given column prices
+     * (warm start). Any prices not higher than 0 give the optimal assignment
+     * (higher prices are clamped), but the prices
+     * of a similar previous problem let the greedy initialization assign
+     * most of the rows, so only the changed rows are searched for.
+     * @param costs  Cost matrix (only the stored entries can be assigned).
+     * @param unassignedCost  Cost of leaving a row unassigned.
+     * @param rowToCol  (output) Column assigned to each row (-1 = unassigned).
+     * @param prices  (input/output) Prices of the columns (costs.cols values,
+     * or empty for zero prices), replaced by the final prices.
+     */
+    void solve(const SparseCostMatrix &costs, float unassignedCost, std::vector<int> &rowToCol,
+               std::vector<float> &prices);
+
+    /**
+     * Number of rows assigned by augmenting paths in the last solve
+     * (i.e. not assigned by the greedy initialization).
+     */
+    int augmentations() const { return freeRows.size(); }
+
+private:
+    /**
+     * Solves the assignment problem (prices = NULL for zero prices).
+     */
+    void solveFrom(const SparseCostMatrix &costs, float unassignedCost, std::vector<int> &rowToCol,
+                   std::vector<float> *prices);
+
+    /**
+     * Finds the shortest augmenting path from a free row and augments
+     * the assignment along it.
+     */
+    void augment(const SparseCostMatrix &costs, float unassignedCost, int row);
+
+    /**
+     * Column with the lowest reduced cost in a row.
+     * @param cost  (output) Cost of the entry of the column.
+     */
+    int cheapestColumn(const SparseCostMatrix &costs, float unassignedCost, int row, float &cost) const;
+
+    /**
+     * Lowers the distance of a column if the new one is shorter.
+     */
+    void relax(int col, float d, int row, float c);
+
+    std::vector<float> v; // Column prices (dual variables)
+    std::vector<int> colToRow; // Row assigned to a column (-1 = free)
+    std::vector<int> assigned; // Column assigned to a row
+    std::vector<float> assignedCost; // Cost of the assigned column
+    std::vector<int> freeRows; // Rows left after the greedy initialization
+
+    // Dijkstra search
+    std::vector<float> dist; // Distance of a column
+    std::vector<int> predRow; // Row from which a column was reached
+    std::vector<float> predCost; // Cost of the entry the column was reached by
+    std::vector<char> scanned; // Column distance is final
+    std::vector<int> touched; // Columns reached during the search
+    std::vector<int> scannedCols; // Columns with final distances
+    std::vector<std::pair<float, int> > heap;
+};
+
+}
+
+#endif // _ASSIGNMENT_
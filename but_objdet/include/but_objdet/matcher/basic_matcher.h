@@ -0,0 +1,409 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _BASIC_MATCHER_
+#define _BASIC_MATCHER_
+
+#include <cmath>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "but_objdet/but_objdet.h"
+#include "but_objdet/matcher/matcher.h"
+#include "but_objdet/matcher/assignment.h"
+#include "but_objdet/matcher/box_overlap.h"
+#include "but_objdet/matcher/depth_index.h"
+#include "but_objdet/matcher/spatial_grid.h"
+
+namespace but_objdet
+{
+
+/*
+ * Policies of BasicMatcher. They are plain structures with inline member
+ * functions, so the matcher can be composed of them at compile time without
+ * any virtual call in the loop over detection-prediction pairs.
+ *
+ * Metric:
+ *   cv::Rect region(const Object &pred) - rectangle of a prediction
+ *     for the broadphase grid
+ *   cv::Rect query(const Object &det) - rectangle of a detection, only
+ *     the predictions with a region intersecting it can be similar
+ *   float score(const Object &det, const Object &pred) - similarity
+ *     (the higher the better), 0 if the pair can not be matched
+ *
+ * Gate:
+ *   enum { BY_CLASS } - nonzero if only the objects of the same class
+ *     pass (the broadphase is then bucketed by class)
+ *   bool operator()(const Object &det, const Object &pred) - the pair
+ *     can be matched
+ *
+ * Assigner:
+ *   void assign(const SparseCostMatrix &costs, std::vector<int> &rowToCol) -
+ *     assigns detections (rows) to predictions (columns), the cost of
+ *     an entry is the negative score
+ */
+
+
+/* -----------------------------------------------------------------------------
+ * Metrics
+ */
+
+/**
+ * Overlapping percentage of bounding boxes (as in MatcherOverlap).
+ */
+struct OverlapMetric
+{
+    /**
+     * @param min  Minimal overlap (in percent) of each of the boxes.
+     */
+    OverlapMetric(float min=50) { setMinOverlap(min); }
+
+    void setMinOverlap(float min) { minOverlap = min; q = BoxOverlap::thresholdQ(min); }
+
+    inline cv::Rect region(const Object &pred) const { return pred.m_bb; }
+    inline cv::Rect query(const Object &det) const { return det.m_bb; }
+
+    inline float score(const Object &det, const Object &pred) const
+    {
+        return BoxOverlap::pairQ(det.m_bb, pred.m_bb, q, minOverlap);
+    }
+
+    float minOverlap;
+    int q; // Rejection threshold of minOverlap (see BoxOverlap::thresholdQ)
+};
+
+/**
+ * IoU (intersection over union, in percent) of bounding boxes.
+ */
+struct IoUMetric
+{
+    /**
+     * @param min  Minimal IoU (in percent).
+     */
+    IoUMetric(float min=50) : minIoU(min) {}
+
+    inline cv::Rect region(const Object &pred) const { return pred.m_bb; }
+    inline cv::Rect query(const Object &det) const { return det.m_bb; }
+
+    inline float score(const Object &det, const Object &pred) const
+    {
+        const cv::Rect &a = det.m_bb, &b = pred.m_bb;
+        if(a.width <= 0 || a.height <= 0 || b.width <= 0 || b.height <= 0) {
+            return 0;
+        }
+        int w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+        int h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+        if(w <= 0 || h <= 0) {
+            return 0;
+        }
+        double common = (double)w * h;
+        double all = (double)a.width * a.height + (double)b.width * b.height - common;
+        float iou = (float)(common * 100 / all);
+        return (iou >= minIoU) ? iou : 0;
+    }
+
+    float minIoU;
+};
+
+/**
+ * Distance of centers of bounding boxes (the score is maxDist - distance,
+ * so the closer the better).
+ */
+struct CenterDistanceMetric
+{
+    /**
+     * @param max  Maximal distance (in pixels) of the centers.
+     */
+    CenterDistanceMetric(float max=50) : maxDist(max) {}
+
+    // The region of a prediction is the square around its center containing
+    // all points within maxDist, a detection is represented by its center
+    inline cv::Rect region(const Object &pred) const
+    {
+        int size = (int)ceil(2 * maxDist) + 2;
+        return cv::Rect((int)floor(centerX(pred) - maxDist), (int)floor(centerY(pred) - maxDist), size, size);
+    }
+    inline cv::Rect query(const Object &det) const
+    {
+        return cv::Rect((int)floor(centerX(det)), (int)floor(centerY(det)), 1, 1);
+    }
+
+    inline float score(const Object &det, const Object &pred) const
+    {
+        float dx = centerX(det) - centerX(pred);
+        float dy = centerY(det) - centerY(pred);
+        float d2 = dx * dx + dy * dy;
+        if(d2 >= maxDist * maxDist) {
+            return 0;
+        }
+        return maxDist - std::sqrt(d2);
+    }
+
+    static inline float centerX(const Object &o) { return o.m_bb.x + 0.5f * o.m_bb.width; }
+    static inline float centerY(const Object &o) { return o.m_bb.y + 0.5f * o.m_bb.height; }
+
+    float maxDist;
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Gates
+ */
+
+/**
+ * Every pair passes.
+ */
+struct NoGate
+{
+    enum { BY_CLASS = 0 };
+    inline bool operator()(const Object &, const Object &) const { return true; }
+};
+
+/**
+ * Objects of the same class (m_class) pass.
+ */
+struct ClassGate
+{
+    enum { BY_CLASS = 1 };
+    inline bool operator()(const Object &det, const Object &pred) const
+    {
+        return det.m_class == pred.m_class;
+    }
+};
+
+/**
+ * Objects whose depths (m_pos_2D.z) differ by at most absTol + relTol * (depth
+ * of the detection) pass. A depth which is not positive is considered unknown
+ * and passes (see DepthIndex).
+ */
+struct DepthGate
+{
+    enum { BY_CLASS = 0 };
+    DepthGate(float abs=0.5f, float rel=0) : absTol(abs), relTol(rel) {}
+
+    inline bool operator()(const Object &det, const Object &pred) const
+    {
+        return DepthIndex::passes(det.m_pos_2D.z, pred.m_pos_2D.z, absTol, relTol);
+    }
+
+    float absTol, relTol;
+};
+
+/**
+ * Objects whose bounding box areas differ at most maxRatio times pass.
+ */
+struct SizeRatioGate
+{
+    enum { BY_CLASS = 0 };
+    SizeRatioGate(float max=2) : maxRatio(max) {}
+
+    inline bool operator()(const Object &det, const Object &pred) const
+    {
+        float a = (float)det.m_bb.width * det.m_bb.height;
+        float b = (float)pred.m_bb.width * pred.m_bb.height;
+        return std::max(a, b) <= maxRatio * std::min(a, b);
+    }
+
+    float maxRatio;
+};
+
+/**
+ * Pairs passing both gates pass (the gates can be nested to combine more).
+ */
+template <class GateA, class GateB>
+struct GateAnd
+{
+    enum { BY_CLASS = GateA::BY_CLASS || GateB::BY_CLASS };
+    GateAnd(const GateA &a=GateA(), const GateB &b=GateB()) : first(a), second(b) {}
+
+    inline bool operator()(const Object &det, const Object &pred) const
+    {
+        return first(det, pred) && second(det, pred);
+    }
+
+    GateA first;
+    GateB second;
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Assigners
+ */
+
+/**
+ * Each detection takes the most similar prediction on its own (a prediction
+ * can be taken by more detections, as in MatcherOverlap). Ties are resolved
+ * in favour of the prediction with the lower index.
+ */
+struct GreedyAssigner
+{
+    inline void assign(const SparseCostMatrix &costs, std::vector<int> &rowToCol)
+    {
+        rowToCol.resize(costs.rows);
+        for(int i = 0; i < costs.rows; i++) {
+            int best = -1;
+            float bestCost = 0;
+            for(int k = costs.rowStart[i]; k < costs.rowStart[i + 1]; k++) {
+                if(costs.cost[k] < bestCost) {
+                    bestCost = costs.cost[k];
+                    best = costs.colIdx[k];
+                }
+            }
+            rowToCol[i] = best;
+        }
+    }
+};
+
+/**
+ * One-to-one assignment maximizing the sum of scores of the matched pairs
+ * (as in MatcherHungarian).
+ */
+struct OptimalAssigner
+{
+    inline void assign(const SparseCostMatrix &costs, std::vector<int> &rowToCol)
+    {
+        solver.solve(costs, 0, rowToCol);
+    }
+
+    AssignmentSolver solver;
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Matcher
+ */
+
+/**
+ * A matcher composed of policies at compile time (see above): a Metric
+ * scoring the detection-prediction pairs, a Gate filtering them and
+ * an Assigner choosing the matches from the scored pairs. The pair loop is
+ * fully inlined. The broadphase grid (bucketed by class if the gate requires
+ * the same class) is built over the regions of predictions given by the metric.
+ *
+ * For example, BasicMatcher<OverlapMetric, ClassGate, GreedyAssigner> gives
+ * the same matches as MatcherOverlap and BasicMatcher<OverlapMetric, ClassGate,
+ * OptimalAssigner> the same as MatcherHungarian.
+ *
+ * It is not derived from Matcher, use BasicMatcherAdapter where a Matcher
+ * is required.
+ */
+template <class Metric, class Gate=ClassGate, class Assigner=OptimalAssigner>
+class BasicMatcher
+{
+public:
+    BasicMatcher(const Metric &m=Metric(), const Gate &g=Gate(), const Assigner &a=Assigner())
+        : metric(m), gate(g), assigner(a)
+    {
+    }
+
+    /**
+     * Matching function (see Matcher::match).
+     */
+    void match(const Objects &detections, const Objects &predictions, Matches &matches)
+    {
+        matches.resize(detections.size());
+
+        regions.resize(predictions.size());
+        for(unsigned int j = 0; j < predictions.size(); j++) {
+            regions[j] = metric.region(predictions[j]);
+        }
+        if(Gate::BY_CLASS) {
+            classGrids.build(predictions, regions);
+        }
+        else {
+            grid.build(regions);
+        }
+
+        // Sparse matrix of the scored pairs (cost = -score)
+        costs.reset(predictions.size());
+        for(unsigned int i = 0; i < detections.size(); i++) {
+            const Object &det = detections[i];
+            if(Gate::BY_CLASS) {
+                classGrids.query(det.m_class, metric.query(det), candidates);
+            }
+            else {
+                grid.query(metric.query(det), candidates);
+            }
+
+            for(unsigned int c = 0; c < candidates.size(); c++) {
+                const Object &pred = predictions[candidates[c]];
+                if(!gate(det, pred)) continue;
+
+                float score = metric.score(det, pred);
+                if(score > 0) {
+                    costs.addEntry(candidates[c], -score);
+                }
+            }
+            costs.endRow();
+        }
+
+        assigner.assign(costs, assignment);
+
+        for(unsigned int i = 0; i < detections.size(); i++) {
+            matches[i].detId = i;
+            matches[i].predId = assignment[i];
+        }
+    }
+
+    Metric metric;
+    Gate gate;
+    Assigner assigner;
+
+private:
+    std::vector<cv::Rect> regions; // Regions of predictions
+    SpatialGrid grid; // Grid over the regions (if not bucketed by class)
+    ClassGrids classGrids; // Grids over the regions by class
+    std::vector<int> candidates; // Candidates of the current detection
+    SparseCostMatrix costs; // Costs of the scored pairs
+    std::vector<int> assignment; // Prediction assigned to each detection
+};
+
+/**
+ * A thin adapter of BasicMatcher to the Matcher interface (a single virtual
+ * call per match, the pair loop stays inlined).
+ */
+template <class Metric, class Gate=ClassGate, class Assigner=OptimalAssigner>
+class BasicMatcherAdapter : public Matcher
+{
+public:
+    BasicMatcherAdapter(const Metric &m=Metric(), const Gate &g=Gate(), const Assigner &a=Assigner())
+        : matcher(m, g, a)
+    {
+    }
+
+	/**
+     * Implementation of the virtual matching function from the Matcher abstract class.
+     */
+    void match(const Objects &detections, const Objects &predictions, Matches &matches)
+    {
+        matcher.match(detections, predictions, matches);
+    }
+
+    BasicMatcher<Metric, Gate, Assigner> matcher;
+};
+
+}
+
+#endif // _BASIC_MATCHER_
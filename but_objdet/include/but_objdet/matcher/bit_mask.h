@@ -0,0 +1,102 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _BIT_MASK_
+#define _BIT_MASK_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "but_objdet/but_objdet.h"
+#include "but_objdet/cpu_features.h"
+
+namespace but_objdet
+{
+
+/**
+ * An object mask cropped to its bounding box and packed to bits (64 pixels
+ * per word). Words are aligned to absolute image coordinates (word k of a row
+ * holds pixels 64k..64k+63), so the rows of two masks can be combined word
+ * by word without any shifting and the intersection is counted by popcount.
+ */
+class BitMask
+{
+public:
+    BitMask();
+
+    /**
+     * Packs the mask of an object. The mask (Object::m_mask, CV_8U, nonzero =
+     * object) either covers the whole image, or it is anchored at the top-left
+     * corner of the bounding box (if it is not large enough to contain the
+     * whole bounding box in image coordinates). Only the pixels inside
+     * the bounding box are packed.
+     * @param object  Object whose mask is packed.
+     * @return  False if the object has no mask.
+     */
+    bool pack(const Object &object);
+
+    /**
+     * Number of object pixels.
+     */
+    int count() const { return pixels; }
+
+    /**
+     * Number of object pixels in both masks (counted by the POPCNT
+     * instruction if built with BUT_OBJDET_AVX2 and the CPU supports it).
+     */
+    int intersection(const BitMask &other) const;
+
+    /**
+     * Number of set bits in a word.
+     */
+    static BUT_OBJDET_ALWAYS_INLINE int popcount(uint64 x)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(x);
+#else
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+
+private:
+    /**
+     * Number of object pixels in both masks (the loop of intersection,
+     * compiled both with and without POPCNT).
+     */
+    int countCommon(const BitMask &other) const;
+    int countCommonPopcnt(const BitMask &other) const;
+
+    int top, rows; // Rows of the mask (in image coordinates)
+    int word0, words; // The first word of a row (in image coordinates) and words per row
+    int pixels; // Number of object pixels
+    std::vector<uint64> bits; // rows * words
+};
+
+}
+
+#endif // _BIT_MASK_
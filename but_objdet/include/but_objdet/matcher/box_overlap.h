@@ -0,0 +1,167 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _BOX_OVERLAP_
+#define _BOX_OVERLAP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "but_objdet/but_objdet.h"
+
+namespace but_objdet
+{
+
+/**
+ * Bounding boxes stored as a structure of arrays (left/top/right/bottom
+ * coordinates and areas), which is the input of the batched overlap kernels.
+ */
+struct BoxArray
+{
+    std::vector<int> x0, y0; // Left X and top Y coordinates
+    std::vector<int> x1, y1; // Right X and bottom Y coordinates (exclusive)
+    std::vector<int> area; // Area of a box (0 for degenerate boxes)
+    int maxArea; // The largest area in the array
+
+    BoxArray() { clear(); }
+
+    /**
+     * Removes all boxes (the memory is kept).
+     */
+    void clear();
+
+    /**
+     * Appends a box.
+     */
+    void push_back(const cv::Rect &bb);
+
+    /**
+     * Replaces the content by bounding boxes (m_bb) of the objects.
+     */
+    void assign(const Objects &objects);
+
+    /**
+     * Number of boxes.
+     */
+    int size() const { return x0.size(); }
+};
+
+/**
+ * Batched computation of the overlapping percentage of bounding boxes
+ * (as defined by MatcherOverlap: the smaller one of the percentages of both
+ * boxes which is overlapped, or 0 if it is less than minOverlap% for any
+ * of them).
+ *
+ * The pairs overlapping clearly less than minOverlap% are rejected by integer
+ * cross-multiplication, the percentage of the others is computed with a single
+ * division per pair and compared with minOverlap in float (the same comparison
+ * as the original MatcherOverlap, so any threshold gives the same results).
+ * If built with AVX2 kernels (BUT_OBJDET_AVX2)
+ * and run on a CPU supporting AVX2, 8 pairs are processed at once,
+ * otherwise a scalar version is used.
+ * Degenerate boxes (zero or negative width or height) never overlap.
+ */
+class BoxOverlap
+{
+public:
+    /**
+     * Overlapping percentage of a single pair of boxes (inline, so that
+     * the pair loops of BasicMatcher are not calling out of line).
+     */
+    static inline float pair(const cv::Rect &det, const cv::Rect &pred, float minOverlap)
+    {
+        return pairQ(det, pred, thresholdQ(minOverlap), minOverlap);
+    }
+
+    /**
+     * Overlapping percentage of a single pair of boxes.
+     * @param q  Rejection threshold of minOverlap (see thresholdQ).
+     * @param minOverlap  Minimal overlap (in percent) of each of the boxes.
+     */
+    static inline float pairQ(const cv::Rect &det, const cv::Rect &pred, int q, float minOverlap)
+    {
+        if(det.width <= 0 || det.height <= 0 || pred.width <= 0 || pred.height <= 0) {
+            return 0;
+        }
+
+        // Size of the overlapped region
+        int w = std::min(det.x + det.width, pred.x + pred.width) - std::max(det.x, pred.x);
+        int h = std::min(det.y + det.height, pred.y + pred.height) - std::max(det.y, pred.y);
+        if(w <= 0 || h <= 0) {
+            return 0;
+        }
+
+        // overlap / area < q / 1000 (less than minOverlap - 0.1%)
+        int64 overlapArea = (int64)w * h;
+        int64 detArea = (int64)det.width * det.height;
+        int64 predArea = (int64)pred.width * pred.height;
+        if(overlapArea * 1000 < (int64)q * detArea || overlapArea * 1000 < (int64)q * predArea) {
+            return 0;
+        }
+
+        // The smaller percentage belongs to the larger box
+        float overlapped = ((float)overlapArea * 100) / (float)std::max(detArea, predArea);
+        return (overlapped >= minOverlap) ? overlapped : 0;
+    }
+
+    /**
+     * Overlapping percentages of one box and the boxes of an array.
+     * @param det  A box (typically of a detection).
+     * @param preds  An array of boxes (typically of predictions).
+     * @param idx  Positions of the boxes in preds to be processed
+     * (NULL = the first n boxes).
+     * @param n  Number of boxes to be processed.
+     * @param minOverlap  Minimal overlap (in percent) of each of the boxes.
+     * @param out  (output) n overlapping percentages.
+     */
+    static void row(const cv::Rect &det, const BoxArray &preds, const int *idx, int n,
+                    float minOverlap, float *out);
+
+    /**
+     * Overlapping percentages of all pairs of boxes from two arrays.
+     * @param dets  An array of N boxes (typically of detections).
+     * @param preds  An array of M boxes (typically of predictions).
+     * @param minOverlap  Minimal overlap (in percent) of each of the boxes.
+     * @param out  (output) NxM matrix (CV_32F) of overlapping percentages.
+     */
+    static void matrix(const BoxArray &dets, const BoxArray &preds, float minOverlap, cv::Mat &out);
+
+    /**
+     * Rejection threshold of the integer test in tenths of percent, at least
+     * 0.1% under minOverlap (a pair overlapping less can not pass the float
+     * comparison), clamped to [0, 1001].
+     */
+    static inline int thresholdQ(float minOverlap)
+    {
+        float q = floor(minOverlap * 10) - 1;
+        return (int)std::max(0.0f, std::min(q, 1001.0f));
+    }
+};
+
+}
+
+#endif // _BOX_OVERLAP_
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _DEPTH_INDEX_
+#define _DEPTH_INDEX_
+
+#include <cmath>
+#include <map>
+#include <vector>
+#include "but_objdet/but_objdet.h"
+
+namespace but_objdet
+{
+
+/**
+ * Objects (typically predictions) sorted by depth (m_pos_2D.z) in buckets
+ * by their class, used to reject the detection-prediction pairs which are
+ * too far from each other in depth before any overlap is computed.
+ *
+ * A pair passes if the depths differ by at most absTol + relTol * z, where
+ * z is the depth of the detection (so the tolerance can grow with the depth
+ * as the depth noise does). A depth which is not positive is unknown and
+ * such an object always passes.
+ */
+class DepthIndex
+{
+public:
+    /**
+     * @param absTol  Absolute tolerance (in the units of m_pos_2D.z).
+     * @param relTol  Tolerance relative to the depth of the detection.
+     */
+    DepthIndex(float absTol=0.5f, float relTol=0);
+
+    /**
+     * Sets the tolerance.
+     * @param absTol  Absolute tolerance (in the units of m_pos_2D.z).
+     * @param relTol  Tolerance relative to the depth of the detection.
+     */
+    void setTolerance(float absTol, float relTol=0);
+
+    /**
+     * Builds the index.
+     * @param objects  Objects to be indexed.
+     */
+    void build(const Objects &objects);
+
+    /**
+     * Number of the objects of the given class passing with a detection
+     * at the given depth (O(log M)).
+     */
+    int count(int objClass, float z) const;
+
+    /**
+     * Finds the objects of the given class passing with a detection
+     * at the given depth.
+     * @param objClass  Class of the objects.
+     * @param z  Depth of the detection.
+     * @param candidates  (output) Indices of the objects (sorted in ascending
+     * order).
+     */
+    void query(int objClass, float z, std::vector<int> &candidates) const;
+
+    /**
+     * Removes the candidates which do not pass with a detection at the given
+     * depth (candidates of other classes are kept). If there are less
+     * objects of the class passing than the candidates, they replace
+     * the candidates, so only the class and depth filtered candidates are
+     * returned (sorted in ascending order).
+     * @param objClass  Class of the detection.
+     * @param z  Depth of the detection.
+     * @param candidates  (input/output) Indices of the indexed objects
+     * (sorted in ascending order).
+     */
+    void prune(int objClass, float z, std::vector<int> &candidates) const;
+
+    /**
+     * Tests if a pair passes the depth gate.
+     */
+    static inline bool passes(float zDet, float zPred, float absTol, float relTol)
+    {
+        return zDet <= 0 || zPred <= 0 || std::fabs(zDet - zPred) <= absTol + relTol * zDet;
+    }
+
+private:
+    /**
+     * Objects of one class sorted by depth.
+     */
+    struct Bucket
+    {
+        std::vector<std::pair<float, int> > sorted; // Known depths and indices of the objects
+        std::vector<int> unknown; // Indices of the objects with unknown depth
+    };
+
+    /**
+     * Range of the sorted depths of a bucket passing with the given depth.
+     */
+    void range(const Bucket &bucket, float z, int &first, int &last) const;
+
+    float absTol, relTol;
+    std::map<int, Bucket> buckets; // Kept between builds to reuse the memory
+    std::vector<float> depths; // Depth of each object
+    mutable std::vector<int> merged; // Candidates from a bucket
+};
+
+}
+
+#endif // _DEPTH_INDEX_
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _MATCHER_HUNGARIAN_
+#define _MATCHER_HUNGARIAN_
+
+#include "but_objdet/but_objdet.h"
+#include "but_objdet/matcher/matcher.h"
+#include "but_objdet/matcher/assignment.h"
+#include "but_objdet/matcher/box_overlap.h"
+#include "but_objdet/matcher/depth_index.h"
+#include "but_objdet/matcher/spatial_grid.h"
+
+namespace but_objdet
+{
+
+/**
+ * A class implementing one-to-one matching of detections and predictions.
+ *
+ * Unlike MatcherOverlap, which picks the best prediction for each detection
+ * on its own, this matcher assigns every prediction to at most one detection
+ * so that the total overlap of the matched pairs is maximal. Only the pairs
+ * of the same class overlapping by at least minOverlap% (see MatcherOverlap)
+ * enter the sparse cost matrix, the other pairs are never materialized.
+ *
+ * In the warm start mode, the matcher keeps the final column prices of
+ * the last solve for each prediction (by its m_class and m_id) and starts the next solve
+ * from them. When most of the assignments stay the same between frames,
+ * the greedy initialization reproduces them and only the changed tracks
+ * are searched for by augmenting paths.
+ */
+class MatcherHungarian : public Matcher
+{
+public:
+    /**
+     * MatcherHungarian constructor.
+     * @param min  The bounding boxes can be matched to each other if
+     * their overlapping area represents at least min% of each of them.
+     */
+	MatcherHungarian(float min=50, bool warm=false);
+
+    /**
+     * A function to set the minimal overlap.
+     * @param min  The bounding boxes can be matched to each other if
+     * their overlapping area represents at least min% of each of them.
+     */
+	void setMinOverlap(float min=50);
+
+    /**
+     * A function to set the depth gate (disabled by default). A detection
+     * and a prediction can be matched only if their depths (m_pos_2D.z)
+     * differ by at most absTol + relTol * (depth of the detection), or if
+     * any of the depths is unknown (not positive). See DepthIndex.
+     * @param absTol  Absolute tolerance (negative = the gate is disabled).
+     * @param relTol  Tolerance relative to the depth of the detection.
+     */
+	void setDepthTolerance(float absTol, float relTol=0);
+
+    /**
+     * A function to enable/disable the warm start mode (disabling it forgets
+     * the kept prices).
+     */
+	void setWarmStart(bool warm);
+
+    /**
+     * Number of detections assigned by augmenting paths in the last match
+     * (the rest was assigned by the greedy initialization).
+     */
+	int getAugmentations() const { return solver.augmentations(); }
+
+	/**
+     * Implementation of the virtual matching function from the Matcher abstract class.
+     */
+	void match(const Objects &detections, const Objects &predictions, Matches &matches);
+
+private:
+	float minOverlap;
+	ClassGrids grids; // Grids over predictions (by m_class)
+	bool depthGate;
+	DepthIndex depthIndex; // Predictions sorted by depth (by m_class)
+	BoxArray predBoxes; // Bounding boxes of predictions
+	std::vector<int> candidates; // Candidates of the current detection
+	std::vector<float> scores; // Overlaps with the candidates
+	SparseCostMatrix costs; // Costs of the gated detection-prediction pairs
+	AssignmentSolver solver;
+	std::vector<int> assignment; // Prediction assigned to each detection
+
+	bool warmStart;
+	std::vector<float> prices; // Prices of the predictions (columns)
+	std::vector<std::pair<std::pair<int, int>, float> > pricesById; // Final prices from the last match (sorted by m_class, m_id)
+};
+
+}
+
+#endif // _MATCHER_HUNGARIAN_
@@ -0,0 +1,108 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _MATCHER_MAHALANOBIS_
+#define _MATCHER_MAHALANOBIS_
+
+#include "but_objdet/but_objdet.h"
+#include "but_objdet/matcher/matcher.h"
+#include "but_objdet/matcher/assignment.h"
+#include "but_objdet/matcher/spatial_grid.h"
+
+namespace but_objdet
+{
+
+/**
+ * A class implementing one-to-one matching of detections and predictions
+ * based on the Mahalanobis distance of their bounding boxes (x, y, width,
+ * height), using covariance of the predicted bounding box (Object::m_cov,
+ * provided by the tracker).
+ *
+ * A pair of the same class is a candidate only if its squared distance
+ * is within a chi-square gate (4 degrees of freedom). Well locked tracks
+ * thus get tight gates and coasting tracks wider ones. The gate of every
+ * prediction is first bounded by a rectangle of possible positions, which
+ * is indexed by a grid, so the distance is computed only for detections
+ * falling into the rectangle.
+ */
+class MatcherMahalanobis : public Matcher
+{
+public:
+    /**
+     * MatcherMahalanobis constructor.
+     * @param gate  Maximal squared Mahalanobis distance of a matching pair
+     * (9.49 corresponds to 95% of the chi-square distribution with 4 DOF).
+     */
+	MatcherMahalanobis(float gate=9.49);
+
+    /**
+     * A function to set the gate.
+     * @param gate  Maximal squared Mahalanobis distance of a matching pair.
+     */
+	void setGate(float gate=9.49);
+
+    /**
+     * A function to set the uncertainty of predictions without covariance.
+     * @param sigma  Standard deviation of each bounding box parameter
+     * relative to the bounding box size (e.g. 0.1 = 10% of width/height).
+     */
+	void setDefaultSigma(float sigma=0.1);
+
+	/**
+     * Implementation of the virtual matching function from the Matcher abstract class.
+     */
+	void match(const Objects &detections, const Objects &predictions, Matches &matches);
+
+    /**
+     * Cholesky factorization of a 4x4 covariance matrix.
+     * @param cov  Row-major covariance matrix (16 values).
+     * @param L  (output) Lower triangular factor (10 values, row by row).
+     * @return  False if the matrix is not positive definite.
+     */
+    static bool cholesky4(const float *cov, float *L);
+
+    /**
+     * Squared Mahalanobis distance of a difference vector.
+     * @param L  Cholesky factor of the covariance (see cholesky4).
+     * @param d  Difference vector (4 values).
+     */
+    static float distance4(const float *L, const float *d);
+
+private:
+	float gate;
+	float defaultSigma;
+	std::vector<float> factors; // Cholesky factors of predictions (10 values per prediction)
+	std::vector<cv::Rect> gateRects; // Possible positions of matching detections
+	ClassGrids grids; // Grids over gateRects (by m_class)
+	std::vector<int> candidates; // Candidates of the current detection
+	SparseCostMatrix costs; // Costs of the gated detection-prediction pairs
+	AssignmentSolver solver;
+	std::vector<int> assignment; // Prediction assigned to each detection
+};
+
+}
+
+#endif // _MATCHER_MAHALANOBIS_
@@ -0,0 +1,108 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _MATCHER_MASK_
+#define _MATCHER_MASK_
+
+#include "but_objdet/but_objdet.h"
+#include "but_objdet/matcher/matcher.h"
+#include "but_objdet/matcher/assignment.h"
+#include "but_objdet/matcher/bit_mask.h"
+#include "but_objdet/matcher/spatial_grid.h"
+
+namespace but_objdet
+{
+
+/**
+ * A class implementing one-to-one matching of detections and predictions
+ * by the IoU (intersection over union) of their masks (m_mask), meant for
+ * the segmentation detectors.
+ *
+ * The masks are cropped to bounding boxes and packed to bits (see BitMask),
+ * the intersection is counted by popcount. Only the pairs of the same class
+ * whose bounding boxes intersect are tested, and a pair is skipped without
+ * touching the masks if even the largest intersection allowed by the boxes
+ * and the mask areas can not reach minIoU. If a detection or a prediction
+ * has no mask, the IoU of the bounding boxes is used instead.
+ */
+class MatcherMask : public Matcher
+{
+public:
+    /**
+     * MatcherMask constructor.
+     * @param min  Minimal IoU (in percent) of a detection and a prediction
+     * to be matched.
+     */
+	MatcherMask(float min=50);
+
+    /**
+     * A function to set the minimal IoU.
+     * @param min  Minimal IoU (in percent) of a detection and a prediction
+     * to be matched.
+     */
+	void setMinIoU(float min=50);
+
+	/**
+     * Implementation of the virtual matching function from the Matcher abstract class.
+     */
+	void match(const Objects &detections, const Objects &predictions, Matches &matches);
+
+    /**
+     * IoU (in percent) of two objects (of their masks, or of their bounding
+     * boxes if any of the masks is missing).
+     */
+    static float iou(const Object &det, const Object &pred);
+
+    /**
+     * IoU (in percent) of two bounding boxes (used for the pairs where any
+     * of the masks is missing, without packing any mask).
+     */
+    static float boxIoU(const cv::Rect &det, const cv::Rect &pred);
+
+private:
+    /**
+     * Packs masks of the objects.
+     */
+    void packMasks(const Objects &objects, std::vector<BitMask> &masks, std::vector<char> &hasMask);
+
+    /**
+     * IoU (in percent) of two packed masks, 0 if it is below minIoU.
+     */
+    float maskIoU(const BitMask &det, const BitMask &pred, const cv::Rect &boxInter) const;
+
+	float minIoU;
+	ClassGrids grids; // Grids over predictions (by m_class)
+	std::vector<BitMask> detMasks, predMasks; // Packed masks (kept to reuse the memory)
+	std::vector<char> detHasMask, predHasMask;
+	std::vector<int> candidates; // Candidates of the current detection
+	SparseCostMatrix costs; // Costs of the gated detection-prediction pairs
+	AssignmentSolver solver;
+	std::vector<int> assignment; // Prediction assigned to each detection
+};
+
+}
+
+#endif // _MATCHER_MASK_
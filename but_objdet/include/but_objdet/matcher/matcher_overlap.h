@@ -31,6 +31,9 @@
 
 #include "but_objdet/but_objdet.h"
 #include "but_objdet/matcher/matcher.h"
+#include "but_objdet/matcher/box_overlap.h"
+#include "but_objdet/matcher/depth_index.h"
+#include "but_objdet/matcher/spatial_grid.h"
 
 namespace but_objdet
 {
@@ -38,6 +41,10 @@ namespace but_objdet
 /**
  * A class implementing matching of detections and predictions based on their
  * bounding boxes overlap.
+ *
+ * Predictions are bucketed by their class and each bucket is indexed by
+ * a uniform grid (built once per call of match), so the overlap is computed
+ * only for the detection-prediction pairs sharing a grid cell.
  */
 class MatcherOverlap : public Matcher
 {
@@ -56,13 +63,40 @@ public:
      */
 	void setMinOverlap(float min=50);
 
+    /**
+     * A function to set the depth gate (disabled by default). A detection
+     * and a prediction can be matched only if their depths (m_pos_2D.z)
+     * differ by at most absTol + relTol * (depth of the detection), or if
+     * any of the depths is unknown (not positive). See DepthIndex.
+     * @param absTol  Absolute tolerance (negative = the gate is disabled).
+     * @param relTol  Tolerance relative to the depth of the detection.
+     */
+	void setDepthTolerance(float absTol, float relTol=0);
+
 	/**
      * Implementation of the virtual matching function from the Matcher abstract class.
      */
 	void match(const Objects &detections, const Objects &predictions, Matches &matches);
 
+    /**
+     * Overlapping percentage of two bounding boxes.
+     * @param det  Bounding box of a detection.
+     * @param pred  Bounding box of a prediction.
+     * @param minOverlap  Minimal overlap (in percent) of each of the boxes.
+     * @return  The smaller one of the percentages of the detection and
+     * the prediction BB which is overlapped, or 0 if it is less than minOverlap.
+     * (see BoxOverlap for a batched version).
+     */
+    static float overlap(const cv::Rect &det, const cv::Rect &pred, float minOverlap);
+
 private:
 	float minOverlap;
+	ClassGrids grids; // Grids over predictions (by m_class)
+	bool depthGate;
+	DepthIndex depthIndex; // Predictions sorted by depth (by m_class)
+	BoxArray predBoxes; // Bounding boxes of predictions
+	std::vector<int> candidates; // Candidates of the current detection
+	std::vector<float> scores; // Overlaps with the candidates
 };
 
 }
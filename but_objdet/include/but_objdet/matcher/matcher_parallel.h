@@ -0,0 +1,141 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _MATCHER_PARALLEL_
+#define _MATCHER_PARALLEL_
+
+#include <boost/thread.hpp>
+
+#include "but_objdet/but_objdet.h"
+#include "but_objdet/matcher/matcher.h"
+#include "but_objdet/matcher/assignment.h"
+#include "but_objdet/matcher/box_overlap.h"
+#include "but_objdet/matcher/spatial_grid.h"
+
+namespace but_objdet
+{
+
+/**
+ * A class implementing one-to-one matching of detections and predictions
+ * (the same as MatcherHungarian) intended for scenes with hundreds of objects.
+ *
+ * The bipartite gating graph (a detection and a prediction are connected if
+ * they are of the same class and overlap by at least minOverlap%) is split
+ * into connected components. The assignment of each component is solved
+ * independently on a pool of worker threads, which gives the same total
+ * overlap as solving the whole problem at once, but most of the components
+ * in real scenes are tiny.
+ */
+class MatcherParallel : public Matcher
+{
+public:
+    /**
+     * MatcherParallel constructor.
+     * @param min  The bounding boxes can be matched to each other if
+     * their overlapping area represents at least min% of each of them.
+     * @param nThreads  Number of threads solving the components (including
+     * the calling one, 0 = number of hardware threads).
+     */
+	MatcherParallel(float min=50, int nThreads=0);
+
+    /**
+     * A destructor of MatcherParallel (stops the worker threads).
+     */
+	virtual ~MatcherParallel();
+
+    /**
+     * A function to set the minimal overlap.
+     * @param min  The bounding boxes can be matched to each other if
+     * their overlapping area represents at least min% of each of them.
+     */
+	void setMinOverlap(float min=50);
+
+	/**
+     * Implementation of the virtual matching function from the Matcher abstract class.
+     */
+	void match(const Objects &detections, const Objects &predictions, Matches &matches);
+
+private:
+    /**
+     * Working memory of a thread.
+     */
+    struct Worker
+    {
+        AssignmentSolver solver;
+        SparseCostMatrix costs; // Costs of a component
+        std::vector<int> localCol; // Column of a prediction within the component (-1 = none)
+        std::vector<int> globalCol; // Prediction of a column of the component
+        std::vector<int> rowToCol; // Solution for the component
+    };
+
+    /**
+     * Main loop of a pool thread.
+     */
+    void workerLoop(int w);
+
+    /**
+     * Solves components (taken from the shared queue) until there are none left.
+     */
+    void solveComponents(Worker &worker);
+
+    /**
+     * Solves the assignment of one component.
+     */
+    void solveComponent(int c, Worker &worker);
+
+    /**
+     * Finds the representative of a node of the gating graph.
+     */
+    int findRoot(int node);
+
+	float minOverlap;
+	ClassGrids grids; // Grids over predictions (by m_class)
+	BoxArray predBoxes; // Bounding boxes of predictions
+	std::vector<int> candidates; // Candidates of the current detection
+	std::vector<float> scores; // Overlaps with the candidates
+
+	SparseCostMatrix graph; // Gating graph (with costs) of all detections
+	std::vector<int> parent; // Union-find over detections and predictions
+	std::vector<int> compOf; // Component of a root node
+	std::vector<int> compStart; // Offsets of components in compRows
+	std::vector<int> compRows; // Detections ordered by components
+	std::vector<int> assignment; // Prediction assigned to each detection
+
+	// Thread pool
+	std::vector<Worker> workers; // workers[0] belongs to the calling thread
+	boost::thread_group threads;
+	boost::mutex mutex;
+	boost::condition_variable workCond; // New work or quit
+	boost::condition_variable doneCond; // All pool threads finished
+	int generation; // Number of the current match call
+	int active; // Pool threads still working on the current call
+	int nextComp; // The next component to be solved
+	bool quit;
+};
+
+}
+
+#endif // _MATCHER_PARALLEL_
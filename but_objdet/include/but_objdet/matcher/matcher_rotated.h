@@ -0,0 +1,87 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _MATCHER_ROTATED_
+#define _MATCHER_ROTATED_
+
+#include "but_objdet/but_objdet.h"
+#include "but_objdet/matcher/matcher.h"
+#include "but_objdet/matcher/assignment.h"
+#include "but_objdet/matcher/rotated_overlap.h"
+#include "but_objdet/matcher/spatial_grid.h"
+
+namespace but_objdet
+{
+
+/**
+ * A class implementing one-to-one matching of detections and predictions
+ * by the overlap of their rotated boxes (see RotatedBoxArray - the bounding
+ * box rotated by m_angle around its center).
+ *
+ * The overlap is defined as in MatcherOverlap, but on the rotated boxes,
+ * which avoids false overlaps of elongated objects which are not
+ * axis-aligned. Candidates are found by the class grids over the axis-aligned
+ * bounds of the rotated boxes and filtered by the bounding circles before
+ * the exact intersection is computed (see RotatedOverlap). The matched pairs
+ * are chosen as in MatcherHungarian.
+ */
+class MatcherRotated : public Matcher
+{
+public:
+    /**
+     * MatcherRotated constructor.
+     * @param min  The rotated boxes can be matched to each other if
+     * their overlapping area represents at least min% of each of them.
+     */
+	MatcherRotated(float min=50);
+
+    /**
+     * A function to set the minimal overlap.
+     * @param min  The rotated boxes can be matched to each other if
+     * their overlapping area represents at least min% of each of them.
+     */
+	void setMinOverlap(float min=50);
+
+	/**
+     * Implementation of the virtual matching function from the Matcher abstract class.
+     */
+	void match(const Objects &detections, const Objects &predictions, Matches &matches);
+
+private:
+	float minOverlap;
+	RotatedBoxArray detBoxes, predBoxes; // Rotated boxes
+	std::vector<cv::Rect> predBounds; // Axis-aligned bounds of the rotated boxes of predictions
+	ClassGrids grids; // Grids over the bounds (by m_class)
+	std::vector<int> candidates; // Candidates of the current detection
+	std::vector<float> scores; // Overlaps with the candidates
+	SparseCostMatrix costs; // Costs of the gated detection-prediction pairs
+	AssignmentSolver solver;
+	std::vector<int> assignment; // Prediction assigned to each detection
+};
+
+}
+
+#endif // _MATCHER_ROTATED_
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _ROTATED_OVERLAP_
+#define _ROTATED_OVERLAP_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "but_objdet/but_objdet.h"
+
+namespace but_objdet
+{
+
+/**
+ * Rotated boxes stored as a structure of arrays. A rotated box of an object
+ * is centered in the center of its bounding box (m_bb), it has the size
+ * of the bounding box and it is rotated by m_angle degrees (clockwise in
+ * the image, as cv::RotatedRect).
+ */
+struct RotatedBoxArray
+{
+    std::vector<float> cx, cy; // Center
+    std::vector<float> hw, hh; // Half of the width and height
+    std::vector<float> c, s; // Cosine and sine of the angle
+    std::vector<float> radius; // Radius of the bounding circle
+    std::vector<float> area; // Area of a box (0 for degenerate boxes)
+
+    /**
+     * Removes all boxes (the memory is kept).
+     */
+    void clear();
+
+    /**
+     * Appends a box.
+     * @param bb  Bounding box (before the rotation).
+     * @param angle  Angle in degrees.
+     */
+    void push_back(const cv::Rect &bb, float angle);
+
+    /**
+     * Replaces the content by rotated boxes of the objects.
+     */
+    void assign(const Objects &objects);
+
+    /**
+     * Axis-aligned rectangle containing a box.
+     */
+    cv::Rect bounds(int i) const;
+
+    /**
+     * Corners of a box (in a consistent order, the interior is on the left
+     * of each edge in the coordinates with Y axis pointing up).
+     */
+    void corners(int i, cv::Point2f *pts) const;
+
+    /**
+     * Number of boxes.
+     */
+    int size() const { return cx.size(); }
+};
+
+/**
+ * Overlapping percentage of rotated boxes (as defined by MatcherOverlap
+ * for axis-aligned boxes: the smaller one of the percentages of both boxes
+ * which is overlapped, or 0 if it is less than minOverlap% for any of them).
+ *
+ * Before the exact intersection is computed (by clipping one box by the other
+ * and the shoelace formula), a pair is rejected if the bounding circles
+ * of the boxes do not intersect or if their areas differ too much to reach
+ * minOverlap. Pairs of boxes rotated by multiples of 90 degrees are computed
+ * as axis-aligned.
+ */
+class RotatedOverlap
+{
+public:
+    /**
+     * Overlapping percentage of a single pair of objects.
+     */
+    static float pair(const Object &det, const Object &pred, float minOverlap);
+
+    /**
+     * Overlapping percentages of one box and the boxes of an array.
+     * @param dets  An array of boxes (typically of detections).
+     * @param det  Position of the box in dets.
+     * @param preds  An array of boxes (typically of predictions).
+     * @param idx  Positions of the boxes in preds to be processed
+     * (NULL = the first n boxes).
+     * @param n  Number of boxes to be processed.
+     * @param minOverlap  Minimal overlap (in percent) of each of the boxes.
+     * @param out  (output) n overlapping percentages.
+     */
+    static void row(const RotatedBoxArray &dets, int det, const RotatedBoxArray &preds,
+                    const int *idx, int n, float minOverlap, float *out);
+
+    /**
+     * Overlapping percentages of all pairs of boxes from two arrays.
+     * @param dets  An array of N boxes (typically of detections).
+     * @param preds  An array of M boxes (typically of predictions).
+     * @param minOverlap  Minimal overlap (in percent) of each of the boxes.
+     * @param out  (output) NxM matrix (CV_32F) of overlapping percentages.
+     */
+    static void matrix(const RotatedBoxArray &dets, const RotatedBoxArray &preds, float minOverlap, cv::Mat &out);
+
+    /**
+     * Area of the intersection of two boxes.
+     */
+    static float intersection(const RotatedBoxArray &a, int i, const RotatedBoxArray &b, int j);
+
+private:
+    /**
+     * Overlapping percentage of a pair of boxes (without the prefilter).
+     */
+    static float score(const RotatedBoxArray &a, int i, const RotatedBoxArray &b, int j, float minOverlap);
+};
+
+}
+
+#endif // _ROTATED_OVERLAP_
@@ -0,0 +1,147 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _SPATIAL_GRID_
+#define _SPATIAL_GRID_
+
+#include <map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "but_objdet/but_objdet.h"
+
+namespace but_objdet
+{
+
+/**
+ * A uniform grid over a set of rectangles (typically bounding boxes of
+ * predictions), used as a broadphase by the matchers. It is built once
+ * and then queried with other rectangles to get candidates, i.e. the
+ * rectangles sharing at least one grid cell with the query.
+ *
+ * Every rectangle whose interior intersects the query is guaranteed to be
+ * among the candidates. Degenerate rectangles (zero or negative width or
+ * height) are not bucketed and are returned by every query, so a narrow-phase
+ * test run on the candidates gives the same result as a test run on all
+ * the rectangles.
+ */
+class SpatialGrid
+{
+public:
+    SpatialGrid();
+
+    /**
+     * Builds the grid. The cell size is derived from the average size
+     * of the rectangles.
+     * @param rects  Rectangles to be indexed (a rectangle is referred to
+     * by its position in this vector).
+     */
+    void build(const std::vector<cv::Rect> &rects);
+
+    /**
+     * Finds candidates possibly intersecting the given rectangle.
+     * @param rect  Query rectangle.
+     * @param candidates  (output) Positions of the candidate rectangles
+     * (sorted in ascending order, without duplicates).
+     */
+    void query(const cv::Rect &rect, std::vector<int> &candidates) const;
+
+    /**
+     * Number of the indexed rectangles.
+     */
+    int size() const { return count; }
+
+private:
+    /**
+     * Index of a cell covering the given coordinate (floor division).
+     */
+    static int cellOf(int coord, int origin, int cellSize);
+
+    int count; // Number of indexed rectangles
+    int originX, originY; // Top-left corner of the grid
+    int cellW, cellH; // Size of a cell
+    int cols, rows; // Number of cells
+
+    std::vector<int> cellStart; // Offsets of cells in cellItems (cols*rows + 1)
+    std::vector<int> cellItems; // Rectangles stored in cells
+    std::vector<int> unbounded; // Degenerate rectangles (returned by every query)
+
+    mutable std::vector<int> mark; // Last query which returned a rectangle
+    mutable int stamp; // Id of the current query
+};
+
+/**
+ * Spatial grids over objects bucketed by their class (m_class). A query
+ * returns only the objects of the requested class.
+ */
+class ClassGrids
+{
+public:
+    /**
+     * Builds the grids over bounding boxes (m_bb) of the objects.
+     * @param objects  Objects to be indexed.
+     */
+    void build(const Objects &objects);
+
+    /**
+     * Builds the grids over the given rectangles (e.g. gating regions).
+     * @param objects  Objects to be indexed (only their class is used).
+     * @param rects  A rectangle for each of the objects.
+     */
+    void build(const Objects &objects, const std::vector<cv::Rect> &rects);
+
+    /**
+     * Finds candidates possibly intersecting the given rectangle.
+     * @param objClass  Class of the candidates.
+     * @param rect  Query rectangle.
+     * @param candidates  (output) Indices of the candidate objects (sorted
+     * in ascending order, without duplicates).
+     */
+    void query(int objClass, const cv::Rect &rect, std::vector<int> &candidates) const;
+
+private:
+    /**
+     * Buckets the objects by class and builds a grid over each bucket
+     * (over m_bb if no rectangles are given).
+     */
+    void buildBuckets(const Objects &objects, const std::vector<cv::Rect> *rects);
+
+    /**
+     * Objects of one class and a grid built over their rectangles.
+     */
+    struct Bucket
+    {
+        std::vector<int> ids; // Indices of the objects
+        std::vector<cv::Rect> rects; // Their rectangles
+        SpatialGrid grid;
+    };
+
+    std::map<int, Bucket> buckets; // Kept between builds to reuse the memory
+    mutable std::vector<int> local; // Candidates within a bucket
+};
+
+}
+
+#endif // _SPATIAL_GRID_
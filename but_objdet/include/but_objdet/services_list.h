@@ -40,6 +40,12 @@ namespace but_objdet
      * Name of a service to obtain objects (provided by tracker).
      */
 	const std::string BUT_OBJDET_GetObjects_SRV("/but_objdet/get_objects");
+
+	/**
+     * Name of a topic with predictions of detections for each image processed
+     * by detectors (published by tracker, the stamps are the stamps of the images).
+     */
+	const std::string BUT_OBJDET_Predictions_TOPIC("/but_objdet/predictions");
 }
 
 #endif // BUT_OBJDET_SERVICES_LIST_H
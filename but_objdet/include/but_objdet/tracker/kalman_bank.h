@@ -0,0 +1,186 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _KALMAN_BANK_
+#define _KALMAN_BANK_
+
+#include <vector>
+#include "but_objdet/but_objdet.h"
+
+namespace but_objdet
+{
+
+/**
+ * A bank of Kalman filters of many tracks stored as a structure of arrays.
+ *
+ * Each filter has the model of TrackerKalman with secDerivate = true for
+ * a bounding box (x, y, width, height, their velocities and accelerations),
+ * i.e. of StaticKalman<4, 2>. As the parameters are independent (see
+ * KalmanBlock), a filter is stored as 12 state values and 4 symmetric 3x3
+ * covariance blocks (6 values each), every value in its own array indexed
+ * by the slot of the filter. Any subset of slots is predicted or updated
+ * in one pass, 8 slots at once if built with AVX2 kernels (BUT_OBJDET_AVX2)
+ * and run on a CPU supporting AVX2.
+ */
+class KalmanBank
+{
+public:
+    enum { MEAS = 4, ORDER = 2, STATE = MEAS * (ORDER + 1) };
+    enum { COV = 6 }; // Values of a symmetric 3x3 block
+    enum { VALUES = STATE + MEAS * COV }; // Values of a filter
+
+    KalmanBank();
+
+    /**
+     * Adds a filter initialized by a measurement (as TrackerKalman::init).
+     * @param measurement  MEAS values (x, y, width, height).
+     * @return  Slot of the filter (freed slots are reused).
+     */
+    int add(const float *measurement);
+
+    /**
+     * Removes a filter (its slot can be reused by add).
+     */
+    void remove(int slot);
+
+    /**
+     * Initializes a filter by a measurement (as TrackerKalman::init).
+     */
+    void init(int slot, const float *measurement);
+
+    /**
+     * Number of slots (used or free).
+     */
+    int capacity() const { return cap; }
+
+    /**
+     * Number of times the arrays were allocated (the bank starts with
+     * a capacity of 64 slots and doubles it when all of them are used,
+     * so it stays constant while the number of filters is bounded).
+     */
+    int allocations() const { return allocs; }
+
+    /**
+     * Predicted bounding boxes and their variances (the covariance
+     * of the predicted measurement is diagonal for this model).
+     * @param slots  Slots of the filters (NULL = slots 0..n-1).
+     * @param dt  Time (in seconds) from the last update of each filter.
+     * @param n  Number of filters.
+     * @param boxes  (output) MEAS x n values, parameter p of filter k
+     * at boxes[p * n + k].
+     * @param variances  (output, can be NULL) MEAS x n variances (the same
+     * layout as boxes).
+     */
+    void predict(const int *slots, const float *dt, int n, float *boxes, float *variances) const;
+
+    /**
+     * Predicted bounding boxes and their variances at several times
+     * (trajectories). The state and covariance of each filter are read
+     * once and turned into polynomials in the time, which are then
+     * evaluated for all the times.
+     * @param slots  Slots of the filters (NULL = slots 0..n-1).
+     * @param dt  Times (in seconds) from the last update of each filter,
+     * m values per filter (time j of filter k at dt[k * m + j]).
+     * @param n  Number of filters.
+     * @param m  Number of times.
+     * @param boxes  (output) n x m x MEAS values, parameter p of filter k
+     * at time j at boxes[(k * m + j) * MEAS + p].
+     * @param variances  (output, can be NULL) Variances (the same layout
+     * as boxes).
+     */
+    void predictTrajectories(const int *slots, const float *dt, int n, int m,
+                             float *boxes, float *variances) const;
+
+    /**
+     * Predicted state of a single filter.
+     * @param slot  Slot of the filter.
+     * @param dt  Time (in seconds) from the last update.
+     * @param state  (output) STATE values (the layout of TrackerKalman).
+     */
+    void predictState(int slot, float dt, float *state) const;
+
+    /**
+     * Updates filters by measurements (prediction and correction).
+     * @param slots  Slots of the filters (NULL = slots 0..n-1).
+     * @param dt  Time (in seconds) from the last update of each filter.
+     * @param n  Number of filters.
+     * @param measurements  MEAS x n values (the layout of boxes in predict).
+     */
+    void update(const int *slots, const float *dt, int n, const float *measurements);
+
+    /**
+     * Copies a filter (e.g. to restore it later and assimilate measurements
+     * coming out of order).
+     * @param slot  Slot of the filter.
+     * @param filter  (output) VALUES values.
+     */
+    void save(int slot, float *filter) const;
+
+    /**
+     * Sets a filter to a copy made by save.
+     * @param slot  Slot of the filter.
+     * @param filter  VALUES values.
+     */
+    void restore(int slot, const float *filter);
+
+    /**
+     * Copies filters of another bank to the same slots of this one (e.g. to
+     * keep a copy of the bank up to date; the capacity is enlarged to the one
+     * of the other bank, the free slots are not changed).
+     * @param other  The other bank.
+     * @param slots  Slots of the filters.
+     * @param n  Number of filters.
+     */
+    void copyFilters(const KalmanBank &other, const int *slots, int n);
+
+private:
+    /**
+     * Array of the value of all slots.
+     */
+    float *values(int v) { return &data[v * cap]; }
+    const float *values(int v) const { return &data[v * cap]; }
+
+    /**
+     * Enlarges the arrays.
+     */
+    void reserve(int newCap);
+
+    /**
+     * AVX2 versions of predict and update (only built with BUT_OBJDET_AVX2),
+     * which process the filters by 8 and return the number of processed ones.
+     */
+    int predictAvx2(const int *slots, const float *dt, int n, float *boxes, float *variances) const;
+    int updateAvx2(const int *slots, const float *dt, int n, const float *measurements);
+
+    int cap; // Number of slots
+    int allocs; // Number of allocations of the arrays
+    std::vector<float> data; // VALUES arrays of cap values
+    std::vector<int> freeSlots; // Slots which can be reused
+};
+
+}
+
+#endif // _KALMAN_BANK_
@@ -0,0 +1,150 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _KALMAN_BLOCKS_
+#define _KALMAN_BLOCKS_
+
+namespace but_objdet
+{
+
+/**
+ * Closed-form Kalman filter steps for a single parameter of the motion
+ * models used by the trackers (the parameter, its velocity and, for Order 2,
+ * its acceleration).
+ *
+ * The transition matrix, the process and measurement noise and the initial
+ * covariance of the trackers treat all the parameters independently
+ * (x' = x + v*dt + a*dt^2/2, v' = v + a*dt, a' = a for each of them),
+ * so the covariance of the whole state never correlates different parameters
+ * and the filter splits into independent (Order+1) x (Order+1) blocks with
+ * a scalar measurement. The state of a parameter is read with a stride
+ * (the trackers store all the parameters first, then all the velocities...).
+ */
+template <int Order>
+struct KalmanBlock
+{
+    enum { N = Order + 1 };
+
+    // Only the first and second order motion models are supported
+    typedef char OrderCheck[(Order == 1 || Order == 2) ? 1 : -1];
+
+    /**
+     * Predicted state: F * x.
+     * @param x  State of the parameter (N values with the given stride).
+     * @param stride  Distance of the derivatives in x and out.
+     * @param dt  Elapsed time (in seconds).
+     * @param out  (output) Predicted state (may be the same as x).
+     */
+    static inline void predictState(const float *x, int stride, float dt, float *out)
+    {
+        if(Order == 2) {
+            float a = x[2 * stride];
+            float v = x[stride];
+            out[0] = x[0] + dt * (v + 0.5f * dt * a);
+            out[stride] = v + dt * a;
+            out[2 * stride] = a;
+        }
+        else {
+            float v = x[stride];
+            out[0] = x[0] + dt * v;
+            out[stride] = v;
+        }
+    }
+
+    /**
+     * Predicted covariance: F * P * F^T + q * I.
+     * @param P  Covariance of the parameter state (symmetric).
+     * @param dt  Elapsed time (in seconds).
+     * @param q  Process noise.
+     * @param out  (output) Predicted covariance (may be the same as P).
+     */
+    static inline void predictCov(const float P[N][N], float dt, float q, float out[N][N])
+    {
+        if(Order == 2) {
+            float h = 0.5f * dt * dt;
+
+            // FP = F * P (F is upper triangular)
+            float FP[3][3];
+            for(int j = 0; j < 3; j++) {
+                FP[0][j] = P[0][j] + dt * P[1][j] + h * P[2][j];
+                FP[1][j] = P[1][j] + dt * P[2][j];
+                FP[2][j] = P[2][j];
+            }
+
+            // FP * F^T (symmetric)
+            float p00 = FP[0][0] + dt * FP[0][1] + h * FP[0][2];
+            float p01 = FP[0][1] + dt * FP[0][2];
+            float p02 = FP[0][2];
+            float p11 = FP[1][1] + dt * FP[1][2];
+            float p12 = FP[1][2];
+            float p22 = FP[2][2];
+
+            out[0][0] = p00 + q; out[0][1] = p01; out[0][2] = p02;
+            out[1][0] = p01; out[1][1] = p11 + q; out[1][2] = p12;
+            out[2][0] = p02; out[2][1] = p12; out[2][2] = p22 + q;
+        }
+        else {
+            float p00 = P[0][0] + dt * (P[1][0] + P[0][1]) + dt * dt * P[1][1];
+            float p01 = P[0][1] + dt * P[1][1];
+            float p11 = P[1][1];
+
+            out[0][0] = p00 + q; out[0][1] = p01;
+            out[1][0] = p01; out[1][1] = p11 + q;
+        }
+    }
+
+    /**
+     * Correction by a measurement of the parameter (H = [1 0 ...]).
+     * @param x  (input/output) State of the parameter (with the given stride).
+     * @param stride  Distance of the derivatives in x.
+     * @param P  (input/output) Covariance of the parameter state.
+     * @param z  Measured value.
+     * @param r  Measurement noise.
+     */
+    static inline void correct(float *x, int stride, float P[N][N], float z, float r)
+    {
+        float s = P[0][0] + r;
+        float y = z - x[0];
+
+        float K[N], P0[N];
+        for(int d = 0; d < N; d++) {
+            K[d] = P[d][0] / s;
+            P0[d] = P[0][d];
+        }
+        for(int d = 0; d < N; d++) {
+            x[d * stride] += K[d] * y;
+        }
+        for(int d = 0; d < N; d++) {
+            for(int e = 0; e < N; e++) {
+                P[d][e] -= K[d] * P0[e];
+            }
+        }
+    }
+};
+
+}
+
+#endif // _KALMAN_BLOCKS_
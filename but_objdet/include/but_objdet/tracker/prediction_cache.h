@@ -0,0 +1,128 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+#ifndef _PREDICTION_CACHE_
+#define _PREDICTION_CACHE_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "but_objdet/tracker/kalman_bank.h"
+
+namespace but_objdet
+{
+
+struct TrackView;
+
+/**
+ * A cache of the predictions of the filters of a TrackSnapshot (the predicted
+ * bounding boxes and their variances), serving repeated
+ * requests for the same time (e.g. several detectors asking for the same
+ * frame) without evaluating the filters again.
+ *
+ * A prediction is kept per filter slot together with the time it was
+ * requested for and the version of the detection (see DetM::version), so
+ * it is valid until the detection is updated. The versions are unique
+ * within the shard, so a prediction of an expired detection is never
+ * returned for a new one using the same slot, and the predictions stay
+ * valid when the snapshot is refilled by the shard.
+ *
+ * Only the output of the filters is cached, the predicted detections
+ * are made of it and the stored ones (with just the requested fields).
+ *
+ * The services use the cache of a pinned snapshot concurrently, without
+ * locks: each entry has a sequence number which is odd while the entry
+ * is written (a writer claims it by an atomic compare-and-swap and skips
+ * the entry if it is being written by another one), and a reader takes
+ * the entry only if the number was even and did not change while it was
+ * read. Atomic operations are the GCC __sync builtins (as in SnapshotExchange).
+ */
+class PredictionCache
+{
+public:
+    PredictionCache();
+
+    /**
+     * Sets the number of filter slots (to be called by the writer
+     * of the snapshot, the entries of the existing slots are kept).
+     */
+    void resize(int slots);
+
+    /**
+     * Takes the cached predictions of stored detections.
+     * @param tracks  Stored detections.
+     * @param reqTime  Time (in nanoseconds) for which the predictions are required.
+     * @param boxes  (output) Predicted bounding boxes (MEAS values per detection,
+     * only the ones found in the cache are written).
+     * @param variances  (output) Variances of the bounding boxes (as boxes).
+     * @param missing  (output) Indices of the detections which were not found
+     * are appended.
+     */
+    void lookup(const std::vector<const TrackView *> &tracks, int64 reqTime,
+                float *boxes, float *variances, std::vector<int> &missing);
+
+    /**
+     * Stores the computed predictions of stored detections.
+     * @param tracks  Stored detections.
+     * @param missing  Indices of the detections whose predictions are stored.
+     * @param reqTime  Time (in nanoseconds) of the predictions.
+     * @param boxes  Predicted bounding boxes (MEAS values per detection).
+     * @param variances  Variances of the bounding boxes (as boxes).
+     */
+    void store(const std::vector<const TrackView *> &tracks, const std::vector<int> &missing,
+               int64 reqTime, const float *boxes, const float *variances);
+
+    /**
+     * Number of the predictions found in the cache.
+     */
+    int64 hits();
+
+    /**
+     * Number of the predictions not found in the cache.
+     */
+    int64 misses();
+
+private:
+    enum { MEAS = KalmanBank::MEAS };
+
+    struct Entry
+    {
+        Entry() : seq(0) {}
+        volatile unsigned int seq; // Odd while the entry is written (0 = empty)
+        int64 reqTime; // Time of the prediction (in nanoseconds)
+        int64 version; // Version of the detection the prediction was computed from
+        float box[MEAS]; // Predicted bounding box
+        float variance[MEAS]; // Variances of the bounding box
+    };
+
+    std::vector<Entry> entries; // Filter slot -> Entry
+    volatile int64 hitCount, missCount;
+};
+
+}
+
+#endif // _PREDICTION_CACHE_
@@ -0,0 +1,167 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _REPLAY_BUFFER_
+#define _REPLAY_BUFFER_
+
+#include <opencv2/opencv.hpp>
+
+namespace but_objdet
+{
+
+/**
+ * A bounded buffer of the last measurements of a track (sorted by time),
+ * each with a snapshot of the filter after assimilating it, used to
+ * assimilate late measurements (coming out of order, e.g. from another
+ * detector with a longer latency): the filter is restored from the snapshot
+ * preceding the late measurement and the following measurements are replayed.
+ *
+ * The buffer has a fixed capacity and no dynamic memory. When it is full,
+ * the oldest measurement is dropped, so measurements older than the second
+ * oldest one are too late to be assimilated.
+ *
+ * @param Capacity  Number of kept measurements.
+ * @param Meas  Number of values of a measurement.
+ * @param Filter  Number of values of a snapshot of the filter.
+ */
+template <int Capacity, int Meas, int Filter>
+class ReplayBuffer
+{
+public:
+    ReplayBuffer() : count(0) {}
+
+    /**
+     * Removes all the measurements.
+     */
+    void clear() { count = 0; }
+
+    int size() const { return count; }
+
+    /**
+     * Time of the k-th oldest measurement.
+     */
+    int64 time(int k) const { return times[k]; }
+
+    /**
+     * Time of the newest measurement (the buffer must not be empty).
+     */
+    int64 lastTime() const { return times[count - 1]; }
+
+    /**
+     * The k-th oldest measurement (Meas values).
+     */
+    const float *measurement(int k) const { return values[k]; }
+
+    /**
+     * Snapshot of the filter after the k-th oldest measurement (Filter values).
+     */
+    float *snapshot(int k) { return snapshots[k]; }
+    const float *snapshot(int k) const { return snapshots[k]; }
+
+    /**
+     * Inserts a measurement (after the measurements with the same time).
+     * Its snapshot and the snapshots of the following measurements are
+     * to be recomputed by the caller.
+     * @param t  Time of the measurement.
+     * @param measurement  Meas values.
+     * @return  Position of the measurement, or -1 if it is too late (there
+     * would be no snapshot preceding it). Position 0 means there is no
+     * preceding measurement (the buffer was empty).
+     */
+    int insert(int64 t, const float *measurement);
+
+private:
+    /**
+     * Copies a measurement and its snapshot to another position.
+     */
+    void move(int from, int to);
+
+    int64 times[Capacity];
+    float values[Capacity][Meas];
+    float snapshots[Capacity][Filter];
+    int count;
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Copies a measurement and its snapshot to another position
+ */
+template <int Capacity, int Meas, int Filter>
+void ReplayBuffer<Capacity, Meas, Filter>::move(int from, int to)
+{
+    times[to] = times[from];
+    for(int i = 0; i < Meas; i++) {
+        values[to][i] = values[from][i];
+    }
+    for(int i = 0; i < Filter; i++) {
+        snapshots[to][i] = snapshots[from][i];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Inserts a measurement
+ */
+template <int Capacity, int Meas, int Filter>
+int ReplayBuffer<Capacity, Meas, Filter>::insert(int64 t, const float *measurement)
+{
+    int pos = count;
+    while(pos > 0 && times[pos - 1] > t) {
+        pos--;
+    }
+    
+    // The preceding snapshot is needed (and the oldest one is dropped
+    // when the buffer is full)
+    if(count > 0 && (pos == 0 || (count == Capacity && pos == 1))) {
+        return -1;
+    }
+    
+    // Drop the oldest measurement by shifting the older ones to the front,
+    // or make room by shifting the newer ones to the back
+    if(count == Capacity) {
+        pos--;
+        for(int k = 0; k < pos; k++) {
+            move(k + 1, k);
+        }
+    }
+    else {
+        for(int k = count; k > pos; k--) {
+            move(k - 1, k);
+        }
+        count++;
+    }
+    
+    times[pos] = t;
+    for(int i = 0; i < Meas; i++) {
+        values[pos][i] = measurement[i];
+    }
+    
+    return pos;
+}
+
+}
+
+#endif // _REPLAY_BUFFER_
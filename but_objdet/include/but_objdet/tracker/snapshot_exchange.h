@@ -0,0 +1,197 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _SNAPSHOT_EXCHANGE_
+#define _SNAPSHOT_EXCHANGE_
+
+#include <cstddef>
+#include <vector>
+
+namespace but_objdet
+{
+
+/**
+ * Exchange of immutable snapshots between a single writer and any number
+ * of concurrent readers, without locks (read-copy-update with a reader
+ * counter per snapshot):
+ *
+ * - The writer fills a snapshot which is neither the current one nor read
+ *   by anybody (writable) and makes it the current one (publish).
+ * - A reader pins the current snapshot (by incrementing its counter and
+ *   checking it is still the current one) and reads it as long as it needs,
+ *   the writer never changes a pinned snapshot.
+ *
+ * The snapshots are kept and reused (a new one is allocated only if all
+ * of them are current or pinned), so a snapshot with vectors is refilled
+ * without allocations. Atomic operations are the GCC __sync builtins
+ * (full barriers).
+ *
+ * @param T  Type of a snapshot (default constructible).
+ */
+template <class T>
+class SnapshotExchange
+{
+private:
+    struct Slot
+    {
+        Slot() : readers(0) {}
+        T value;
+        volatile int readers; // Number of readers pinning this snapshot
+    };
+
+public:
+    /**
+     * Pins the current snapshot for the lifetime of this object (to be used
+     * by readers, from any thread).
+     */
+    class Reader
+    {
+    public:
+        Reader(SnapshotExchange &exchange) : slot(exchange.pin()) {}
+        ~Reader() { __sync_fetch_and_sub(&slot->readers, 1); }
+
+        const T &operator*() const { return slot->value; }
+        const T *operator->() const { return &slot->value; }
+
+    private:
+        Reader(const Reader &);
+        Reader &operator=(const Reader &);
+
+        Slot *slot;
+    };
+
+    SnapshotExchange();
+    ~SnapshotExchange();
+
+    /**
+     * A snapshot to be filled by the writer (it can contain an older state,
+     * everything has to be overwritten).
+     */
+    T &writable();
+
+    /**
+     * Makes the snapshot returned by the last call of writable the current one.
+     */
+    void publish();
+
+private:
+    SnapshotExchange(const SnapshotExchange &);
+    SnapshotExchange &operator=(const SnapshotExchange &);
+
+    /**
+     * Pins the current snapshot.
+     */
+    Slot *pin();
+
+    Slot *volatile current; // The current snapshot
+    Slot *pending; // The snapshot being filled by the writer
+    std::vector<Slot *> slots; // All the snapshots (used by the writer only)
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Constructor (the current snapshot is a default constructed one)
+ */
+template <class T>
+SnapshotExchange<T>::SnapshotExchange()
+{
+    slots.push_back(new Slot);
+    current = slots[0];
+    pending = NULL;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Destructor (there must be no readers)
+ */
+template <class T>
+SnapshotExchange<T>::~SnapshotExchange()
+{
+    for(unsigned int i = 0; i < slots.size(); i++) {
+        delete slots[i];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Pins the current snapshot
+ *
+ * The counter is incremented before checking the snapshot is still
+ * the current one, so the writer either sees the reader (and does not reuse
+ * the snapshot), or the reader sees that the snapshot is not the current one
+ * anymore (and tries again).
+ */
+template <class T>
+typename SnapshotExchange<T>::Slot *SnapshotExchange<T>::pin()
+{
+    while(true) {
+        Slot *slot = current;
+        __sync_fetch_and_add(&slot->readers, 1);
+        if(slot == current) {
+            return slot;
+        }
+        __sync_fetch_and_sub(&slot->readers, 1);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * A snapshot to be filled by the writer
+ */
+template <class T>
+T &SnapshotExchange<T>::writable()
+{
+    pending = NULL;
+    for(unsigned int i = 0; i < slots.size() && pending == NULL; i++) {
+        if(slots[i] != current && __sync_fetch_and_add(&slots[i]->readers, 0) == 0) {
+            pending = slots[i];
+        }
+    }
+    if(pending == NULL) {
+        pending = new Slot;
+        slots.push_back(pending);
+    }
+    return pending->value;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Makes the filled snapshot the current one
+ */
+template <class T>
+void SnapshotExchange<T>::publish()
+{
+    if(pending != NULL) {
+        __sync_synchronize(); // The snapshot is written before it is published
+        current = pending;
+        __sync_synchronize();
+        pending = NULL;
+    }
+}
+
+}
+
+#endif // _SNAPSHOT_EXCHANGE_
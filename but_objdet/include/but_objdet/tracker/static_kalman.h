@@ -0,0 +1,325 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _STATIC_KALMAN_
+#define _STATIC_KALMAN_
+
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include "but_objdet/tracker/tracker.h"
+#include "but_objdet/tracker/kalman_blocks.h"
+
+namespace but_objdet
+{
+
+/**
+ * A Kalman filter with the dimensions fixed at compile time, giving the same
+ * results as TrackerKalman (within float tolerance) for the same motion model.
+ *
+ * The state consists of Meas measured parameters (e.g. x, y, width and height
+ * of a bounding box) followed by their derivatives up to the Order (1 = velocity,
+ * 2 = velocity and acceleration, i.e. secDerivate of TrackerKalman). All
+ * the matrices are plain arrays of the fixed size stored in the object and
+ * all the loops have constant bounds, so they are unrolled by the compiler
+ * and no memory is allocated after the construction.
+ *
+ * The parameters are independent in the motion model, so the covariance is
+ * kept as Meas blocks of (Order+1) x (Order+1) and the steps are computed
+ * in the closed form of KalmanBlock (a prediction is a few multiply-adds
+ * per parameter instead of a product with the whole transition matrix).
+ *
+ * Besides the Tracker interface (whose matrices wrap the internal arrays),
+ * the filter can be used directly with float arrays.
+ */
+template <int Meas, int Order>
+class StaticKalman : public Tracker
+{
+public:
+    enum { MEAS = Meas, ORDER = Order, STATE = Meas * (Order + 1) };
+
+    StaticKalman();
+    StaticKalman(const StaticKalman &other);
+    StaticKalman &operator=(const StaticKalman &other);
+
+	/**
+     * Implementation of the virtual function from the Tracker abstract class.
+     * It fails if the measurement has not Meas values or if secDerivate does
+     * not correspond to the Order.
+     */
+	bool init(const cv::Mat& measurement, bool secDerivate = (Order == 2));
+
+	/**
+     * Implementation of the virtual function from the Tracker abstract class.
+     * @return  The predicted state (STATE x 1).
+     */
+	const cv::Mat& predict(int64 miliseconds = 1000);
+
+    /**
+     * Implementation of the virtual function from the Tracker abstract class.
+     * @return  The filtered state (STATE x 1).
+     */
+	const cv::Mat& update(const cv::Mat& measurement, int64 miliseconds = 1000);
+
+    /**
+     * Implementation of the virtual function from the Tracker abstract class.
+     */
+	bool predictCovariance(int64 miliseconds, cv::Mat& covariance);
+
+    /**
+     * Initialization by Meas measured values.
+     */
+    void init(const float *measurement);
+
+    /**
+     * Prediction of the state.
+     * @param miliseconds  Time passed since the last update.
+     * @param state  (output) STATE values.
+     */
+    void predict(int64 miliseconds, float *state) const;
+
+    /**
+     * Update by Meas measured values.
+     * @param measurement  Meas measured values.
+     * @param miliseconds  Time passed since the last update.
+     */
+    void update(const float *measurement, int64 miliseconds);
+
+    /**
+     * Covariance of the predicted measurement.
+     * @param miliseconds  Time passed since the last update.
+     * @param covariance  (output) Meas x Meas values (row-wise).
+     */
+    void predictCovariance(int64 miliseconds, float *covariance) const;
+
+    /**
+     * The current (filtered) state.
+     */
+    const float *state() const { return x; }
+
+    /**
+     * The current covariance of the state (errorCovPost of TrackerKalman).
+     * @param covariance  (output) STATE x STATE values (row-wise).
+     */
+    void errorCov(float *covariance) const;
+
+private:
+    typedef KalmanBlock<Order> Block;
+
+    /**
+     * Points the matrix headers to the arrays of this object.
+     */
+    void wrapArrays();
+
+    float x[STATE]; // State (statePost)
+    float P[Meas][Order + 1][Order + 1]; // Covariance of the state of each parameter (errorCovPost)
+    float predicted[STATE]; // The last prediction
+
+    cv::Mat stateMat, predictedMat; // Headers of x and predicted
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+template <int Meas, int Order>
+StaticKalman<Meas, Order>::StaticKalman()
+{
+    float zero[Meas] = {0};
+    init(zero);
+    wrapArrays();
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Copy constructor (the headers must point to the own arrays)
+ */
+template <int Meas, int Order>
+StaticKalman<Meas, Order>::StaticKalman(const StaticKalman &other)
+    : Tracker(other)
+{
+    *this = other;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Assignment
+ */
+template <int Meas, int Order>
+StaticKalman<Meas, Order> &StaticKalman<Meas, Order>::operator=(const StaticKalman &other)
+{
+    for(int i = 0; i < STATE; i++) {
+        x[i] = other.x[i];
+        predicted[i] = other.predicted[i];
+    }
+    for(int k = 0; k < Meas; k++)
+        for(int d = 0; d <= Order; d++)
+            for(int e = 0; e <= Order; e++)
+                P[k][d][e] = other.P[k][d][e];
+    wrapArrays();
+    return *this;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Points the matrix headers to the arrays of this object
+ */
+template <int Meas, int Order>
+void StaticKalman<Meas, Order>::wrapArrays()
+{
+    stateMat = cv::Mat(STATE, 1, CV_32F, x);
+    predictedMat = cv::Mat(STATE, 1, CV_32F, predicted);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Initialization
+ */
+template <int Meas, int Order>
+bool StaticKalman<Meas, Order>::init(const cv::Mat& measurement, bool secDerivate)
+{
+    if(measurement.dims != 2 || measurement.type() != CV_32F)
+        return false;
+    if(!((measurement.rows == 1 && measurement.cols == Meas) ||
+         (measurement.cols == 1 && measurement.rows == Meas)))
+        return false;
+    if(secDerivate != (Order == 2))
+        return false;
+
+    float z[Meas];
+    for(int k = 0; k < Meas; k++)
+        z[k] = measurement.at<float>(k);
+    init(z);
+
+    return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Initialization by measured values (as TrackerKalman::init)
+ */
+template <int Meas, int Order>
+void StaticKalman<Meas, Order>::init(const float *measurement)
+{
+    for(int i = 0; i < STATE; i++) {
+        x[i] = (i < Meas) ? measurement[i] : 0;
+        predicted[i] = x[i];
+    }
+    for(int k = 0; k < Meas; k++)
+        for(int d = 0; d <= Order; d++)
+            for(int e = 0; e <= Order; e++)
+                P[k][d][e] = (d == e) ? 0.1f : 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Prediction of the state
+ */
+template <int Meas, int Order>
+void StaticKalman<Meas, Order>::predict(int64 miliseconds, float *state) const
+{
+    float dt = miliseconds / 1000.0;
+    for(int k = 0; k < Meas; k++)
+        Block::predictState(x + k, Meas, dt, state + k);
+}
+
+template <int Meas, int Order>
+const cv::Mat& StaticKalman<Meas, Order>::predict(int64 miliseconds)
+{
+    predict(miliseconds, predicted);
+    return predictedMat;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Covariance of the predicted measurement: H * (F * P * F^T + Q) * H^T + R
+ * (H selects the measured parameters)
+ */
+template <int Meas, int Order>
+void StaticKalman<Meas, Order>::predictCovariance(int64 miliseconds, float *covariance) const
+{
+    float dt = miliseconds / 1000.0;
+    for(int i = 0; i < Meas; i++) {
+        for(int j = 0; j < Meas; j++)
+            covariance[i * Meas + j] = 0;
+
+        float PPre[Order + 1][Order + 1];
+        Block::predictCov(P[i], dt, 1e-4f, PPre);
+        covariance[i * Meas + i] = PPre[0][0] + 1e-1f;
+    }
+}
+
+template <int Meas, int Order>
+bool StaticKalman<Meas, Order>::predictCovariance(int64 miliseconds, cv::Mat& covariance)
+{
+    covariance.create(Meas, Meas, CV_32F);
+    predictCovariance(miliseconds, covariance.ptr<float>(0));
+    return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Covariance of the state assembled from the blocks of the parameters
+ * (element d, e of block k is at row k + d * Meas, column k + e * Meas)
+ */
+template <int Meas, int Order>
+void StaticKalman<Meas, Order>::errorCov(float *covariance) const
+{
+    for(int i = 0; i < STATE * STATE; i++)
+        covariance[i] = 0;
+    for(int k = 0; k < Meas; k++)
+        for(int d = 0; d <= Order; d++)
+            for(int e = 0; e <= Order; e++)
+                covariance[(k + d * Meas) * STATE + k + e * Meas] = P[k][d][e];
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Update by measured values (prediction and correction of each parameter)
+ */
+template <int Meas, int Order>
+void StaticKalman<Meas, Order>::update(const float *measurement, int64 miliseconds)
+{
+    float dt = miliseconds / 1000.0;
+    for(int k = 0; k < Meas; k++) {
+        Block::predictState(x + k, Meas, dt, x + k);
+        Block::predictCov(P[k], dt, 1e-4f, P[k]);
+        Block::correct(x + k, Meas, P[k], measurement[k], 1e-1f);
+    }
+}
+
+template <int Meas, int Order>
+const cv::Mat& StaticKalman<Meas, Order>::update(const cv::Mat& measurement, int64 miliseconds)
+{
+    float z[Meas];
+    for(int k = 0; k < Meas; k++)
+        z[k] = measurement.at<float>(k);
+    update(z, miliseconds);
+    return stateMat;
+}
+
+}
+
+#endif // _STATIC_KALMAN_
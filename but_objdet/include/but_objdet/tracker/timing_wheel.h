@@ -0,0 +1,147 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _TIMING_WHEEL_
+#define _TIMING_WHEEL_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "but_objdet/tracker/track_store.h"
+
+namespace but_objdet
+{
+
+/**
+ * A hierarchical timing wheel of expiration timers of tracks (one timer
+ * per slot of a TrackStore, identified by a TrackHandle).
+ *
+ * The time is divided into ticks of the given resolution. The wheel has
+ * LEVELS levels of BUCKETS buckets, a bucket of level L covering
+ * BUCKETS^L ticks. A timer is put into the lowest level whose range covers
+ * its deadline and it is moved to a lower level when the wheel gets to its
+ * bucket (cascading), so it fires from level 0 exactly in its tick.
+ * Scheduling and canceling a timer is O(1) and advancing the wheel costs
+ * O(elapsed ticks + expired timers + cascaded timers), independently
+ * of the number of the waiting timers.
+ *
+ * The time is not bound to a clock, it can be e.g. the number of received
+ * messages (with the resolution of 1) as well as the time in miliseconds.
+ */
+class TimingWheel
+{
+public:
+    /**
+     * TimingWheel constructor.
+     * @param resolution  Length of a tick (in the units of time).
+     */
+    TimingWheel(int64 resolution = 1);
+
+    /**
+     * Schedules the timer of a track (an already scheduled timer of the same
+     * slot is rescheduled). A timer never fires before its deadline and fires
+     * at most one tick after it (when the wheel is advanced).
+     * @param track  Handle of the track.
+     * @param deadline  Time when the track expires.
+     */
+    void schedule(const TrackHandle &track, int64 deadline);
+
+    /**
+     * Cancels the timer of a track (if it is scheduled).
+     */
+    void cancel(const TrackHandle &track);
+
+    /**
+     * Advances the wheel to the given time. If the time jumps back or far
+     * forward (e.g. when a bag file is replayed again), all the timers are
+     * rescheduled relative to the new time.
+     * @param now  Current time.
+     * @param expired  (output) Handles of the tracks whose deadline is not
+     * later than now are appended (their timers are not scheduled anymore).
+     */
+    void advance(int64 now, std::vector<TrackHandle> &expired);
+
+    /**
+     * Number of scheduled timers.
+     */
+    int size() const { return count; }
+
+private:
+    enum { BITS = 6, BUCKETS = 1 << BITS, LEVELS = 4 };
+
+    /**
+     * A timer (an item of a doubly linked list of a bucket).
+     */
+    struct Timer
+    {
+        int64 deadline;
+        unsigned int generation; // Generation of the track slot
+        int bucket; // -1 = not scheduled
+        int prev, next;
+    };
+
+    /**
+     * Tick in which a timer with the given deadline fires (the first tick
+     * starting at the deadline or later).
+     */
+    int64 tickOf(int64 deadline) const;
+
+    /**
+     * Puts a timer to a bucket by its deadline relative to the current tick.
+     * @param minDelta  The minimal distance (in ticks) from the current tick
+     * (the bucket of the current tick is fired only if the timers are
+     * cascaded to it).
+     */
+    void link(int slot, int64 minDelta);
+
+    /**
+     * Removes a timer from its bucket.
+     */
+    void unlink(int slot);
+
+    /**
+     * Moves the timers of a bucket to lower levels.
+     */
+    void cascade(int bucket);
+
+    /**
+     * Reschedules all the timers relative to the given tick (and expires
+     * the ones due).
+     */
+    void reset(int64 tick, int64 now, std::vector<TrackHandle> &expired);
+
+    int64 resolution; // Length of a tick
+    int64 current; // The last processed tick
+    bool started; // If current is valid (set by the first advance)
+    int count; // Number of scheduled timers
+
+    std::vector<Timer> timers; // Timers indexed by track slots
+    int heads[LEVELS * BUCKETS]; // The first timer of each bucket (-1 = empty)
+    std::vector<int> pending; // Working memory of cascade and reset
+};
+
+}
+
+#endif // _TIMING_WHEEL_
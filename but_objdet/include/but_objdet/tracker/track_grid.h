@@ -0,0 +1,196 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+#ifndef _TRACK_GRID_
+#define _TRACK_GRID_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace but_objdet
+{
+
+/**
+ * A spatial query on the tracked objects (by their bounding boxes).
+ */
+struct GridQuery
+{
+    enum Type
+    {
+        NONE = 0, // All the objects
+        ROI = 1, // Objects whose boxes intersect roi
+        RADIUS = 2, // Objects whose box centres are within radius from (x, y)
+        NEAREST = 3 // k objects whose box centres are the nearest to (x, y)
+    };
+
+    GridQuery() : type(NONE), x(0), y(0), radius(0), k(0) {}
+
+    int type;
+    cv::Rect roi;
+    float x, y;
+    float radius;
+    int k;
+};
+
+/**
+ * A uniform grid over the bounding boxes of tracked objects, updated
+ * incrementally as the objects are added, move and are removed (unlike
+ * SpatialGrid, which is built at once over a set of rectangles).
+ *
+ * An object is identified by a slot (e.g. of its filter in a KalmanBank)
+ * and it is put into the cell containing the centre of its box. The cells
+ * are hashed into BUCKETS doubly linked lists (indexed by the slots, as
+ * in TimingWheel), so adding, moving and removing an object is O(1) and
+ * no memory is allocated unless there are more slots than ever before.
+ * A box larger than a cell is kept in a separate list tested by every
+ * query, so a query for boxes intersecting a region only needs the cells
+ * of the region grown by one cell.
+ *
+ * A query visits the cells covering its region (or rings of cells around
+ * the point, until the k nearest objects are found), i.e. it costs O(visited
+ * cells + objects in them); it falls back to a scan of all the objects when
+ * the region covers more cells than there are slots.
+ */
+class TrackGrid
+{
+public:
+    /**
+     * TrackGrid constructor.
+     * @param cellSize  Size of a cell (in pixels).
+     */
+    TrackGrid(int cellSize = 64);
+
+    /**
+     * Adds an object (an object of the same slot is replaced).
+     * @param slot  Slot of the object.
+     * @param objClass  Class of the object.
+     * @param id  ID of the object.
+     * @param box  Bounding box of the object.
+     */
+    void insert(int slot, int objClass, int id, const cv::Rect &box);
+
+    /**
+     * Moves an object (it must be added).
+     * @param slot  Slot of the object.
+     * @param box  The new bounding box of the object.
+     */
+    void move(int slot, const cv::Rect &box);
+
+    /**
+     * Removes an object (nothing is done if it is not added).
+     * @param slot  Slot of the object.
+     */
+    void remove(int slot);
+
+    /**
+     * Finds the objects satisfying a query.
+     * @param query  The query (NONE returns all the objects).
+     * @param objClass  Class of the objects (-1 = any class).
+     * @param slots  (output) Slots of the objects (sorted by distance for
+     * NEAREST, otherwise in no particular order).
+     * @param distances  (output) Distances of the box centres from the point
+     * of the query (0 for NONE and ROI).
+     * @param ids  IDs of the objects (sorted, NULL = any ID). The objects
+     * are filtered before NEAREST takes the k nearest of them.
+     */
+    void query(const GridQuery &query, int objClass,
+               std::vector<int> &slots, std::vector<float> &distances,
+               const std::vector<int> *ids = NULL) const;
+
+    /**
+     * Number of the objects.
+     */
+    int size() const { return count; }
+
+private:
+    enum { BITS = 10, BUCKETS = 1 << BITS, LARGE = BUCKETS };
+
+    /**
+     * An object (an item of a doubly linked list of a bucket).
+     */
+    struct Node
+    {
+        int cx, cy; // Cell of the centre of the box
+        float x, y; // Centre of the box
+        cv::Rect box;
+        int objClass;
+        int id;
+        int bucket; // -1 = not added, LARGE = in the list of large boxes
+        int prev, next;
+    };
+
+    /**
+     * Index of a cell covering the given coordinate (floor division).
+     */
+    int cellOf(float coord) const;
+
+    /**
+     * Bucket of a cell.
+     */
+    static int bucketOf(int cx, int cy);
+
+    /**
+     * Puts an object to the list of its cell (or of the large boxes).
+     */
+    void link(int slot);
+
+    /**
+     * Removes an object from its list.
+     */
+    void unlink(int slot);
+
+    /**
+     * If an object is of the class and has one of the IDs of a query.
+     */
+    static bool accepts(const Node &node, int objClass, const std::vector<int> *ids);
+
+    /**
+     * Tests an object by a query (ROI or RADIUS) and appends it if it passes.
+     */
+    void test(const Node &node, int slot, const GridQuery &query, int objClass,
+              const std::vector<int> *ids,
+              std::vector<int> &slots, std::vector<float> &distances) const;
+
+    /**
+     * Appends the objects of a cell with their distances from the point
+     * of a query (NEAREST).
+     * @return  Number of the objects in the cell (of any class and ID).
+     */
+    int collect(int cx, int cy, const GridQuery &query, int objClass,
+                const std::vector<int> *ids,
+                std::vector<std::pair<float, int> > &nearest) const;
+
+    int cellSize;
+    int count; // Number of the objects
+    int largeCount; // Number of the objects in the list of large boxes
+    std::vector<Node> nodes; // Objects by their slots
+    int heads[BUCKETS + 1]; // Lists of the buckets and of the large boxes
+};
+
+}
+
+#endif // _TRACK_GRID_
@@ -0,0 +1,248 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _TRACK_SHARD_
+#define _TRACK_SHARD_
+
+#include <vector>
+
+#include "but_objdet_msgs/Detection.h"
+#include "but_objdet/tracker/kalman_bank.h"
+#include "but_objdet/tracker/track_store.h"
+#include "but_objdet/tracker/timing_wheel.h"
+#include "but_objdet/tracker/replay_buffer.h"
+#include "but_objdet/tracker/snapshot_exchange.h"
+#include "but_objdet/tracker/prediction_cache.h"
+#include "but_objdet/tracker/track_grid.h"
+
+namespace but_objdet
+{
+
+/**
+ * The last measurements of a tracked object (for assimilating late detections).
+ */
+typedef ReplayBuffer<8, KalmanBank::MEAS, KalmanBank::VALUES> TrackHistory;
+
+/**
+  * A structure storing data related to a detection of a particular object.
+  */
+struct DetM
+{
+    but_objdet_msgs::Detection det; // Detection (the newest one)
+    int slot; // Slot of the Kalman filter for tracking of this detection (in the bank)
+    int64 nsTime; // Time of the newest detection in nanoseconds
+    int64 version; // Changed by each update of the detection or its filter (unique in the shard)
+    bool queued; // If the newest detection waits for the batch update
+    TrackHistory history; // The last detections
+};
+
+/**
+ * A stored detection as seen by the services.
+ */
+struct TrackView
+{
+    but_objdet_msgs::Detection det; // Detection (the newest one)
+    int slot; // Slot of the Kalman filter (in the bank of the snapshot)
+    int64 nsTime; // Time of the detection in nanoseconds
+    int64 version; // Version of the detection (see DetM)
+};
+
+/**
+ * Exchanges two detections without copying their buffers (the mask and
+ * the covariance).
+ */
+inline void swapDetections(but_objdet_msgs::Detection &a, but_objdet_msgs::Detection &b)
+{
+    std::vector<uint8_t> maskA, maskB;
+    std::vector<float> covA, covB;
+    maskA.swap(a.m_mask.data);
+    maskB.swap(b.m_mask.data);
+    covA.swap(a.m_cov);
+    covB.swap(b.m_cov);
+
+    std::swap(a, b); // Copies only the small fields now
+
+    a.m_mask.data.swap(maskB);
+    b.m_mask.data.swap(maskA);
+    a.m_cov.swap(covB);
+    b.m_cov.swap(covA);
+}
+
+/**
+ * Swaps of the records of the track stores (used when a record is erased).
+ */
+inline void swap(DetM &a, DetM &b)
+{
+    swapDetections(a.det, b.det);
+    std::swap(a.slot, b.slot);
+    std::swap(a.nsTime, b.nsTime);
+    std::swap(a.version, b.version);
+    std::swap(a.queued, b.queued);
+    std::swap(a.history, b.history);
+}
+
+inline void swap(TrackView &a, TrackView &b)
+{
+    swapDetections(a.det, b.det);
+    std::swap(a.slot, b.slot);
+    std::swap(a.nsTime, b.nsTime);
+    std::swap(a.version, b.version);
+}
+
+/**
+ * An immutable copy of the stored detections and their Kalman filters,
+ * which the services read while the detections are being processed.
+ * The bank and the grid have the same slots as the ones of the shard
+ * (only the slots of the detections are valid). Only the cache
+ * of the predictions is written by the services (see PredictionCache).
+ */
+struct TrackSnapshot
+{
+    TrackStore<TrackView> tracks;
+    KalmanBank bank;
+    TrackGrid grid; // Bounding boxes of the detections by the slots of their filters
+    std::vector<int> views; // Position of the detection of each filter slot in tracks
+    TrackStore<int> ids; // (0, m_id) -> position of the last detection with the ID in tracks
+    std::vector<int> sameId; // Position of the previous detection with the same ID (-1 = none)
+    mutable PredictionCache predictions; // Predictions computed by the services (by the filter slots)
+};
+
+/**
+ * A part of the state of the tracker node: the stored detections of some
+ * of the classes, their Kalman filters and expiration. The shards are
+ * independent, so they can process their detections concurrently (each
+ * by one thread at a time).
+ */
+class TrackShard
+{
+public:
+    /**
+     * TrackShard constructor.
+     * @param ttl  A stored detection expires if it didn't occur in this number
+     * of last detection messages.
+     * @param ttlTime  A stored detection expires if it didn't occur during
+     * this period (in miliseconds, measured by the stamps of the messages).
+     */
+    TrackShard(int ttl, int ttlTime);
+
+    /**
+     * Processes the detections of this shard from a message (updates
+     * or creates the stored detections and removes the expired ones).
+     * It is to be called for every message, even if it contains
+     * no detections of this shard.
+     * @param detections  Detections of this shard.
+     * @param time  Stamp of the message (in nanoseconds).
+     * @param msgCount  Number of the message.
+     * @param latestTime  The latest stamp of all the messages so far.
+     * @param publish  If to publish a snapshot for the services (otherwise it
+     * is published by refreshSnapshot).
+     */
+    void process(const std::vector<const but_objdet_msgs::Detection *> &detections,
+                 int64 time, int64 msgCount, int64 latestTime, bool publish);
+
+    /**
+     * Publishes a snapshot if the state changed since the last one (to be
+     * called by the thread processing the detections).
+     */
+    void refreshSnapshot();
+
+    /**
+     * Snapshots of this shard (to be read by the services).
+     */
+    SnapshotExchange<TrackSnapshot> &snapshots() { return exchange; }
+
+    /**
+     * The stored detections.
+     */
+    const TrackStore<DetM> &tracks() const { return detectionMem; }
+
+    /**
+     * Kalman filters of the stored detections.
+     */
+    const KalmanBank &filters() const { return bank; }
+
+    /**
+     * Allocations of the pools of stored detections and filters (see
+     * TrackStore::allocations and KalmanBank::allocations).
+     */
+    int allocations() const { return detectionMem.allocations() + bank.allocations(); }
+
+private:
+    TrackShard(const TrackShard &);
+    TrackShard &operator=(const TrackShard &);
+
+    /**
+     * Updates the filters by the queued detections (in one batch).
+     */
+    void updateQueued();
+
+    /**
+     * Assimilates a late detection by replaying the history of a stored detection.
+     * @param detM  Stored detection.
+     * @param pos  Position of the late detection in the history (at least 1).
+     */
+    void replay(DetM &detM, int pos);
+
+    /**
+     * Removes a stored detection (and frees its Kalman filter).
+     * @param handle  Handle of the detection (nothing is done if it is stale).
+     */
+    void removeTrack(const TrackHandle &handle);
+
+    /**
+     * Publishes the current state of the stored detections for the services.
+     */
+    void publishSnapshot();
+
+    int ttl, ttlTime;
+
+    TrackStore<DetM> detectionMem; // (m_class, m_id) -> DetM
+    KalmanBank bank; // Kalman filters of all the stored detections
+    TrackGrid grid; // Bounding boxes of the stored detections (by the slots of the filters)
+
+    // Expiration of the stored detections by ttl (the time is the number
+    // of received messages) and by ttlTime (the time is in nanoseconds)
+    TimingWheel countWheel, timeWheel;
+    std::vector<TrackHandle> expired;
+
+    // Detections waiting for the batch update of the filters
+    std::vector<TrackHandle> queuedTracks;
+    std::vector<float> queuedDts, queuedMeasurements;
+
+    // Working memory of updateQueued (kept to avoid reallocation)
+    std::vector<int> slots;
+    std::vector<float> boxes;
+
+    std::vector<int> snapshotSlots; // Slots of the filters copied to a snapshot
+
+    SnapshotExchange<TrackSnapshot> exchange; // Snapshots read by the services
+    bool snapshotDirty; // If the state changed since the last snapshot
+    int64 updateCount; // Number of updates so far (the last version)
+};
+
+}
+
+#endif // _TRACK_SHARD_
@@ -0,0 +1,506 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef _TRACK_STORE_
+#define _TRACK_STORE_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace but_objdet
+{
+
+/**
+ * A reference to a record of a TrackStore. A handle stays valid until
+ * the record is erased; after that (even if the slot is reused by another
+ * record) the store does not resolve it anymore.
+ */
+struct TrackHandle
+{
+    TrackHandle() : slot(-1), generation(0) {}
+    TrackHandle(int s, unsigned int g) : slot(s), generation(g) {}
+
+    bool operator==(const TrackHandle &other) const
+    {
+        return slot == other.slot && generation == other.generation;
+    }
+    bool operator!=(const TrackHandle &other) const { return !(*this == other); }
+
+    int slot; // Slot of the record (-1 = no record)
+    unsigned int generation; // Generation of the slot when the handle was made
+};
+
+/**
+ * A store of track records identified by a (class, id) pair of the tracked
+ * object (m_class, m_id), organized as a slot map:
+ *
+ * - The records are kept densely in a vector (erasing moves the last record
+ *   to the freed position), so a pass over all the tracks is a linear scan.
+ * - A slot refers to the current position of a record and carries
+ *   a generation, which is incremented when the record is erased, so stale
+ *   handles are detected. Freed slots are reused.
+ * - The (class, id) pairs are mapped to slots by an open-addressing hash
+ *   table with linear probing (at most half full, erasing by backward
+ *   shifting, so there are no tombstones).
+ *
+ * The store works as a pool: an erased record is not destroyed but kept
+ * behind the live ones and recycled by the next insert (together with any
+ * memory it owns, e.g. the buffers of a message), so once the store has
+ * grown to the maximal number of tracks, inserting and erasing do not
+ * allocate (see allocations()).
+ *
+ * Pointers and references to the records are invalidated by insert and
+ * erase, handles are not.
+ */
+template <class T>
+class TrackStore
+{
+public:
+    TrackStore();
+
+    /**
+     * Number of records.
+     */
+    int size() const { return count; }
+
+    bool empty() const { return count == 0; }
+
+    /**
+     * Number of times the store reallocated its arrays (the records grow
+     * geometrically and the hash table doubles, so it stays constant while
+     * the number of records is bounded, however many are inserted and erased).
+     */
+    int allocations() const { return allocs; }
+
+    /**
+     * Record at a dense position (0..size()-1).
+     */
+    T &at(int pos) { return records[pos]; }
+    const T &at(int pos) const { return records[pos]; }
+
+    /**
+     * Class and id of the record at a dense position.
+     */
+    int classAt(int pos) const { return keys[pos].objClass; }
+    int idAt(int pos) const { return keys[pos].id; }
+
+    /**
+     * Handle of the record at a dense position.
+     */
+    TrackHandle handleAt(int pos) const;
+
+    /**
+     * Finds a record.
+     * @return  The record or NULL if there is no record of the class and id.
+     */
+    T *find(int objClass, int id);
+    const T *find(int objClass, int id) const;
+
+    /**
+     * Handle of a record (an invalid handle if there is no such record).
+     */
+    TrackHandle handle(int objClass, int id) const;
+
+    /**
+     * Resolves a handle.
+     * @return  The record or NULL if the handle is stale or invalid.
+     */
+    T *get(const TrackHandle &h);
+    const T *get(const TrackHandle &h) const;
+
+    /**
+     * Dense position of the record referred to by a handle (-1 if stale).
+     */
+    int position(const TrackHandle &h) const;
+
+    /**
+     * Inserts a record unless there already is a record of the class and id.
+     * The record is a recycled one (with the values of an erased record) or
+     * a default constructed one, so all its fields must be set.
+     * @param inserted  (output, can be NULL) If the record was inserted.
+     * @return  Handle of the (new or existing) record.
+     */
+    TrackHandle insert(int objClass, int id, bool *inserted = NULL);
+
+    /**
+     * Erases a record. The last record is moved to its dense position, so
+     * when erasing during a pass, go from the last position to the first.
+     * @return  False if there is no such record.
+     */
+    bool erase(int objClass, int id);
+    bool erase(const TrackHandle &h);
+
+    /**
+     * Erases all the records (the handles to them become stale, the records
+     * are kept for recycling).
+     */
+    void clear();
+
+private:
+    /**
+     * Class and id of a record.
+     */
+    struct Key
+    {
+        int objClass;
+        int id;
+    };
+
+    /**
+     * An entry of the hash table (slot -1 = empty).
+     */
+    struct Entry
+    {
+        int objClass;
+        int id;
+        int slot;
+    };
+
+    /**
+     * A slot refers to the dense position of a record (-1 = free).
+     */
+    struct Slot
+    {
+        int pos;
+        unsigned int generation;
+    };
+
+    /**
+     * Hash of a class and id (mixed, so consecutive ids are spread).
+     */
+    static unsigned int hash(int objClass, int id);
+
+    /**
+     * Position of the entry of the class and id in the table, or of
+     * the empty entry where it would be inserted.
+     */
+    unsigned int probe(int objClass, int id) const;
+
+    /**
+     * Removes an entry from the table (the following entries of the same
+     * cluster are shifted back, so the probing stays correct).
+     */
+    void unlink(unsigned int e);
+
+    /**
+     * Resizes the table (the number of entries is a power of 2).
+     */
+    void rehash(unsigned int newSize);
+
+    /**
+     * Erases the record in a slot.
+     */
+    void eraseSlot(int slot);
+
+    std::vector<T> records; // Dense records (live ones followed by recycled ones)
+    int count; // Number of live records
+    std::vector<Key> keys; // Class and id of each record
+    std::vector<int> recordSlot; // Slot of each record
+
+    std::vector<Slot> slots;
+    std::vector<int> freeSlots; // Slots which can be reused
+
+    std::vector<Entry> table; // Hash table (class, id) -> slot
+    unsigned int mask; // Number of entries - 1
+
+    int allocs; // Number of reallocations of the arrays
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+template <class T>
+TrackStore<T>::TrackStore()
+{
+    count = 0;
+    allocs = 0;
+    rehash(16);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Hash of a class and id
+ */
+template <class T>
+unsigned int TrackStore<T>::hash(int objClass, int id)
+{
+    unsigned int h = (unsigned int)id * 0x9E3779B1u ^ (unsigned int)objClass * 0x85EBCA77u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    return h;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Linear probing
+ */
+template <class T>
+unsigned int TrackStore<T>::probe(int objClass, int id) const
+{
+    unsigned int e = hash(objClass, id) & mask;
+    while(table[e].slot != -1 && (table[e].objClass != objClass || table[e].id != id)) {
+        e = (e + 1) & mask;
+    }
+    return e;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Resizes the hash table
+ */
+template <class T>
+void TrackStore<T>::rehash(unsigned int newSize)
+{
+    Entry empty;
+    empty.objClass = 0;
+    empty.id = 0;
+    empty.slot = -1;
+    table.assign(newSize, empty);
+    mask = newSize - 1;
+    allocs++;
+
+    for(int pos = 0; pos < count; pos++) {
+        unsigned int e = probe(keys[pos].objClass, keys[pos].id);
+        table[e].objClass = keys[pos].objClass;
+        table[e].id = keys[pos].id;
+        table[e].slot = recordSlot[pos];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Removes an entry from the hash table (backward shift deletion)
+ */
+template <class T>
+void TrackStore<T>::unlink(unsigned int e)
+{
+    unsigned int hole = e;
+    unsigned int next = (e + 1) & mask;
+    while(table[next].slot != -1) {
+        // An entry can fill the hole if its home position is not
+        // in the cyclic interval (hole, next]
+        unsigned int home = hash(table[next].objClass, table[next].id) & mask;
+        if(((next - home) & mask) >= ((next - hole) & mask)) {
+            table[hole] = table[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    table[hole].slot = -1;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Handle of the record at a dense position
+ */
+template <class T>
+TrackHandle TrackStore<T>::handleAt(int pos) const
+{
+    int slot = recordSlot[pos];
+    return TrackHandle(slot, slots[slot].generation);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Finds a record by class and id
+ */
+template <class T>
+T *TrackStore<T>::find(int objClass, int id)
+{
+    int slot = table[probe(objClass, id)].slot;
+    return (slot == -1) ? NULL : &records[slots[slot].pos];
+}
+
+template <class T>
+const T *TrackStore<T>::find(int objClass, int id) const
+{
+    int slot = table[probe(objClass, id)].slot;
+    return (slot == -1) ? NULL : &records[slots[slot].pos];
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Handle of a record
+ */
+template <class T>
+TrackHandle TrackStore<T>::handle(int objClass, int id) const
+{
+    int slot = table[probe(objClass, id)].slot;
+    return (slot == -1) ? TrackHandle() : TrackHandle(slot, slots[slot].generation);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Resolves a handle
+ */
+template <class T>
+int TrackStore<T>::position(const TrackHandle &h) const
+{
+    if(h.slot < 0 || h.slot >= (int)slots.size() || slots[h.slot].generation != h.generation) {
+        return -1;
+    }
+    return slots[h.slot].pos;
+}
+
+template <class T>
+T *TrackStore<T>::get(const TrackHandle &h)
+{
+    int pos = position(h);
+    return (pos == -1) ? NULL : &records[pos];
+}
+
+template <class T>
+const T *TrackStore<T>::get(const TrackHandle &h) const
+{
+    int pos = position(h);
+    return (pos == -1) ? NULL : &records[pos];
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Inserts a record
+ */
+template <class T>
+TrackHandle TrackStore<T>::insert(int objClass, int id, bool *inserted)
+{
+    unsigned int e = probe(objClass, id);
+    if(table[e].slot != -1) {
+        if(inserted) *inserted = false;
+        int slot = table[e].slot;
+        return TrackHandle(slot, slots[slot].generation);
+    }
+
+    // Take a free slot and a recycled record, or new ones (there are as many
+    // slots as records, all of them are used only if no record is recycled)
+    int slot;
+    if(!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        size_t capacity = records.capacity();
+        slot = slots.size();
+        Slot s;
+        s.generation = 0;
+        slots.push_back(s);
+        freeSlots.reserve(slots.size()); // Erasing will not allocate
+
+        records.push_back(T());
+        keys.push_back(Key());
+        recordSlot.push_back(-1);
+        if(records.capacity() != capacity) {
+            allocs++;
+        }
+    }
+    int pos = count++;
+    slots[slot].pos = pos;
+    keys[pos].objClass = objClass;
+    keys[pos].id = id;
+    recordSlot[pos] = slot;
+
+    table[e].objClass = objClass;
+    table[e].id = id;
+    table[e].slot = slot;
+
+    // Keep the table at most half full
+    if(2 * (unsigned int)count > mask + 1) {
+        rehash(2 * (mask + 1));
+    }
+
+    if(inserted) *inserted = true;
+    return TrackHandle(slot, slots[slot].generation);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Erases the record in a slot (the last live record is swapped with it, so
+ * the erased one stays behind as a recycled record). The swap is looked up
+ * by the type of the records, so a record type owning buffers should provide
+ * one exchanging them instead of copying (see e.g. DetM).
+ */
+template <class T>
+void TrackStore<T>::eraseSlot(int slot)
+{
+    int pos = slots[slot].pos;
+    unlink(probe(keys[pos].objClass, keys[pos].id));
+
+    int last = --count;
+    if(pos != last) {
+        using std::swap;
+        swap(records[pos], records[last]);
+        keys[pos] = keys[last];
+        recordSlot[pos] = recordSlot[last];
+        slots[recordSlot[pos]].pos = pos;
+    }
+
+    slots[slot].pos = -1;
+    slots[slot].generation++;
+    freeSlots.push_back(slot);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Erases a record
+ */
+template <class T>
+bool TrackStore<T>::erase(int objClass, int id)
+{
+    int slot = table[probe(objClass, id)].slot;
+    if(slot == -1) {
+        return false;
+    }
+    eraseSlot(slot);
+    return true;
+}
+
+template <class T>
+bool TrackStore<T>::erase(const TrackHandle &h)
+{
+    if(position(h) == -1) {
+        return false;
+    }
+    eraseSlot(h.slot);
+    return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Erases all the records
+ */
+template <class T>
+void TrackStore<T>::clear()
+{
+    while(count > 0) {
+        eraseSlot(recordSlot[count - 1]);
+    }
+}
+
+}
+
+#endif // _TRACK_STORE_
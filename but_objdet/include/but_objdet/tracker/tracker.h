@@ -74,6 +74,16 @@ public:
 	 * counted from the measurement and prediction.
 	*/
     virtual const cv::Mat& update(const cv::Mat& measurement, int64 miliseconds) = 0;
+
+    /**
+     * Covariance of the predicted measurement (innovation covariance), i.e.
+     * uncertainty of the prediction returned by predict for the same time.
+     * @param miliseconds  Time (= number of miliseconds passed since the last update)
+     * for which the covariance should be predicted.
+     * @param covariance  (output) Square matrix (CV_32F) of the measurement size.
+     * @return  False if the tracker does not model uncertainty of its predictions.
+     */
+    virtual bool predictCovariance(int64 miliseconds, cv::Mat& covariance) { return false; }
 };
 
 }
@@ -61,13 +61,15 @@ public:
      */
 	const cv::Mat& update(const cv::Mat& measurement, int64 miliseconds = 1000);
 
-private:
     /**
-     * Modification of Kalman filter's transition matrix according to elapsed time.
-     * It is used while predicting and updating the measurement.
-     * @param miliseconds  Elapsed time.
+     * Implementation of the virtual function from the Tracker abstract class.
+     */
+	bool predictCovariance(int64 miliseconds, cv::Mat& covariance);
+
+	/**
+     * The current covariance of the state (errorCovPost of the filter).
      */
-	void modifyTransMat(int64 miliseconds);
+	const cv::Mat& errorCov() const { return KF.errorCovPost; }
 
 private:
 	cv::KalmanFilter KF;
@@ -29,12 +29,14 @@
 #ifndef _TRACKER_KALMAN_NODE_
 #define _TRACKER_KALMAN_NODE_
 
-#include <map>
 #include <ros/ros.h> // Main header of ROS
+#include <ros/callback_queue.h>
 #include <sensor_msgs/Image.h>
+#include <boost/thread.hpp>
 
 #include "but_objdet_msgs/DetectionArray.h"
-#include "but_objdet/tracker/tracker_kalman.h"
+#include "but_objdet_msgs/Trajectory.h"
+#include "but_objdet/tracker/track_shard.h"
 
 
 // Indicates if to visualize detections and predictions in a window
@@ -44,34 +46,35 @@
 namespace but_objdet
 {
 
-/**
-  * A structure storing data related to a detection of a particular object.
-  */
-struct DetM
-{
-    but_objdet_msgs::Detection det; // Detection
-    TrackerKalman *kf; // Kalman filter for tracking of this detection
-    int ttl; // Time to live
-    int msTime; // Time of detection in milliseconds
-};
-
 /**
  * A class implementing the tracker node, which creates and maintains a Kalman filter
  * tracker for each detected object (if there is no detection of an object for
  * some time / number of frames, the tracker for that object is canceled).
+ * The filters of all the objects are kept in a KalmanBank, so the predictions
+ * requested by a service call are computed in one batch.
+ * If the parameter ~multithreaded is set, the services are served by a pool
+ * of ~service_threads threads concurrently with the processing of detections
+ * (they read snapshots published after each message, without any locks).
+ * The detections are split by their class into ~shards shards (see TrackShard),
+ * each updated by its own thread, so the classes are processed in parallel.
  * It also advertises a service for prediction of the next state of detections,
  * (either of all of the currently maintained or of some specified object class or
- * object id).
+ * object id) and publishes the predictions of all the objects for each image
+ * processed by the detectors (~frame_topic).
  *
  * @author Tomas Hodan, Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
  */
 class TrackerKalmanNode
 {
 public:
+
 	TrackerKalmanNode();
 	~TrackerKalmanNode();
 
 private:
+    // All the fields of predictions (see PredictDetections)
+    static const unsigned int ALL_FIELDS = 0xff;
+
     /**
      * ROS related initialization called from the constructor.
      */
@@ -96,11 +99,115 @@ private:
 						   but_objdet::GetObjects::Response &res);
 
     /**
-     * Conversion from a ROS Time to miliseconds.
+     * Prediction of the requested stored detections.
+     * @param classId  Class of the objects (-1 = all the classes).
+     * @param objectIds  IDs of the objects (sorted, empty = all the objects).
+     * @param spatial  Spatial query on the last detected bounding boxes
+     * (GridQuery::NONE = all the objects).
+     * @param reqTime  Time (in nanoseconds) for which the predictions
+     * are required.
+     * @param fields  Fields of the predictions to be filled in (FIELD_* flags
+     * of the PredictDetections request).
+     * @param predictions  (output) Predicted detections are appended.
+     */
+	void predictObjects(int classId, const std::vector<int> &objectIds,
+	                    const GridQuery &spatial, int64 reqTime, unsigned int fields,
+	                    std::vector<but_objdet_msgs::Detection> &predictions);
+
+    /**
+     * Prediction of trajectories of the requested stored detections.
+     * @param classId  Class of the objects (-1 = all the classes).
+     * @param objectIds  IDs of the objects (sorted, empty = all the objects).
+     * @param spatial  Spatial query on the last detected bounding boxes.
+     * @param times  Times (in nanoseconds) of the trajectories.
+     * @param variances  If to fill in the variances of the boxes.
+     * @param trajectories  (output) Predicted trajectories are appended.
+     */
+	void predictObjectTrajectories(int classId, const std::vector<int> &objectIds,
+	                               const GridQuery &spatial,
+	                               const std::vector<int64> &times, bool variances,
+	                               std::vector<but_objdet_msgs::Trajectory> &trajectories);
+
+    /**
+     * Selection of the requested stored detections of a snapshot.
+     * @param snapshot  Snapshot containing the detections.
+     * @param classId  Class of the objects (-1 = all the classes).
+     * @param objectIds  IDs of the objects (sorted, empty = all the objects).
+     * @param spatial  Spatial query on the last detected bounding boxes.
+     * @param selected  (output) Selected detections are appended.
+     * @param distances  (output) Distances of the selected detections from
+     * the point of the spatial query are appended (only for a spatial query).
+     */
+	void selectTracks(const TrackSnapshot &snapshot, int classId,
+	                  const std::vector<int> &objectIds, const GridQuery &spatial,
+	                  std::vector<const TrackView *> &selected,
+	                  std::vector<float> &distances) const;
+
+    /**
+     * Keeps only the k nearest detections (sorted by their distance).
+     * @param distances  Distances of the detections.
+     * @param k  Number of the detections to be kept.
+     * @param first  Position of the first of the detections.
+     * @param detections  The detections or their trajectories (from first
+     * on, they are replaced).
+     */
+	template <class T>
+	static void keepNearest(const std::vector<float> &distances, int k, unsigned int first,
+	                        std::vector<T> &detections);
+
+    /**
+     * Shard storing the detections of a class.
+     * @param objClass  Class of the detections.
+     * @return  Index of the shard.
+     */
+	int shardOf(int objClass) const;
+
+    /**
+     * Prediction of stored detections (in one batch).
+     * @param snapshot  Snapshot containing the detections (and the cache
+     * of their predictions).
+     * @param tracks  Stored detections (and slots of their trackers).
+     * @param reqTime  Time (in nanoseconds) for which the predictions
+     * are required.
+     * @param fields  Fields of the predictions to be filled in (FIELD_* flags
+     * of the PredictDetections request).
+     * @param predictions  (output) Predicted detections (including covariance
+     * of the predicted bounding boxes if requested) are appended.
+     */
+	void predictTracks(const TrackSnapshot &snapshot,
+	                   const std::vector<const TrackView *> &tracks, int64 reqTime,
+	                   unsigned int fields,
+	                   std::vector<but_objdet_msgs::Detection> &predictions) const;
+
+    /**
+     * Prediction of trajectories of stored detections (in one batch).
+     * @param snapshot  Snapshot containing the detections.
+     * @param tracks  Stored detections (and slots of their trackers).
+     * @param times  Times (in nanoseconds) of the trajectories.
+     * @param variances  If to fill in the variances of the boxes.
+     * @param trajectories  (output) Predicted trajectories are appended.
+     */
+	void predictTrajectories(const TrackSnapshot &snapshot,
+	                         const std::vector<const TrackView *> &tracks,
+	                         const std::vector<int64> &times, bool variances,
+	                         std::vector<but_objdet_msgs::Trajectory> &trajectories) const;
+
+    /**
+     * Copies the requested fields of a detection.
+     * @param src  Source detection.
+     * @param fields  FIELD_* flags of the PredictDetections request.
+     * @param dst  (output) Detection whose fields are set (m_id, m_class
+     * and m_bb are set always, the others are left untouched if not requested).
+     */
+	static void copyFields(const but_objdet_msgs::Detection &src, unsigned int fields,
+	                       but_objdet_msgs::Detection &dst);
+
+    /**
+     * Conversion from a ROS Time to nanoseconds.
      * @param stamp  ROS Time.
-     * @return  Miliseconds.
+     * @return  Nanoseconds.
      */
-	int rosTimeToMs(ros::Time stamp);
+	int64 rosTimeToNs(ros::Time stamp);
 
     /**
      * A callback function called when new detections are received.
@@ -108,6 +215,26 @@ private:
      */
 	void newDataCallback(const but_objdet_msgs::DetectionArrayConstPtr &detArrayMsg);
 
+    /**
+     * Processes the detections of the current message by a shard.
+     * @param s  Index of the shard.
+     */
+	void processShard(int s);
+
+    /**
+     * Main loop of a thread of a shard (processes the shard whenever
+     * a new message is received).
+     * @param s  Index of the shard.
+     */
+	void workerLoop(int s);
+
+    /**
+     * A callback function called when an image processed by the detectors
+     * is received (the predictions for its stamp are published).
+     * @param imageMsg  Image message.
+     */
+	void newFrameCallback(const sensor_msgs::ImageConstPtr &imageMsg);
+
     /**
      * A callback function called when a new Image is received. The image is used just
      * for visualization of detections and predictions, thus it doesn't influence
@@ -117,32 +244,53 @@ private:
 	void newImageCallback(const sensor_msgs::ImageConstPtr &imageMsg);
 
     /**
-     * Memory of currently considered detections.
-     * 
+     * Shards of the currently considered detections (by their class).
      */
-	
-	typedef std::map<int, DetM> _DetMem; //m_id
-        typedef std::map<int, _DetMem> DetMem; //m_class
-        DetMem detectionMem;
+	std::vector<TrackShard *> shards;
+
+    // Detections of the current message split by the shards
+    std::vector<std::vector<const but_objdet_msgs::Detection *> > batches;
+
+    // Threads of the shards (all but the first one) and their synchronization
+    boost::thread_group threads;
+    boost::mutex mutex;
+    boost::condition_variable workCond, doneCond;
+    int generation; // Number of the messages given to the threads
+    int active; // Number of the threads still processing the current message
+    bool quit; // If the threads are to be finished
+
+    bool multithreaded; // If the services are served by a pool of threads
+    ros::CallbackQueue serviceQueue; // Queue of the services (multi-threaded mode)
+    ros::AsyncSpinner *spinner; // Threads serving the services (multi-threaded mode)
+
+    int poolAllocations; // Allocations of the shards reported so far
 
 	/**
 	 * If a detection of an object didn't occur in the specified number of
-	 * last detections (specified by a value of this variable),
+	 * last detection messages (specified by a value of this variable),
 	 * it is not considered any more.
 	 */
 	int defaultTtl;
 
     /**
-	 * If a detection of an object doesn't occur again during this period,
+	 * If a detection of an object doesn't occur again during this period
+	 * (in miliseconds, measured by the stamps of the detection messages),
 	 * it is not considered any more.
 	 */
 	int defaultTtlTime;
 
+    int64 msgCount; // Number of received detection messages
+    int64 msgTime; // Stamp of the current detection message (in nanoseconds)
+    int64 latestTime; // The latest stamp of the detection messages (in nanoseconds)
+
     ros::NodeHandle nh; // NodeHandle is the main access point for communication with ROS system
 	ros::ServiceServer predictionSRV;
 	ros::ServiceServer objectsSRV; //service for providing objects
-	ros::Subscriber detSub;
+	std::vector<ros::Subscriber> detSubs; // Topics with detections
 	ros::Subscriber imgSub;
+	ros::Subscriber frameSub; // Images processed by the detectors
+	ros::Publisher predictionsPub; // Predictions for the images of frameSub
+	unsigned int frameFields; // Fields of the published predictions (~prediction_fields)
 	std::string winName;
 };
 
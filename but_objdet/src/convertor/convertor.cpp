@@ -65,6 +65,14 @@ Object Convertor::detectionToButObject(const Detection &detection)
     object.m_speed.x = detection.m_speed.x;
     object.m_speed.y = detection.m_speed.y;
     object.m_speed.z = detection.m_speed.z;
+    
+    // Covariance is available only for predictions
+    if(detection.m_cov.size() == 16) {
+        object.m_cov = cv::Mat(4, 4, CV_32F);
+        for(int k = 0; k < 16; k++) {
+            object.m_cov.at<float>(k / 4, k % 4) = detection.m_cov[k];
+        }
+    }
         
     // Convert Image msg to Mat
     try {
@@ -121,6 +129,13 @@ Detection Convertor::butObjectToDetection(const Object &object, std_msgs::Header
     detection.m_speed.x = object.m_speed.x;
     detection.m_speed.y = object.m_speed.y;
     detection.m_speed.z = object.m_speed.z;
+    
+    if(object.m_cov.rows == 4 && object.m_cov.cols == 4) {
+        detection.m_cov.resize(16);
+        for(int k = 0; k < 16; k++) {
+            detection.m_cov[k] = object.m_cov.at<float>(k / 4, k % 4);
+        }
+    }
 
 
     // Convert Mat to Image msg
@@ -0,0 +1,280 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "but_objdet/matcher/assignment.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+typedef pair<float, int> HeapItem;
+
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+AssignmentSolver::AssignmentSolver()
+{
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Solves the assignment problem
+ */
+void AssignmentSolver::solve(const SparseCostMatrix &costs, float unassignedCost, vector<int> &rowToCol)
+{
+    solveFrom(costs, unassignedCost, rowToCol, NULL);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Solves the assignment problem starting from the given column prices
+ */
+void AssignmentSolver::solve(const SparseCostMatrix &costs, float unassignedCost, vector<int> &rowToCol,
+                             vector<float> &prices)
+{
+    solveFrom(costs, unassignedCost, rowToCol, &prices);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Solves the assignment problem
+ *
+ * The greedy initialization assigns a row only to the column with the lowest
+ * reduced cost, which keeps the assignment optimal with respect to any
+ * initial prices (not higher than 0), so the prices need not come from
+ * the same problem.
+ *
+ * Columns 0..cols-1 are the real ones, column cols+i is a private "dummy"
+ * column of row i with the unassignedCost, so every row can always be
+ * assigned and an unassigned row is just a row assigned to its dummy column.
+ */
+void AssignmentSolver::solveFrom(const SparseCostMatrix &costs, float unassignedCost, vector<int> &rowToCol,
+                                 vector<float> *prices)
+{
+    int nRows = costs.rows;
+    int nCols = costs.cols + nRows;
+
+    // Initial prices (not higher than the prices of the dummy columns)
+    v.assign(nCols, 0);
+    if(prices && (int)prices->size() == costs.cols) {
+        for(int j = 0; j < costs.cols; j++) {
+            v[j] = min((*prices)[j], 0.0f);
+        }
+    }
+    colToRow.assign(nCols, -1);
+    assigned.assign(nRows, -1);
+    assignedCost.assign(nRows, 0);
+
+    dist.assign(nCols, numeric_limits<float>::max());
+    predRow.resize(nCols);
+    predCost.resize(nCols);
+    scanned.assign(nCols, 0);
+
+    // Greedy initialization - assign a row to its cheapest column if it is
+    // still free (the assignment stays optimal with respect to the prices)
+    freeRows.clear();
+    for(int i = 0; i < nRows; i++) {
+        float bestCost;
+        int bestCol = cheapestColumn(costs, unassignedCost, i, bestCost);
+
+        if(colToRow[bestCol] == -1) {
+            colToRow[bestCol] = i;
+            assigned[i] = bestCol;
+            assignedCost[i] = bestCost;
+        }
+        else {
+            freeRows.push_back(i);
+        }
+    }
+
+    // The augmenting paths end in the free columns, which requires them
+    // to have the highest price (0, as the dummy columns). The free columns
+    // with a lower initial price are raised to 0 and the rows for which
+    // the assigned column is not the cheapest one anymore are freed
+    // (which can free more columns to be raised).
+    if(prices) {
+        for(;;) {
+            bool raised = false;
+            for(int j = 0; j < costs.cols; j++) {
+                if(colToRow[j] == -1 && v[j] != 0) {
+                    v[j] = 0;
+                    raised = true;
+                }
+            }
+            if(!raised) break;
+
+            for(int i = 0; i < nRows; i++) {
+                if(assigned[i] == -1) continue;
+
+                float bestCost;
+                int bestCol = cheapestColumn(costs, unassignedCost, i, bestCost);
+                if(bestCost - v[bestCol] < assignedCost[i] - v[assigned[i]]) {
+                    colToRow[assigned[i]] = -1;
+                    assigned[i] = -1;
+                    freeRows.push_back(i);
+                }
+            }
+        }
+    }
+
+    // Assign the remaining rows using shortest augmenting paths
+    for(unsigned int r = 0; r < freeRows.size(); r++) {
+        augment(costs, unassignedCost, freeRows[r]);
+    }
+
+    rowToCol.resize(nRows);
+    for(int i = 0; i < nRows; i++) {
+        rowToCol[i] = (assigned[i] < costs.cols) ? assigned[i] : -1;
+    }
+
+    if(prices) {
+        prices->assign(v.begin(), v.begin() + costs.cols);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Column with the lowest reduced cost in a row (the dummy column if none
+ * of the entries is cheaper)
+ */
+int AssignmentSolver::cheapestColumn(const SparseCostMatrix &costs, float unassignedCost, int row, float &cost) const
+{
+    int bestCol = costs.cols + row;
+    float bestReduced = unassignedCost - v[bestCol];
+    cost = unassignedCost;
+    for(int k = costs.rowStart[row]; k < costs.rowStart[row + 1]; k++) {
+        int j = costs.colIdx[k];
+        float reduced = costs.cost[k] - v[j];
+        if(reduced < bestReduced) {
+            bestReduced = reduced;
+            bestCol = j;
+            cost = costs.cost[k];
+        }
+    }
+    return bestCol;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Lowers the distance of a column if the new one is shorter
+ */
+void AssignmentSolver::relax(int col, float d, int row, float c)
+{
+    if(scanned[col] || d >= dist[col]) return;
+
+    if(dist[col] == numeric_limits<float>::max()) {
+        touched.push_back(col);
+    }
+    dist[col] = d;
+    predRow[col] = row;
+    predCost[col] = c;
+
+    heap.push_back(HeapItem(d, col));
+    push_heap(heap.begin(), heap.end(), greater<HeapItem>());
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Finds the shortest augmenting path from a free row (Dijkstra on reduced
+ * costs) and augments the assignment along it
+ */
+void AssignmentSolver::augment(const SparseCostMatrix &costs, float unassignedCost, int row)
+{
+    touched.clear();
+    heap.clear();
+
+    // Columns reachable directly from the free row
+    for(int k = costs.rowStart[row]; k < costs.rowStart[row + 1]; k++) {
+        int j = costs.colIdx[k];
+        relax(j, costs.cost[k] - v[j], row, costs.cost[k]);
+    }
+    int dummy = costs.cols + row;
+    relax(dummy, unassignedCost - v[dummy], row, unassignedCost);
+
+    // Search until a free column is reached (the dummy column of the row
+    // is free, so there is always one)
+    int sink = -1;
+    float dMin = 0;
+    scannedCols.clear();
+    while(!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), greater<HeapItem>());
+        HeapItem item = heap.back();
+        heap.pop_back();
+
+        int j = item.second;
+        if(scanned[j] || item.first > dist[j]) continue;
+        scanned[j] = 1;
+        scannedCols.push_back(j);
+
+        if(colToRow[j] == -1) {
+            sink = j;
+            dMin = dist[j];
+            break;
+        }
+
+        // Continue through the row currently assigned to the column
+        int i = colToRow[j];
+        float h = dist[j] - (assignedCost[i] - v[j]);
+        for(int k = costs.rowStart[i]; k < costs.rowStart[i + 1]; k++) {
+            int j2 = costs.colIdx[k];
+            relax(j2, h + costs.cost[k] - v[j2], i, costs.cost[k]);
+        }
+        int dummy2 = costs.cols + i;
+        relax(dummy2, h + unassignedCost - v[dummy2], i, unassignedCost);
+    }
+
+    // Update prices of the columns with final distances
+    for(unsigned int k = 0; k < scannedCols.size(); k++) {
+        int j = scannedCols[k];
+        v[j] += dist[j] - dMin;
+    }
+
+    // Augment the assignment along the path
+    int j = sink;
+    for(;;) {
+        int i = predRow[j];
+        int next = assigned[i];
+        colToRow[j] = i;
+        assigned[i] = j;
+        assignedCost[i] = predCost[j];
+        if(i == row) break;
+        j = next;
+    }
+
+    // Reset the search state
+    for(unsigned int k = 0; k < touched.size(); k++) {
+        dist[touched[k]] = numeric_limits<float>::max();
+        scanned[touched[k]] = 0;
+    }
+}
+
+}
@@ -0,0 +1,159 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "but_objdet/matcher/bit_mask.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Floor division by 64
+ */
+static inline int wordOf(int x)
+{
+    return (x >= 0) ? (x >> 6) : -((-x + 63) >> 6);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+BitMask::BitMask()
+{
+    top = rows = 0;
+    word0 = words = 0;
+    pixels = 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Packs the mask of an object
+ */
+bool BitMask::pack(const Object &object)
+{
+    const cv::Mat &mask = object.m_mask;
+    const cv::Rect &bb = object.m_bb;
+
+    top = bb.y;
+    rows = max(0, bb.height);
+    word0 = wordOf(bb.x);
+    words = (bb.width > 0) ? wordOf(bb.x + bb.width - 1) - word0 + 1 : 0;
+    pixels = 0;
+    bits.assign(rows * words, 0);
+
+    if(mask.empty() || mask.type() != CV_8U) {
+        return false;
+    }
+
+    // Offset of the mask origin in image coordinates
+    int offX = 0, offY = 0;
+    bool wholeImage = bb.x >= 0 && bb.y >= 0 &&
+                      mask.cols >= bb.x + bb.width && mask.rows >= bb.y + bb.height &&
+                      (mask.cols != bb.width || mask.rows != bb.height);
+    if(!wholeImage) {
+        offX = bb.x;
+        offY = bb.y;
+    }
+
+    // Pixels inside both the bounding box and the mask
+    int x0 = max(bb.x, offX), x1 = min(bb.x + bb.width, offX + mask.cols);
+    int y0 = max(bb.y, offY), y1 = min(bb.y + bb.height, offY + mask.rows);
+
+    for(int y = y0; y < y1; y++) {
+        const uchar *src = mask.ptr<uchar>(y - offY);
+        uint64 *dst = &bits[(y - top) * words];
+        for(int x = x0; x < x1; x++) {
+            if(src[x - offX]) {
+                int w = wordOf(x);
+                dst[w - word0] |= (uint64)1 << (x - 64 * w);
+                pixels++;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Number of object pixels in both masks
+ */
+BUT_OBJDET_ALWAYS_INLINE int BitMask::countCommon(const BitMask &other) const
+{
+    int y0 = max(top, other.top), y1 = min(top + rows, other.top + other.rows);
+    int w0 = max(word0, other.word0), w1 = min(word0 + words, other.word0 + other.words);
+
+    if(y0 >= y1 || w0 >= w1) {
+        return 0;
+    }
+
+    // Both masks have some words now; the word offsets are applied inside
+    // the rows, so no pointer points outside the arrays
+    const uint64 *a = &bits[0];
+    const uint64 *b = &other.bits[0];
+    int common = 0;
+    for(int y = y0; y < y1; y++) {
+        const uint64 *rowA = a + (y - top) * words;
+        const uint64 *rowB = b + (y - other.top) * other.words;
+        for(int w = w0; w < w1; w++) {
+            common += popcount(rowA[w - word0] & rowB[w - other.word0]);
+        }
+    }
+
+    return common;
+}
+
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+/* -----------------------------------------------------------------------------
+ * Number of object pixels in both masks, counted by POPCNT
+ */
+BUT_OBJDET_TARGET_POPCNT
+int BitMask::countCommonPopcnt(const BitMask &other) const
+{
+    return countCommon(other);
+}
+#endif
+
+
+/* -----------------------------------------------------------------------------
+ * Number of object pixels in both masks
+ */
+int BitMask::intersection(const BitMask &other) const
+{
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+    if(cpuHasPopcnt()) {
+        return countCommonPopcnt(other);
+    }
+#endif
+    return countCommon(other);
+}
+
+}
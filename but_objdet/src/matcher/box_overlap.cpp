@@ -0,0 +1,215 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "but_objdet/cpu_features.h"
+#include "but_objdet/matcher/box_overlap.h"
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+// Products of areas and thresholds must fit into 32-bit integers
+// in the vectorized version
+const int MAX_AREA_32 = 2147483647 / 1000;
+
+
+/* -----------------------------------------------------------------------------
+ * Removes all boxes
+ */
+void BoxArray::clear()
+{
+    x0.clear(); y0.clear();
+    x1.clear(); y1.clear();
+    area.clear();
+    maxArea = 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Appends a box
+ */
+void BoxArray::push_back(const cv::Rect &bb)
+{
+    x0.push_back(bb.x);
+    y0.push_back(bb.y);
+    x1.push_back(bb.x + bb.width);
+    y1.push_back(bb.y + bb.height);
+
+    int a = (bb.width > 0 && bb.height > 0) ? bb.width * bb.height : 0;
+    area.push_back(a);
+    maxArea = max(maxArea, a);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Replaces the content by bounding boxes of the objects
+ */
+void BoxArray::assign(const Objects &objects)
+{
+    clear();
+    for(unsigned int i = 0; i < objects.size(); i++) {
+        push_back(objects[i].m_bb);
+    }
+}
+
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+/* -----------------------------------------------------------------------------
+ * Overlapping percentages of a row, 8 boxes at once (returns the number
+ * of processed boxes, the rest is left to the scalar version)
+ */
+BUT_OBJDET_TARGET_AVX2
+static int rowAvx2(int dx0, int dy0, int dx1, int dy1, int dArea, const BoxArray &preds,
+                   const int *idx, int n, int q, float minOverlap, float *out)
+{
+    int k = 0;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vdx0 = _mm256_set1_epi32(dx0), vdy0 = _mm256_set1_epi32(dy0);
+    const __m256i vdx1 = _mm256_set1_epi32(dx1), vdy1 = _mm256_set1_epi32(dy1);
+    const __m256i vdArea = _mm256_set1_epi32(dArea);
+    const __m256i vq = _mm256_set1_epi32(q);
+    const __m256i vqdArea = _mm256_set1_epi32(q * dArea);
+    const __m256i v1000 = _mm256_set1_epi32(1000);
+    const __m256 v100 = _mm256_set1_ps(100.0f);
+    const __m256 vmin = _mm256_set1_ps(minOverlap);
+
+    for(; k + 8 <= n; k += 8) {
+        __m256i px0, py0, px1, py1, pArea;
+        if(idx) {
+            __m256i vi = _mm256_loadu_si256((const __m256i *)(idx + k));
+            px0 = _mm256_i32gather_epi32(&preds.x0[0], vi, 4);
+            py0 = _mm256_i32gather_epi32(&preds.y0[0], vi, 4);
+            px1 = _mm256_i32gather_epi32(&preds.x1[0], vi, 4);
+            py1 = _mm256_i32gather_epi32(&preds.y1[0], vi, 4);
+            pArea = _mm256_i32gather_epi32(&preds.area[0], vi, 4);
+        }
+        else {
+            px0 = _mm256_loadu_si256((const __m256i *)(&preds.x0[k]));
+            py0 = _mm256_loadu_si256((const __m256i *)(&preds.y0[k]));
+            px1 = _mm256_loadu_si256((const __m256i *)(&preds.x1[k]));
+            py1 = _mm256_loadu_si256((const __m256i *)(&preds.y1[k]));
+            pArea = _mm256_loadu_si256((const __m256i *)(&preds.area[k]));
+        }
+
+        // Size of the overlapped region (negative if there is none)
+        __m256i w = _mm256_sub_epi32(_mm256_min_epi32(vdx1, px1), _mm256_max_epi32(vdx0, px0));
+        __m256i h = _mm256_sub_epi32(_mm256_min_epi32(vdy1, py1), _mm256_max_epi32(vdy0, py0));
+        __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi32(w, zero), _mm256_cmpgt_epi32(h, zero));
+        valid = _mm256_and_si256(valid, _mm256_cmpgt_epi32(pArea, zero));
+
+        // Rejection of the pairs clearly under the threshold by cross-multiplication
+        __m256i o = _mm256_mullo_epi32(_mm256_max_epi32(w, zero), _mm256_max_epi32(h, zero));
+        __m256i o1000 = _mm256_mullo_epi32(o, v1000);
+        __m256i qpArea = _mm256_mullo_epi32(vq, pArea);
+        __m256i fail = _mm256_or_si256(_mm256_cmpgt_epi32(vqdArea, o1000),
+                                       _mm256_cmpgt_epi32(qpArea, o1000));
+        valid = _mm256_andnot_si256(fail, valid);
+
+        // Percentage of the larger box and the threshold test in float
+        __m256 maxArea = _mm256_cvtepi32_ps(_mm256_max_epi32(vdArea, pArea));
+        __m256 pct = _mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(o), v100), maxArea);
+        pct = _mm256_and_ps(pct, _mm256_castsi256_ps(valid));
+        pct = _mm256_and_ps(pct, _mm256_cmp_ps(pct, vmin, _CMP_GE_OQ));
+
+        _mm256_storeu_ps(out + k, pct);
+    }
+
+    return k;
+}
+#endif
+
+
+/* -----------------------------------------------------------------------------
+ * Overlapping percentages of one box and the boxes of an array
+ */
+void BoxOverlap::row(const cv::Rect &det, const BoxArray &preds, const int *idx, int n,
+                     float minOverlap, float *out)
+{
+    int dx0 = det.x, dy0 = det.y;
+    int dx1 = det.x + det.width, dy1 = det.y + det.height;
+    int dArea = (det.width > 0 && det.height > 0) ? det.width * det.height : 0;
+
+    if(dArea == 0) {
+        fill(out, out + n, 0.0f);
+        return;
+    }
+
+    int q = thresholdQ(minOverlap);
+    int k = 0;
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+    if(q <= 1000 && dArea <= MAX_AREA_32 && preds.maxArea <= MAX_AREA_32 && cpuHasAvx2()) {
+        k = rowAvx2(dx0, dy0, dx1, dy1, dArea, preds, idx, n, q, minOverlap, out);
+    }
+#endif
+
+    // Scalar version (and the remaining boxes)
+    for(; k < n; k++) {
+        int j = idx ? idx[k] : k;
+        int pArea = preds.area[j];
+
+        int w = min(dx1, preds.x1[j]) - max(dx0, preds.x0[j]);
+        int h = min(dy1, preds.y1[j]) - max(dy0, preds.y0[j]);
+        if(w <= 0 || h <= 0 || pArea == 0) {
+            out[k] = 0;
+            continue;
+        }
+
+        int64 o = (int64)w * h;
+        if(o * 1000 < (int64)q * dArea || o * 1000 < (int64)q * pArea) {
+            out[k] = 0;
+            continue;
+        }
+
+        float overlapped = ((float)o * 100) / (float)max(dArea, pArea);
+        out[k] = (overlapped >= minOverlap) ? overlapped : 0;
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Overlapping percentages of all pairs of boxes from two arrays
+ */
+void BoxOverlap::matrix(const BoxArray &dets, const BoxArray &preds, float minOverlap, cv::Mat &out)
+{
+    out.create(dets.size(), preds.size(), CV_32F);
+
+    for(int i = 0; i < dets.size(); i++) {
+        cv::Rect det(dets.x0[i], dets.y0[i], dets.x1[i] - dets.x0[i], dets.y1[i] - dets.y0[i]);
+        row(det, preds, NULL, preds.size(), minOverlap, out.ptr<float>(i));
+    }
+}
+
+}
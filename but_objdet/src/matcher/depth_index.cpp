@@ -0,0 +1,180 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "but_objdet/matcher/depth_index.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+DepthIndex::DepthIndex(float absTol, float relTol)
+{
+    setTolerance(absTol, relTol);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets the tolerance
+ */
+void DepthIndex::setTolerance(float absTol, float relTol)
+{
+    this->absTol = absTol;
+    this->relTol = relTol;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Builds the index
+ */
+void DepthIndex::build(const Objects &objects)
+{
+    map<int, Bucket>::iterator it;
+    for(it = buckets.begin(); it != buckets.end(); it++) {
+        it->second.sorted.clear();
+        it->second.unknown.clear();
+    }
+
+    depths.resize(objects.size());
+    for(unsigned int j = 0; j < objects.size(); j++) {
+        Bucket &bucket = buckets[objects[j].m_class];
+        float z = objects[j].m_pos_2D.z;
+        depths[j] = z;
+        if(z > 0) {
+            bucket.sorted.push_back(make_pair(z, (int)j));
+        }
+        else {
+            bucket.unknown.push_back(j);
+        }
+    }
+
+    for(it = buckets.begin(); it != buckets.end(); it++) {
+        sort(it->second.sorted.begin(), it->second.sorted.end());
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Range of the sorted depths of a bucket passing with the given depth
+ *
+ * The passing depths form a contiguous range of the sorted ones, its ends
+ * are found by binary search using the same test as passes() (so that
+ * the rounding at the ends is the same).
+ */
+void DepthIndex::range(const Bucket &bucket, float z, int &first, int &last) const
+{
+    first = 0;
+    last = bucket.sorted.size();
+    if(z <= 0) return;
+
+    // The first depth which is not too low
+    int lo = 0, hi = bucket.sorted.size();
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        float zp = bucket.sorted[mid].first;
+        if(zp >= z || passes(z, zp, absTol, relTol)) hi = mid;
+        else lo = mid + 1;
+    }
+    first = lo;
+
+    // The first depth which is too high
+    hi = bucket.sorted.size();
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        float zp = bucket.sorted[mid].first;
+        if(zp > z && !passes(z, zp, absTol, relTol)) hi = mid;
+        else lo = mid + 1;
+    }
+    last = lo;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Number of the objects of the given class passing with a detection
+ */
+int DepthIndex::count(int objClass, float z) const
+{
+    map<int, Bucket>::const_iterator it = buckets.find(objClass);
+    if(it == buckets.end()) return 0;
+
+    int first, last;
+    range(it->second, z, first, last);
+    return (last - first) + it->second.unknown.size();
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Finds the objects of the given class passing with a detection
+ */
+void DepthIndex::query(int objClass, float z, vector<int> &candidates) const
+{
+    candidates.clear();
+
+    map<int, Bucket>::const_iterator it = buckets.find(objClass);
+    if(it == buckets.end()) return;
+
+    const Bucket &bucket = it->second;
+    int first, last;
+    range(bucket, z, first, last);
+    for(int k = first; k < last; k++) {
+        candidates.push_back(bucket.sorted[k].second);
+    }
+    sort(candidates.begin(), candidates.end());
+
+    // Objects with unknown depth (already in ascending order)
+    merged.resize(candidates.size() + bucket.unknown.size());
+    merge(candidates.begin(), candidates.end(), bucket.unknown.begin(), bucket.unknown.end(), merged.begin());
+    candidates.swap(merged);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Removes the candidates which do not pass with a detection
+ */
+void DepthIndex::prune(int objClass, float z, vector<int> &candidates) const
+{
+    if(z <= 0) return;
+
+    if(count(objClass, z) < (int)candidates.size()) {
+        query(objClass, z, candidates);
+        return;
+    }
+
+    unsigned int kept = 0;
+    for(unsigned int c = 0; c < candidates.size(); c++) {
+        if(passes(z, depths[candidates[c]], absTol, relTol)) {
+            candidates[kept++] = candidates[c];
+        }
+    }
+    candidates.resize(kept);
+}
+
+}
@@ -0,0 +1,153 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ 
+#include <algorithm>
+#include <cfloat>
+
+#include "but_objdet/matcher/matcher_hungarian.h"
+ 
+using namespace std;
+ 
+
+namespace but_objdet
+{
+ 
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+MatcherHungarian::MatcherHungarian(float min, bool warm)
+{
+    minOverlap = min;
+    depthGate = false;
+    warmStart = warm;
+}
+ 
+ 
+/* -----------------------------------------------------------------------------
+ * Matching function
+ *
+ * The cost of a pair is the negative overlapping percentage (see
+ * BoxOverlap), leaving a detection unmatched costs 0, so the
+ * optimal assignment maximizes the sum of overlaps of the matched pairs.
+ *
+ * In the warm start mode, the prices are kept in the range of the costs
+ * [-100, 0] (any prices are valid, this only stops them from drifting
+ * over the frames), new predictions start from 0.
+ */
+void MatcherHungarian::match(const Objects &detections, const Objects &predictions, Matches &matches)
+{
+    matches.resize(detections.size());
+    
+    // Bucket the predictions by class and build a grid over each bucket
+    grids.build(predictions);
+    predBoxes.assign(predictions);
+    if(depthGate) {
+        depthIndex.build(predictions);
+    }
+    
+    // Sparse cost matrix of the pairs which overlap enough
+    costs.reset(predictions.size());
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        grids.query(detections[i].m_class, detections[i].m_bb, candidates);
+        if(depthGate) {
+            depthIndex.prune(detections[i].m_class, detections[i].m_pos_2D.z, candidates);
+        }
+        
+        scores.resize(candidates.size());
+        if(!candidates.empty()) {
+            BoxOverlap::row(detections[i].m_bb, predBoxes, &candidates[0], candidates.size(),
+                            minOverlap, &scores[0]);
+        }
+        
+        for(unsigned int c = 0; c < candidates.size(); c++) {
+            if(scores[c] > 0) {
+                costs.addEntry(candidates[c], -scores[c]);
+            }
+        }
+        costs.endRow();
+    }
+    
+    // Optimal one-to-one assignment
+    if(warmStart) {
+        prices.resize(predictions.size());
+        for(unsigned int j = 0; j < predictions.size(); j++) {
+            pair<int, int> key(predictions[j].m_class, predictions[j].m_id);
+            vector<pair<pair<int, int>, float> >::const_iterator it = lower_bound(pricesById.begin(), pricesById.end(),
+                                                                                  make_pair(key, -FLT_MAX));
+            prices[j] = (it != pricesById.end() && it->first == key) ? it->second : 0;
+        }
+        
+        solver.solve(costs, 0, assignment, prices);
+        
+        // Keep the prices of the current predictions only
+        pricesById.clear();
+        for(unsigned int j = 0; j < predictions.size(); j++) {
+            pricesById.push_back(make_pair(make_pair(predictions[j].m_class, predictions[j].m_id),
+                                           min(0.0f, max(-100.0f, prices[j]))));
+        }
+        sort(pricesById.begin(), pricesById.end());
+    }
+    else {
+        solver.solve(costs, 0, assignment);
+    }
+    
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        matches[i].detId = i;
+        matches[i].predId = assignment[i];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets the depth gate (negative absTol disables it)
+ */
+void MatcherHungarian::setDepthTolerance(float absTol, float relTol)
+{
+    depthGate = (absTol >= 0);
+    depthIndex.setTolerance(absTol, relTol);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets minimum overlap (in percent) which must be between a detection
+ * and a prediction to be matched
+ */
+void MatcherHungarian::setMinOverlap(float min)
+{
+    minOverlap = min;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Enables/disables the warm start mode
+ */
+void MatcherHungarian::setWarmStart(bool warm)
+{
+    warmStart = warm;
+    pricesById.clear();
+}
+
+}
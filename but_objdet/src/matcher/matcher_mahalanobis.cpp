@@ -0,0 +1,180 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "but_objdet/matcher/matcher_mahalanobis.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+MatcherMahalanobis::MatcherMahalanobis(float gate)
+{
+    this->gate = gate;
+    defaultSigma = 0.1;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Matching function
+ *
+ * The cost of a pair is its squared distance minus the gate (so that it is
+ * negative for all the candidates), leaving a detection unmatched costs 0.
+ */
+void MatcherMahalanobis::match(const Objects &detections, const Objects &predictions, Matches &matches)
+{
+    matches.resize(detections.size());
+    
+    // Factorize covariances of the predictions and bound their gates
+    factors.resize(10 * predictions.size());
+    gateRects.resize(predictions.size());
+    for(unsigned int j = 0; j < predictions.size(); j++) {
+        const Object &pred = predictions[j];
+        float *L = &factors[10 * j];
+        
+        bool valid = false;
+        if(pred.m_cov.rows == 4 && pred.m_cov.cols == 4 && pred.m_cov.type() == CV_32F) {
+            float cov[16];
+            for(int k = 0; k < 16; k++) {
+                cov[k] = pred.m_cov.at<float>(k / 4, k % 4);
+            }
+            valid = cholesky4(cov, L);
+        }
+        
+        // Uncertainty proportional to the bounding box size if not known
+        if(!valid) {
+            float sw = max(1.0f, defaultSigma * pred.m_bb.width);
+            float sh = max(1.0f, defaultSigma * pred.m_bb.height);
+            float cov[16] = { sw * sw, 0, 0, 0,
+                              0, sh * sh, 0, 0,
+                              0, 0, sw * sw, 0,
+                              0, 0, 0, sh * sh };
+            cholesky4(cov, L);
+        }
+        
+        // The gate is bounded by the marginal of the x and y coordinates:
+        // |dx| <= sqrt(gate * var(x)), where sqrt(var(x)) = L[0] and
+        // var(y) = L[1]^2 + L[2]^2
+        int rx = (int)ceil(sqrt(gate) * L[0]);
+        int ry = (int)ceil(sqrt(gate * (L[1] * L[1] + L[2] * L[2])));
+        gateRects[j] = cv::Rect(pred.m_bb.x - rx, pred.m_bb.y - ry, 2 * rx + 1, 2 * ry + 1);
+    }
+    
+    grids.build(predictions, gateRects);
+    
+    // Sparse cost matrix of the pairs within the gate
+    costs.reset(predictions.size());
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        const cv::Rect &bb = detections[i].m_bb;
+        grids.query(detections[i].m_class, cv::Rect(bb.x, bb.y, 1, 1), candidates);
+        
+        for(unsigned int c = 0; c < candidates.size(); c++) {
+            int j = candidates[c];
+            const cv::Rect &pbb = predictions[j].m_bb;
+            float d[4] = { (float)(bb.x - pbb.x), (float)(bb.y - pbb.y),
+                           (float)(bb.width - pbb.width), (float)(bb.height - pbb.height) };
+            
+            float dist = distance4(&factors[10 * j], d);
+            if(dist <= gate) {
+                costs.addEntry(j, dist - gate);
+            }
+        }
+        costs.endRow();
+    }
+    
+    // Optimal one-to-one assignment
+    solver.solve(costs, 0, assignment);
+    
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        matches[i].detId = i;
+        matches[i].predId = assignment[i];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Cholesky factorization of a 4x4 covariance matrix (the factor is stored
+ * row by row: L00, L10, L11, L20, L21, L22, L30, L31, L32, L33)
+ */
+bool MatcherMahalanobis::cholesky4(const float *cov, float *L)
+{
+    for(int r = 0, k = 0; r < 4; r++) {
+        for(int c = 0; c <= r; c++, k++) {
+            float sum = cov[4 * r + c];
+            for(int m = 0; m < c; m++) {
+                sum -= L[r * (r + 1) / 2 + m] * L[c * (c + 1) / 2 + m];
+            }
+            if(r == c) {
+                if(sum <= 0) return false;
+                L[k] = sqrt(sum);
+            }
+            else {
+                L[k] = sum / L[c * (c + 1) / 2 + c];
+            }
+        }
+    }
+    return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Squared Mahalanobis distance: |y|^2, where L * y = d
+ */
+float MatcherMahalanobis::distance4(const float *L, const float *d)
+{
+    float y0 = d[0] / L[0];
+    float y1 = (d[1] - L[1] * y0) / L[2];
+    float y2 = (d[2] - L[3] * y0 - L[4] * y1) / L[5];
+    float y3 = (d[3] - L[6] * y0 - L[7] * y1 - L[8] * y2) / L[9];
+    return y0 * y0 + y1 * y1 + y2 * y2 + y3 * y3;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets the gate
+ */
+void MatcherMahalanobis::setGate(float gate)
+{
+    this->gate = gate;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets the uncertainty of predictions without covariance
+ */
+void MatcherMahalanobis::setDefaultSigma(float sigma)
+{
+    defaultSigma = sigma;
+}
+
+}
@@ -0,0 +1,177 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "but_objdet/matcher/matcher_mask.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+MatcherMask::MatcherMask(float min)
+{
+    minIoU = min;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Matching function
+ *
+ * The cost of a pair is the negative IoU, leaving a detection unmatched
+ * costs 0, so the optimal assignment maximizes the sum of IoUs of the matched
+ * pairs (as in MatcherHungarian).
+ */
+void MatcherMask::match(const Objects &detections, const Objects &predictions, Matches &matches)
+{
+    matches.resize(detections.size());
+
+    packMasks(detections, detMasks, detHasMask);
+    packMasks(predictions, predMasks, predHasMask);
+
+    // Bucket the predictions by class and build a grid over each bucket
+    grids.build(predictions);
+
+    // Sparse cost matrix of the pairs with a sufficient IoU
+    costs.reset(predictions.size());
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        const cv::Rect &detBB = detections[i].m_bb;
+        grids.query(detections[i].m_class, detBB, candidates);
+
+        for(unsigned int c = 0; c < candidates.size(); c++) {
+            int j = candidates[c];
+            const cv::Rect &predBB = predictions[j].m_bb;
+
+            // Masks are cropped to the bounding boxes, so they can intersect
+            // only inside the intersection of the boxes
+            cv::Rect boxInter = detBB & predBB;
+            if(boxInter.area() <= 0) continue;
+
+            float score;
+            if(detHasMask[i] && predHasMask[j]) {
+                score = maskIoU(detMasks[i], predMasks[j], boxInter);
+            }
+            else {
+                score = boxIoU(detBB, predBB);
+            }
+
+            if(score > 0 && score >= minIoU) {
+                costs.addEntry(j, -score);
+            }
+        }
+        costs.endRow();
+    }
+
+    // Optimal one-to-one assignment
+    solver.solve(costs, 0, assignment);
+
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        matches[i].detId = i;
+        matches[i].predId = assignment[i];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Packs masks of the objects
+ */
+void MatcherMask::packMasks(const Objects &objects, vector<BitMask> &masks, vector<char> &hasMask)
+{
+    if(masks.size() < objects.size()) {
+        masks.resize(objects.size());
+    }
+    hasMask.resize(objects.size());
+
+    for(unsigned int i = 0; i < objects.size(); i++) {
+        hasMask[i] = masks[i].pack(objects[i]);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * IoU (in percent) of two packed masks
+ *
+ * The intersection can not be larger than the smaller mask nor the
+ * intersection of the bounding boxes, which gives an upper bound of the IoU
+ * (it grows with the intersection) - the masks are compared only if
+ * the bound reaches minIoU.
+ */
+float MatcherMask::maskIoU(const BitMask &det, const BitMask &pred, const cv::Rect &boxInter) const
+{
+    int cDet = det.count(), cPred = pred.count();
+    int bound = min(min(cDet, cPred), boxInter.area());
+    if(bound == 0 || (float)bound * 100 < minIoU * (float)(cDet + cPred - bound)) {
+        return 0;
+    }
+
+    int common = det.intersection(pred);
+    if(common == 0) {
+        return 0;
+    }
+    return (float)common * 100 / (float)(cDet + cPred - common);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * IoU (in percent) of two objects
+ */
+float MatcherMask::iou(const Object &det, const Object &pred)
+{
+    BitMask detMask, predMask;
+    if(detMask.pack(det) && predMask.pack(pred)) {
+        int common = detMask.intersection(predMask);
+        int all = detMask.count() + predMask.count() - common;
+        return (all > 0) ? (float)common * 100 / (float)all : 0;
+    }
+
+    return boxIoU(det.m_bb, pred.m_bb);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * IoU (in percent) of two bounding boxes
+ */
+float MatcherMask::boxIoU(const cv::Rect &det, const cv::Rect &pred)
+{
+    int common = (det & pred).area();
+    int all = det.area() + pred.area() - common;
+    return (all > 0 && common > 0) ? (float)common * 100 / (float)all : 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets minimal IoU (in percent) of a detection and a prediction to be matched
+ */
+void MatcherMask::setMinIoU(float min)
+{
+    minIoU = min;
+}
+
+}
@@ -39,6 +39,7 @@ namespace but_objdet
  MatcherOverlap::MatcherOverlap(float min)
  {
     minOverlap = min;
+    depthGate = false;
  }
  
  
@@ -47,73 +48,54 @@ namespace but_objdet
  *
  * A detection and a prediction are considered as similar, if they are of the
  * same class (m_class) and their overlapping area represents at least minOverlap%
- * of each of them.
+ * of each of them. The overlap is tested only for the candidates returned
+ * by the grid of the detection class (the result is the same as if all
+ * predictions were tested), using the batched kernel from BoxOverlap.
+ * If the depth gate is enabled, the candidates are also pruned by depth
+ * (see DepthIndex) before any overlap is computed.
  */
 void MatcherOverlap::match(const Objects &detections, const Objects &predictions, Matches &matches)
 {
     matches.resize(detections.size());
     
+    // Bucket the predictions by class and build a grid over each bucket
+    grids.build(predictions);
+    predBoxes.assign(predictions);
+    if(depthGate) {
+        depthIndex.build(predictions);
+    }
+    
     // Take each detection and find the most overlapping prediction
     for(unsigned int i = 0; i < detections.size(); i++) {
-    
-        // Get left/right X and top/bottom Y coordinates of detection BB
-        int detLeftX = detections[i].m_bb.x;
-        int detRightX = detections[i].m_bb.x + detections[i].m_bb.width;
-        int detTopY = detections[i].m_bb.y;
-        int detBottomY = detections[i].m_bb.y + detections[i].m_bb.height;
-        
-        // Area of detection BB
-        float detArea = detections[i].m_bb.width * detections[i].m_bb.height;
         
         float bestOverlapped = 0; // The best overlapping percentage so far
         int bestPredId = -1; // The most similar prediction so far
         
-        // Go through all predictions and find the most similar one
-        for(unsigned int j = 0; j < predictions.size(); j++) {
+        // Only the predictions of the same class sharing a grid cell with
+        // the detection can overlap it
+        grids.query(detections[i].m_class, detections[i].m_bb, candidates);
         
-            // If the prediction is not from the same class, do not consider it
-            if(detections[i].m_class != predictions[j].m_class) continue;
+        // Reject the candidates too far in depth (or take the ones close
+        // in depth if there are less of them)
+        if(depthGate) {
+            depthIndex.prune(detections[i].m_class, detections[i].m_pos_2D.z, candidates);
+        }
         
-            float overlapped = 0; // Overlapping percentage (the smaller one of both BBs)
+        // Compute overlaps with all the candidates at once
+        scores.resize(candidates.size());
+        if(!candidates.empty()) {
+            BoxOverlap::row(detections[i].m_bb, predBoxes, &candidates[0], candidates.size(),
+                            minOverlap, &scores[0]);
+        }
         
-            // Get left/right X and top/bottom Y coordinates of prediction BB
-            int predLeftX = predictions[j].m_bb.x;
-            int predRightX = predictions[j].m_bb.x + predictions[j].m_bb.width;
-            int predTopY = predictions[j].m_bb.y;
-            int predBottomY = predictions[j].m_bb.y + predictions[j].m_bb.height;
-            
-            // Area of prediction BB
-            float predArea = predictions[i].m_bb.width * predictions[j].m_bb.height;
-            
-            // Test if detection BB overlaps with prediction BB
-            if(detRightX > predLeftX && detLeftX < predRightX && // Test if the BBs overlap in X direction
-               detBottomY > predTopY && detTopY < predBottomY) { // Test if the BBs overlap in Y direction
-                
-                // Get left/right X and top/bottom Y coordinates of the overlapped region
-                int overlapLeftX = max(detLeftX, predLeftX);
-                int overlapRightX = min(detRightX, predRightX);
-                int overlapTopY = max(detTopY, predTopY);
-                int overlapBottomY = min(detBottomY, predBottomY);
-                
-                // Calculate area of the overlapped region
-                float overlapArea = (overlapRightX - overlapLeftX) * (overlapBottomY - overlapTopY);
-                
-                // Calculate how many percent of detection BB is overlapped
-                // (do the same also for predicition BB)
-                float detOverlapped = (overlapArea * 100) / detArea;
-                float predOverlapped = (overlapArea * 100) / predArea;
-                
-                // Overlapping area must represent more than minOverlap%
-                // (for both, detection BB and prediction BB)
-                if(detOverlapped >= minOverlap && predOverlapped >= minOverlap) {
-                   overlapped = min(detOverlapped, predOverlapped);
-                }
-            }
+        // Go through the candidates (in the order of predictions) and find
+        // the most similar one
+        for(unsigned int c = 0; c < candidates.size(); c++) {
             
             // Test if this prediction is the best so far
-            if(overlapped > bestOverlapped) {
-                bestOverlapped = overlapped;
-                bestPredId = j;
+            if(scores[c] > bestOverlapped) {
+                bestOverlapped = scores[c];
+                bestPredId = candidates[c];
             }
         }
         
@@ -125,6 +107,25 @@ void MatcherOverlap::match(const Objects &detections, const Objects &predictions
 }
 
 
+/* -----------------------------------------------------------------------------
+ * Overlapping percentage of two bounding boxes
+ */
+float MatcherOverlap::overlap(const cv::Rect &det, const cv::Rect &pred, float minOverlap)
+{
+    return BoxOverlap::pair(det, pred, minOverlap);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets the depth gate (negative absTol disables it)
+ */
+void MatcherOverlap::setDepthTolerance(float absTol, float relTol)
+{
+    depthGate = (absTol >= 0);
+    depthIndex.setTolerance(absTol, relTol);
+}
+
+
 /* -----------------------------------------------------------------------------
  * Sets minimum overlap (in percent) which must be between a detection
  * and a prediction to be considered as similar (the overlapping
@@ -0,0 +1,310 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "but_objdet/matcher/matcher_parallel.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+// Number of components taken from the queue at once
+const int COMPONENTS_CHUNK = 16;
+
+// Problems with fewer detections are solved by the calling thread only
+const int MIN_PARALLEL_ROWS = 64;
+
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+MatcherParallel::MatcherParallel(float min, int nThreads)
+{
+    minOverlap = min;
+    generation = 0;
+    active = 0;
+    nextComp = 0;
+    quit = false;
+
+    if(nThreads <= 0) {
+        nThreads = max(1u, boost::thread::hardware_concurrency());
+    }
+    workers.resize(nThreads);
+
+    // The calling thread works as workers[0]
+    for(int w = 1; w < nThreads; w++) {
+        threads.create_thread(boost::bind(&MatcherParallel::workerLoop, this, w));
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Destructor
+ */
+MatcherParallel::~MatcherParallel()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        quit = true;
+    }
+    workCond.notify_all();
+    threads.join_all();
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Matching function
+ */
+void MatcherParallel::match(const Objects &detections, const Objects &predictions, Matches &matches)
+{
+    int nDet = detections.size();
+    int nPred = predictions.size();
+    matches.resize(nDet);
+    
+    // 1) Gating graph
+    //--------------------------------------------------------------------------
+    grids.build(predictions);
+    predBoxes.assign(predictions);
+    
+    graph.reset(nPred);
+    for(int i = 0; i < nDet; i++) {
+        grids.query(detections[i].m_class, detections[i].m_bb, candidates);
+        
+        scores.resize(candidates.size());
+        if(!candidates.empty()) {
+            BoxOverlap::row(detections[i].m_bb, predBoxes, &candidates[0], candidates.size(),
+                            minOverlap, &scores[0]);
+        }
+        
+        for(unsigned int c = 0; c < candidates.size(); c++) {
+            if(scores[c] > 0) {
+                graph.addEntry(candidates[c], -scores[c]);
+            }
+        }
+        graph.endRow();
+    }
+    
+    // 2) Connected components (detection i is node i, prediction j is node nDet + j)
+    //--------------------------------------------------------------------------
+    parent.resize(nDet + nPred);
+    for(int n = 0; n < nDet + nPred; n++) {
+        parent[n] = n;
+    }
+    for(int i = 0; i < nDet; i++) {
+        for(int k = graph.rowStart[i]; k < graph.rowStart[i + 1]; k++) {
+            int a = findRoot(i);
+            int b = findRoot(nDet + graph.colIdx[k]);
+            if(a != b) parent[b] = a;
+        }
+    }
+    
+    // Group the detections by components (detections without any edge
+    // stay unmatched)
+    compOf.assign(nDet + nPred, -1);
+    compStart.assign(1, 0);
+    int nComp = 0;
+    for(int i = 0; i < nDet; i++) {
+        if(graph.rowStart[i] == graph.rowStart[i + 1]) continue;
+        int root = findRoot(i);
+        if(compOf[root] == -1) {
+            compOf[root] = nComp++;
+            compStart.push_back(0);
+        }
+        compStart[compOf[root] + 1]++;
+    }
+    for(int c = 0; c < nComp; c++) {
+        compStart[c + 1] += compStart[c];
+    }
+    compRows.resize(compStart[nComp]);
+    vector<int> pos(compStart.begin(), compStart.end() - 1);
+    for(int i = 0; i < nDet; i++) {
+        if(graph.rowStart[i] == graph.rowStart[i + 1]) continue;
+        compRows[pos[compOf[findRoot(i)]]++] = i;
+    }
+    
+    // 3) Solve the components
+    //--------------------------------------------------------------------------
+    assignment.assign(nDet, -1);
+    for(unsigned int w = 0; w < workers.size(); w++) {
+        if((int)workers[w].localCol.size() < nPred) {
+            workers[w].localCol.resize(nPred, -1);
+        }
+    }
+    
+    if(workers.size() == 1 || compStart[nComp] < MIN_PARALLEL_ROWS) {
+        for(int c = 0; c < nComp; c++) {
+            solveComponent(c, workers[0]);
+        }
+    }
+    else {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            nextComp = 0;
+            active = workers.size() - 1;
+            generation++;
+        }
+        workCond.notify_all();
+        
+        solveComponents(workers[0]);
+        
+        boost::mutex::scoped_lock lock(mutex);
+        while(active > 0) {
+            doneCond.wait(lock);
+        }
+    }
+    
+    for(int i = 0; i < nDet; i++) {
+        matches[i].detId = i;
+        matches[i].predId = assignment[i];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Main loop of a pool thread
+ */
+void MatcherParallel::workerLoop(int w)
+{
+    int seen = 0;
+    
+    for(;;) {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while(generation == seen && !quit) {
+                workCond.wait(lock);
+            }
+            if(quit) return;
+            seen = generation;
+        }
+        
+        solveComponents(workers[w]);
+        
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            if(--active == 0) {
+                doneCond.notify_one();
+            }
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Solves components taken from the shared queue until there are none left
+ */
+void MatcherParallel::solveComponents(Worker &worker)
+{
+    int nComp = compStart.size() - 1;
+    
+    for(;;) {
+        int first;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            first = nextComp;
+            nextComp += COMPONENTS_CHUNK;
+        }
+        if(first >= nComp) return;
+        
+        int last = min(first + COMPONENTS_CHUNK, nComp);
+        for(int c = first; c < last; c++) {
+            solveComponent(c, worker);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Solves the assignment of one component (the components share no detections
+ * nor predictions, so they can be solved concurrently)
+ */
+void MatcherParallel::solveComponent(int c, Worker &worker)
+{
+    // A single detection just takes the best of its predictions
+    if(compStart[c + 1] - compStart[c] == 1) {
+        int i = compRows[compStart[c]];
+        int best = graph.rowStart[i];
+        for(int k = best + 1; k < graph.rowStart[i + 1]; k++) {
+            if(graph.cost[k] < graph.cost[best]) best = k;
+        }
+        assignment[i] = graph.colIdx[best];
+        return;
+    }
+    
+    // Local cost matrix of the component
+    worker.costs.reset(0);
+    worker.globalCol.clear();
+    for(int r = compStart[c]; r < compStart[c + 1]; r++) {
+        int i = compRows[r];
+        for(int k = graph.rowStart[i]; k < graph.rowStart[i + 1]; k++) {
+            int j = graph.colIdx[k];
+            if(worker.localCol[j] == -1) {
+                worker.localCol[j] = worker.globalCol.size();
+                worker.globalCol.push_back(j);
+            }
+            worker.costs.addEntry(worker.localCol[j], graph.cost[k]);
+        }
+        worker.costs.endRow();
+    }
+    worker.costs.cols = worker.globalCol.size();
+    
+    worker.solver.solve(worker.costs, 0, worker.rowToCol);
+    
+    for(int r = compStart[c]; r < compStart[c + 1]; r++) {
+        int col = worker.rowToCol[r - compStart[c]];
+        assignment[compRows[r]] = (col == -1) ? -1 : worker.globalCol[col];
+    }
+    for(unsigned int k = 0; k < worker.globalCol.size(); k++) {
+        worker.localCol[worker.globalCol[k]] = -1;
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Finds the representative of a node of the gating graph (with path halving)
+ */
+int MatcherParallel::findRoot(int node)
+{
+    while(parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets minimum overlap (in percent) which must be between a detection
+ * and a prediction to be matched
+ */
+void MatcherParallel::setMinOverlap(float min)
+{
+    minOverlap = min;
+}
+
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "but_objdet/matcher/matcher_rotated.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+MatcherRotated::MatcherRotated(float min)
+{
+    minOverlap = min;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Matching function
+ *
+ * The cost of a pair is the negative overlapping percentage of the rotated
+ * boxes, leaving a detection unmatched costs 0 (as in MatcherHungarian).
+ */
+void MatcherRotated::match(const Objects &detections, const Objects &predictions, Matches &matches)
+{
+    matches.resize(detections.size());
+
+    detBoxes.assign(detections);
+    predBoxes.assign(predictions);
+
+    // Bucket the predictions by class and build a grid over the bounds
+    // of their rotated boxes
+    predBounds.resize(predictions.size());
+    for(unsigned int j = 0; j < predictions.size(); j++) {
+        predBounds[j] = predBoxes.bounds(j);
+    }
+    grids.build(predictions, predBounds);
+
+    // Sparse cost matrix of the pairs which overlap enough
+    costs.reset(predictions.size());
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        if(detBoxes.area[i] > 0) {
+            grids.query(detections[i].m_class, detBoxes.bounds(i), candidates);
+        }
+        else {
+            candidates.clear();
+        }
+
+        scores.resize(candidates.size());
+        if(!candidates.empty()) {
+            RotatedOverlap::row(detBoxes, i, predBoxes, &candidates[0], candidates.size(),
+                                minOverlap, &scores[0]);
+        }
+
+        for(unsigned int c = 0; c < candidates.size(); c++) {
+            if(scores[c] > 0) {
+                costs.addEntry(candidates[c], -scores[c]);
+            }
+        }
+        costs.endRow();
+    }
+
+    // Optimal one-to-one assignment
+    solver.solve(costs, 0, assignment);
+
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        matches[i].detId = i;
+        matches[i].predId = assignment[i];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets minimum overlap (in percent) which must be between a detection
+ * and a prediction to be matched
+ */
+void MatcherRotated::setMinOverlap(float min)
+{
+    minOverlap = min;
+}
+
+}
@@ -0,0 +1,257 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "but_objdet/matcher/rotated_overlap.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+// Sine/cosine smaller than this is considered to be 0 (axis-aligned boxes)
+const float AXIS_EPS = 1e-6f;
+
+// Maximal number of vertices of an intersection of two quadrilaterals
+const int MAX_VERTICES = 8;
+
+
+/* -----------------------------------------------------------------------------
+ * Removes all boxes
+ */
+void RotatedBoxArray::clear()
+{
+    cx.clear(); cy.clear();
+    hw.clear(); hh.clear();
+    c.clear(); s.clear();
+    radius.clear();
+    area.clear();
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Appends a box
+ */
+void RotatedBoxArray::push_back(const cv::Rect &bb, float angle)
+{
+    float a = angle * (float)CV_PI / 180;
+    float w = max(0, bb.width) * 0.5f, h = max(0, bb.height) * 0.5f;
+
+    cx.push_back(bb.x + bb.width * 0.5f);
+    cy.push_back(bb.y + bb.height * 0.5f);
+    hw.push_back(w);
+    hh.push_back(h);
+    c.push_back(cos(a));
+    s.push_back(sin(a));
+    radius.push_back(sqrt(w * w + h * h));
+    area.push_back(4 * w * h);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Replaces the content by rotated boxes of the objects
+ */
+void RotatedBoxArray::assign(const Objects &objects)
+{
+    clear();
+    for(unsigned int i = 0; i < objects.size(); i++) {
+        push_back(objects[i].m_bb, objects[i].m_angle);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Axis-aligned rectangle containing a box
+ */
+cv::Rect RotatedBoxArray::bounds(int i) const
+{
+    float ex = fabs(c[i]) * hw[i] + fabs(s[i]) * hh[i];
+    float ey = fabs(s[i]) * hw[i] + fabs(c[i]) * hh[i];
+    int x0 = (int)floor(cx[i] - ex), x1 = (int)ceil(cx[i] + ex);
+    int y0 = (int)floor(cy[i] - ey), y1 = (int)ceil(cy[i] + ey);
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Corners of a box
+ */
+void RotatedBoxArray::corners(int i, cv::Point2f *pts) const
+{
+    static const float dx[4] = {-1, 1, 1, -1};
+    static const float dy[4] = {-1, -1, 1, 1};
+    for(int k = 0; k < 4; k++) {
+        float x = dx[k] * hw[i], y = dy[k] * hh[i];
+        pts[k].x = cx[i] + c[i] * x - s[i] * y;
+        pts[k].y = cy[i] + s[i] * x + c[i] * y;
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Area of the intersection of two boxes
+ *
+ * The corners of the first box are clipped by the edges of the second one
+ * (Sutherland-Hodgman), the area of the clipped polygon is given by
+ * the shoelace formula. Both boxes have the corners in the same order, so
+ * the interior is always on the same side of an edge.
+ */
+float RotatedOverlap::intersection(const RotatedBoxArray &a, int i, const RotatedBoxArray &b, int j)
+{
+    if(a.area[i] <= 0 || b.area[j] <= 0) {
+        return 0;
+    }
+
+    // Both boxes axis-aligned (rotated by a multiple of 90 degrees)
+    if((fabs(a.s[i]) < AXIS_EPS || fabs(a.c[i]) < AXIS_EPS) &&
+       (fabs(b.s[j]) < AXIS_EPS || fabs(b.c[j]) < AXIS_EPS)) {
+        float aw = (fabs(a.s[i]) < AXIS_EPS) ? a.hw[i] : a.hh[i];
+        float ah = (fabs(a.s[i]) < AXIS_EPS) ? a.hh[i] : a.hw[i];
+        float bw = (fabs(b.s[j]) < AXIS_EPS) ? b.hw[j] : b.hh[j];
+        float bh = (fabs(b.s[j]) < AXIS_EPS) ? b.hh[j] : b.hw[j];
+        float w = min(a.cx[i] + aw, b.cx[j] + bw) - max(a.cx[i] - aw, b.cx[j] - bw);
+        float h = min(a.cy[i] + ah, b.cy[j] + bh) - max(a.cy[i] - ah, b.cy[j] - bh);
+        return (w > 0 && h > 0) ? w * h : 0;
+    }
+
+    cv::Point2f clip[4];
+    b.corners(j, clip);
+
+    cv::Point2f bufA[MAX_VERTICES], bufB[MAX_VERTICES];
+    cv::Point2f *poly = bufA, *next = bufB;
+    a.corners(i, poly);
+    int n = 4;
+
+    for(int e = 0; e < 4 && n > 0; e++) {
+        const cv::Point2f &p0 = clip[e], &p1 = clip[(e + 1) & 3];
+        float ex = p1.x - p0.x, ey = p1.y - p0.y;
+
+        int m = 0;
+        for(int k = 0; k < n; k++) {
+            const cv::Point2f &u = poly[k], &v = poly[(k + 1 == n) ? 0 : k + 1];
+            float du = ex * (u.y - p0.y) - ey * (u.x - p0.x);
+            float dv = ex * (v.y - p0.y) - ey * (v.x - p0.x);
+
+            if(du >= 0) {
+                next[m++] = u;
+            }
+            if((du >= 0) != (dv >= 0)) {
+                float t = du / (du - dv);
+                next[m++] = cv::Point2f(u.x + t * (v.x - u.x), u.y + t * (v.y - u.y));
+            }
+        }
+
+        swap(poly, next);
+        n = min(m, MAX_VERTICES);
+    }
+
+    // Shoelace formula (relative to the first vertex, the products
+    // of the image coordinates would cancel out in float)
+    float sum = 0;
+    for(int k = 2; k < n; k++) {
+        float ux = poly[k - 1].x - poly[0].x, uy = poly[k - 1].y - poly[0].y;
+        float vx = poly[k].x - poly[0].x, vy = poly[k].y - poly[0].y;
+        sum += ux * vy - vx * uy;
+    }
+    return fabs(sum) * 0.5f;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Overlapping percentage of a pair of boxes
+ */
+float RotatedOverlap::score(const RotatedBoxArray &a, int i, const RotatedBoxArray &b, int j, float minOverlap)
+{
+    float common = intersection(a, i, b, j);
+    if(common <= 0 || common * 100 < minOverlap * a.area[i] || common * 100 < minOverlap * b.area[j]) {
+        return 0;
+    }
+
+    // The smaller percentage belongs to the larger box
+    return common * 100 / max(a.area[i], b.area[j]);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Overlapping percentage of a single pair of objects
+ */
+float RotatedOverlap::pair(const Object &det, const Object &pred, float minOverlap)
+{
+    RotatedBoxArray a, b;
+    a.push_back(det.m_bb, det.m_angle);
+    b.push_back(pred.m_bb, pred.m_angle);
+
+    float out;
+    row(a, 0, b, NULL, 1, minOverlap, &out);
+    return out;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Overlapping percentages of one box and the boxes of an array
+ *
+ * The intersection is at most the area of the smaller box, so minOverlap%
+ * of the larger box can not be reached if the smaller one is too small.
+ */
+void RotatedOverlap::row(const RotatedBoxArray &dets, int det, const RotatedBoxArray &preds,
+                         const int *idx, int n, float minOverlap, float *out)
+{
+    float dx = dets.cx[det], dy = dets.cy[det];
+    float dr = dets.radius[det], dArea = dets.area[det];
+
+    for(int k = 0; k < n; k++) {
+        int j = idx ? idx[k] : k;
+        out[k] = 0;
+
+        // Bounding circles
+        float ox = preds.cx[j] - dx, oy = preds.cy[j] - dy;
+        float r = dr + preds.radius[j];
+        if(ox * ox + oy * oy >= r * r) continue;
+
+        // Areas
+        float pArea = preds.area[j];
+        if(min(dArea, pArea) * 100 < minOverlap * max(dArea, pArea) || min(dArea, pArea) <= 0) continue;
+
+        out[k] = score(dets, det, preds, j, minOverlap);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Overlapping percentages of all pairs of boxes from two arrays
+ */
+void RotatedOverlap::matrix(const RotatedBoxArray &dets, const RotatedBoxArray &preds, float minOverlap, cv::Mat &out)
+{
+    out.create(dets.size(), preds.size(), CV_32F);
+
+    for(int i = 0; i < dets.size(); i++) {
+        row(dets, i, preds, NULL, preds.size(), minOverlap, out.ptr<float>(i));
+    }
+}
+
+}
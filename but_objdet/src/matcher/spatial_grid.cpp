@@ -0,0 +1,265 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "but_objdet/matcher/spatial_grid.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+// Maximal number of cells per indexed rectangle (bounds the memory
+// and the build time when the rectangles are sparse and small)
+const int MAX_CELLS_PER_RECT = 4;
+const int MIN_CELLS = 64;
+
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+SpatialGrid::SpatialGrid()
+{
+    count = 0;
+    originX = originY = 0;
+    cellW = cellH = 1;
+    cols = rows = 0;
+    stamp = 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Floor division of the coordinate relative to the grid origin
+ */
+int SpatialGrid::cellOf(int coord, int origin, int cellSize)
+{
+    int d = coord - origin;
+    return (d >= 0) ? (d / cellSize) : -((-d + cellSize - 1) / cellSize);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Builds the grid
+ */
+void SpatialGrid::build(const vector<cv::Rect> &rects)
+{
+    count = rects.size();
+    unbounded.clear();
+    cellItems.clear();
+    cols = rows = 0;
+
+    if(mark.size() < rects.size()) {
+        mark.resize(rects.size(), 0);
+    }
+
+    // Extent of the grid and the average size of rectangles
+    int minX = 0, minY = 0, maxX = 0, maxY = 0;
+    double sumW = 0, sumH = 0;
+    int nBounded = 0;
+    for(unsigned int i = 0; i < rects.size(); i++) {
+        const cv::Rect &r = rects[i];
+        if(r.width <= 0 || r.height <= 0) {
+            unbounded.push_back(i);
+            continue;
+        }
+        if(nBounded == 0) {
+            minX = r.x; maxX = r.x + r.width - 1;
+            minY = r.y; maxY = r.y + r.height - 1;
+        }
+        else {
+            minX = min(minX, r.x); maxX = max(maxX, r.x + r.width - 1);
+            minY = min(minY, r.y); maxY = max(maxY, r.y + r.height - 1);
+        }
+        sumW += r.width;
+        sumH += r.height;
+        nBounded++;
+    }
+
+    if(nBounded == 0) {
+        cellStart.assign(1, 0);
+        return;
+    }
+
+    // Cells of the average rectangle size, enlarged if there would be too many
+    originX = minX;
+    originY = minY;
+    cellW = max(1, (int)(sumW / nBounded));
+    cellH = max(1, (int)(sumH / nBounded));
+    double maxCells = max(MIN_CELLS, MAX_CELLS_PER_RECT * nBounded);
+    for(;;) {
+        cols = (maxX - minX) / cellW + 1;
+        rows = (maxY - minY) / cellH + 1;
+        double cells = (double)cols * rows;
+        if(cells <= maxCells) break;
+        double scale = sqrt(cells / maxCells);
+        cellW = (int)ceil(cellW * scale);
+        cellH = (int)ceil(cellH * scale);
+    }
+
+    // Counting sort of the rectangles into cells
+    cellStart.assign(cols * rows + 1, 0);
+    for(unsigned int i = 0; i < rects.size(); i++) {
+        const cv::Rect &r = rects[i];
+        if(r.width <= 0 || r.height <= 0) continue;
+
+        int cx0 = cellOf(r.x, originX, cellW), cx1 = cellOf(r.x + r.width - 1, originX, cellW);
+        int cy0 = cellOf(r.y, originY, cellH), cy1 = cellOf(r.y + r.height - 1, originY, cellH);
+        for(int cy = cy0; cy <= cy1; cy++) {
+            for(int cx = cx0; cx <= cx1; cx++) {
+                cellStart[cy * cols + cx + 1]++;
+            }
+        }
+    }
+    for(int c = 0; c < cols * rows; c++) {
+        cellStart[c + 1] += cellStart[c];
+    }
+
+    cellItems.resize(cellStart[cols * rows]);
+    vector<int> pos(cellStart.begin(), cellStart.end() - 1);
+    for(unsigned int i = 0; i < rects.size(); i++) {
+        const cv::Rect &r = rects[i];
+        if(r.width <= 0 || r.height <= 0) continue;
+
+        int cx0 = cellOf(r.x, originX, cellW), cx1 = cellOf(r.x + r.width - 1, originX, cellW);
+        int cy0 = cellOf(r.y, originY, cellH), cy1 = cellOf(r.y + r.height - 1, originY, cellH);
+        for(int cy = cy0; cy <= cy1; cy++) {
+            for(int cx = cx0; cx <= cx1; cx++) {
+                cellItems[pos[cy * cols + cx]++] = i;
+            }
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Finds candidates possibly intersecting the given rectangle
+ */
+void SpatialGrid::query(const cv::Rect &rect, vector<int> &candidates) const
+{
+    candidates.clear();
+
+    // A degenerate query can "overlap" anything (the narrow phase decides)
+    if(rect.width <= 0 || rect.height <= 0) {
+        for(int i = 0; i < count; i++) {
+            candidates.push_back(i);
+        }
+        return;
+    }
+
+    candidates.insert(candidates.end(), unbounded.begin(), unbounded.end());
+    if(cols == 0 || rows == 0) return;
+
+    // Range of cells covered by the query, clipped to the grid
+    int cx0 = max(0, cellOf(rect.x, originX, cellW));
+    int cx1 = min(cols - 1, cellOf(rect.x + rect.width - 1, originX, cellW));
+    int cy0 = max(0, cellOf(rect.y, originY, cellH));
+    int cy1 = min(rows - 1, cellOf(rect.y + rect.height - 1, originY, cellH));
+    if(cx0 > cx1 || cy0 > cy1) {
+        return;
+    }
+
+    // Collect rectangles from the cells (each one just once)
+    if(++stamp == 0) {
+        fill(mark.begin(), mark.end(), 0);
+        stamp = 1;
+    }
+    for(int cy = cy0; cy <= cy1; cy++) {
+        for(int cx = cx0; cx <= cx1; cx++) {
+            int c = cy * cols + cx;
+            for(int k = cellStart[c]; k < cellStart[c + 1]; k++) {
+                int i = cellItems[k];
+                if(mark[i] != stamp) {
+                    mark[i] = stamp;
+                    candidates.push_back(i);
+                }
+            }
+        }
+    }
+
+    sort(candidates.begin(), candidates.end());
+}
+
+
+
+/* -----------------------------------------------------------------------------
+ * Builds the grids over bounding boxes of the objects
+ */
+void ClassGrids::build(const Objects &objects)
+{
+    buildBuckets(objects, NULL);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Builds the grids over the given rectangles
+ */
+void ClassGrids::build(const Objects &objects, const vector<cv::Rect> &rects)
+{
+    buildBuckets(objects, &rects);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Buckets the objects by class and builds a grid over each bucket
+ */
+void ClassGrids::buildBuckets(const Objects &objects, const vector<cv::Rect> *rects)
+{
+    map<int, Bucket>::iterator it;
+    for(it = buckets.begin(); it != buckets.end(); it++) {
+        it->second.ids.clear();
+        it->second.rects.clear();
+    }
+    for(unsigned int j = 0; j < objects.size(); j++) {
+        Bucket &bucket = buckets[objects[j].m_class];
+        bucket.ids.push_back(j);
+        bucket.rects.push_back(rects ? (*rects)[j] : objects[j].m_bb);
+    }
+    for(it = buckets.begin(); it != buckets.end(); it++) {
+        it->second.grid.build(it->second.rects);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Finds candidates of the given class possibly intersecting the rectangle
+ */
+void ClassGrids::query(int objClass, const cv::Rect &rect, vector<int> &candidates) const
+{
+    candidates.clear();
+
+    map<int, Bucket>::const_iterator it = buckets.find(objClass);
+    if(it == buckets.end()) return;
+
+    // Positions within the bucket are ascending, and so are the object indices
+    it->second.grid.query(rect, local);
+    for(unsigned int c = 0; c < local.size(); c++) {
+        candidates.push_back(it->second.ids[local[c]]);
+    }
+}
+
+}
@@ -0,0 +1,472 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "but_objdet/cpu_features.h"
+#include "but_objdet/tracker/kalman_bank.h"
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+// Noise and the initial covariance (as in TrackerKalman)
+const float PROCESS_NOISE = 1e-4f;
+const float MEASUREMENT_NOISE = 1e-1f;
+const float INITIAL_COV = 0.1f;
+
+const int INITIAL_CAPACITY = 64;
+
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+/**
+ * 8 floats with arithmetic operators, so the filter steps below are written
+ * once for both the scalar and the vectorized version.
+ */
+struct Vec8
+{
+    __m256 v;
+    BUT_OBJDET_TARGET_AVX2 Vec8() {}
+    BUT_OBJDET_TARGET_AVX2 Vec8(__m256 a) : v(a) {}
+    BUT_OBJDET_TARGET_AVX2 Vec8(float a) : v(_mm256_set1_ps(a)) {}
+};
+BUT_OBJDET_TARGET_AVX2 static inline Vec8 operator+(Vec8 a, Vec8 b) { return _mm256_add_ps(a.v, b.v); }
+BUT_OBJDET_TARGET_AVX2 static inline Vec8 operator-(Vec8 a, Vec8 b) { return _mm256_sub_ps(a.v, b.v); }
+BUT_OBJDET_TARGET_AVX2 static inline Vec8 operator*(Vec8 a, Vec8 b) { return _mm256_mul_ps(a.v, b.v); }
+BUT_OBJDET_TARGET_AVX2 static inline Vec8 operator/(Vec8 a, Vec8 b) { return _mm256_div_ps(a.v, b.v); }
+#endif
+
+
+/**
+ * State (x, v, a) and the covariance block (p00, p01, p02, p11, p12, p22)
+ * of one parameter of a filter.
+ */
+template <class T>
+struct Block
+{
+    T x, v, a;
+    T p00, p01, p02, p11, p12, p22;
+};
+
+/* -----------------------------------------------------------------------------
+ * Predicted position (x + v*dt + a*dt^2/2)
+ */
+template <class T>
+static BUT_OBJDET_ALWAYS_INLINE T predictPosition(const T &x, const T &v, const T &a, const T &dt)
+{
+    return x + dt * (v + T(0.5f) * dt * a);
+}
+
+/* -----------------------------------------------------------------------------
+ * Variance of the predicted position and of the predicted measurement
+ * (element 0,0 of F * P * F^T + Q, plus R)
+ */
+template <class T>
+static BUT_OBJDET_ALWAYS_INLINE T predictVariance(const Block<T> &b, const T &dt)
+{
+    T h = T(0.5f) * dt * dt;
+    T fp00 = b.p00 + dt * b.p01 + h * b.p02;
+    T fp01 = b.p01 + dt * b.p11 + h * b.p12;
+    T fp02 = b.p02 + dt * b.p12 + h * b.p22;
+    return fp00 + dt * fp01 + h * fp02 + T(PROCESS_NOISE + MEASUREMENT_NOISE);
+}
+
+/* -----------------------------------------------------------------------------
+ * Prediction and correction of one parameter (see KalmanBlock<2>)
+ */
+template <class T>
+static BUT_OBJDET_ALWAYS_INLINE void updateBlock(Block<T> &b, const T &dt, const T &z)
+{
+    T h = T(0.5f) * dt * dt;
+    T q = T(PROCESS_NOISE);
+
+    // Predicted state
+    T x = predictPosition(b.x, b.v, b.a, dt);
+    T v = b.v + dt * b.a;
+    T a = b.a;
+
+    // F * P (F is upper triangular), then F * P * F^T + Q
+    T fp00 = b.p00 + dt * b.p01 + h * b.p02;
+    T fp01 = b.p01 + dt * b.p11 + h * b.p12;
+    T fp02 = b.p02 + dt * b.p12 + h * b.p22;
+    T fp11 = b.p11 + dt * b.p12;
+    T fp12 = b.p12 + dt * b.p22;
+    T fp22 = b.p22;
+
+    T p00 = fp00 + dt * fp01 + h * fp02 + q;
+    T p01 = fp01 + dt * fp02;
+    T p02 = fp02;
+    T p11 = fp11 + dt * fp12 + q;
+    T p12 = fp12;
+    T p22 = fp22 + q;
+
+    // Correction by a scalar measurement
+    T s = p00 + T(MEASUREMENT_NOISE);
+    T k0 = p00 / s, k1 = p01 / s, k2 = p02 / s;
+    T y = z - x;
+
+    b.x = x + k0 * y;
+    b.v = v + k1 * y;
+    b.a = a + k2 * y;
+
+    b.p00 = p00 - k0 * p00;
+    b.p01 = p01 - k0 * p01;
+    b.p02 = p02 - k0 * p02;
+    b.p11 = p11 - k1 * p01;
+    b.p12 = p12 - k1 * p02;
+    b.p22 = p22 - k2 * p02;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+KalmanBank::KalmanBank()
+{
+    cap = 0;
+    allocs = 0;
+    reserve(INITIAL_CAPACITY);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Enlarges the arrays (the only place where the bank allocates memory; the list
+ * of free slots is reserved for all the slots, so removing never allocates)
+ */
+void KalmanBank::reserve(int newCap)
+{
+    allocs++;
+    freeSlots.reserve(newCap);
+    
+    vector<float> newData(VALUES * newCap, 0);
+    for(int v = 0; v < VALUES; v++) {
+        copy(data.begin() + v * cap, data.begin() + (v + 1) * cap, newData.begin() + v * newCap);
+    }
+    data.swap(newData);
+
+    for(int slot = newCap - 1; slot >= cap; slot--) {
+        freeSlots.push_back(slot);
+    }
+    cap = newCap;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Adds a filter initialized by a measurement
+ */
+int KalmanBank::add(const float *measurement)
+{
+    if(freeSlots.empty()) {
+        reserve(2 * cap);
+    }
+
+    // Freed slots are reused first (new ones are taken from the lowest)
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    init(slot, measurement);
+    return slot;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Removes a filter
+ */
+void KalmanBank::remove(int slot)
+{
+    freeSlots.push_back(slot);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Initializes a filter by a measurement
+ */
+void KalmanBank::init(int slot, const float *measurement)
+{
+    for(int c = 0; c < STATE; c++) {
+        values(c)[slot] = (c < MEAS) ? measurement[c] : 0;
+    }
+    for(int p = 0; p < MEAS; p++) {
+        float *cov = &data[(STATE + p * COV) * cap + slot];
+        for(int e = 0; e < COV; e++) {
+            cov[e * cap] = (e == 0 || e == 3 || e == 5) ? INITIAL_COV : 0;
+        }
+    }
+}
+
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+/* -----------------------------------------------------------------------------
+ * Predicted bounding boxes and their variances, 8 filters at once (returns
+ * the number of processed filters)
+ */
+BUT_OBJDET_TARGET_AVX2
+int KalmanBank::predictAvx2(const int *slots, const float *dt, int n, float *boxes, float *variances) const
+{
+    int k = 0;
+    for(; k + 8 <= n; k += 8) {
+        __m256i idx = slots ? _mm256_loadu_si256((const __m256i *)(slots + k))
+                            : _mm256_add_epi32(_mm256_set1_epi32(k), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        Vec8 t = _mm256_loadu_ps(dt + k);
+
+        for(int p = 0; p < MEAS; p++) {
+            Vec8 x = _mm256_i32gather_ps(values(p), idx, 4);
+            Vec8 v = _mm256_i32gather_ps(values(MEAS + p), idx, 4);
+            Vec8 a = _mm256_i32gather_ps(values(2 * MEAS + p), idx, 4);
+            _mm256_storeu_ps(boxes + p * n + k, predictPosition(x, v, a, t).v);
+
+            if(variances) {
+                Block<Vec8> b;
+                const float *cov = values(STATE + p * COV);
+                b.p00 = _mm256_i32gather_ps(cov, idx, 4);
+                b.p01 = _mm256_i32gather_ps(cov + cap, idx, 4);
+                b.p02 = _mm256_i32gather_ps(cov + 2 * cap, idx, 4);
+                b.p11 = _mm256_i32gather_ps(cov + 3 * cap, idx, 4);
+                b.p12 = _mm256_i32gather_ps(cov + 4 * cap, idx, 4);
+                b.p22 = _mm256_i32gather_ps(cov + 5 * cap, idx, 4);
+                _mm256_storeu_ps(variances + p * n + k, predictVariance(b, t).v);
+            }
+        }
+    }
+
+    return k;
+}
+#endif
+
+
+/* -----------------------------------------------------------------------------
+ * Predicted bounding boxes and their variances
+ */
+void KalmanBank::predict(const int *slots, const float *dt, int n, float *boxes, float *variances) const
+{
+    int k = 0;
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+    if(cpuHasAvx2()) {
+        k = predictAvx2(slots, dt, n, boxes, variances);
+    }
+#endif
+
+    for(; k < n; k++) {
+        int slot = slots ? slots[k] : k;
+        for(int p = 0; p < MEAS; p++) {
+            boxes[p * n + k] = predictPosition(values(p)[slot], values(MEAS + p)[slot],
+                                               values(2 * MEAS + p)[slot], dt[k]);
+            if(variances) {
+                Block<float> b;
+                const float *cov = values(STATE + p * COV) + slot;
+                b.p00 = cov[0]; b.p01 = cov[cap]; b.p02 = cov[2 * cap];
+                b.p11 = cov[3 * cap]; b.p12 = cov[4 * cap]; b.p22 = cov[5 * cap];
+                variances[p * n + k] = predictVariance(b, dt[k]);
+            }
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Predicted bounding boxes and their variances at several times
+ *
+ * With h = dt^2 / 2, the predicted position is x + v * dt + a * h and its
+ * variance (see predictVariance) expands to the polynomial
+ * p00 + 2 p01 dt + (p11 + p02) dt^2 + p12 dt^3 + p22 / 4 dt^4 + Q + R,
+ * so the coefficients are computed once per filter and each time costs
+ * two Horner evaluations per parameter.
+ */
+void KalmanBank::predictTrajectories(const int *slots, const float *dt, int n, int m,
+                                     float *boxes, float *variances) const
+{
+    for(int k = 0; k < n; k++) {
+        int slot = slots ? slots[k] : k;
+        const float *t = dt + k * m;
+        
+        for(int p = 0; p < MEAS; p++) {
+            float x = values(p)[slot];
+            float v = values(MEAS + p)[slot];
+            float a2 = 0.5f * values(2 * MEAS + p)[slot];
+            for(int j = 0; j < m; j++) {
+                boxes[(k * m + j) * MEAS + p] = x + t[j] * (v + t[j] * a2);
+            }
+            
+            if(variances) {
+                const float *cov = values(STATE + p * COV) + slot;
+                float c0 = cov[0] + (PROCESS_NOISE + MEASUREMENT_NOISE);
+                float c1 = 2 * cov[cap];
+                float c2 = cov[3 * cap] + cov[2 * cap];
+                float c3 = cov[4 * cap];
+                float c4 = 0.25f * cov[5 * cap];
+                for(int j = 0; j < m; j++) {
+                    variances[(k * m + j) * MEAS + p] = c0 + t[j] * (c1 + t[j] * (c2 + t[j] * (c3 + t[j] * c4)));
+                }
+            }
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Predicted state of a single filter
+ */
+void KalmanBank::predictState(int slot, float dt, float *state) const
+{
+    for(int p = 0; p < MEAS; p++) {
+        float x = values(p)[slot], v = values(MEAS + p)[slot], a = values(2 * MEAS + p)[slot];
+        state[p] = predictPosition(x, v, a, dt);
+        state[MEAS + p] = v + dt * a;
+        state[2 * MEAS + p] = a;
+    }
+}
+
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+/* -----------------------------------------------------------------------------
+ * Updates filters by measurements, 8 filters at once (returns the number
+ * of processed filters)
+ */
+BUT_OBJDET_TARGET_AVX2
+int KalmanBank::updateAvx2(const int *slots, const float *dt, int n, const float *measurements)
+{
+    int k = 0;
+    // Gathered, computed and written back slot by slot (there is no scatter)
+    float out[9][8];
+    for(; k + 8 <= n; k += 8) {
+        __m256i idx = slots ? _mm256_loadu_si256((const __m256i *)(slots + k))
+                            : _mm256_add_epi32(_mm256_set1_epi32(k), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        Vec8 t = _mm256_loadu_ps(dt + k);
+
+        for(int p = 0; p < MEAS; p++) {
+            Block<Vec8> b;
+            const float *cov = values(STATE + p * COV);
+            b.x = _mm256_i32gather_ps(values(p), idx, 4);
+            b.v = _mm256_i32gather_ps(values(MEAS + p), idx, 4);
+            b.a = _mm256_i32gather_ps(values(2 * MEAS + p), idx, 4);
+            b.p00 = _mm256_i32gather_ps(cov, idx, 4);
+            b.p01 = _mm256_i32gather_ps(cov + cap, idx, 4);
+            b.p02 = _mm256_i32gather_ps(cov + 2 * cap, idx, 4);
+            b.p11 = _mm256_i32gather_ps(cov + 3 * cap, idx, 4);
+            b.p12 = _mm256_i32gather_ps(cov + 4 * cap, idx, 4);
+            b.p22 = _mm256_i32gather_ps(cov + 5 * cap, idx, 4);
+
+            updateBlock(b, t, Vec8(_mm256_loadu_ps(measurements + p * n + k)));
+
+            _mm256_storeu_ps(out[0], b.x.v); _mm256_storeu_ps(out[1], b.v.v); _mm256_storeu_ps(out[2], b.a.v);
+            _mm256_storeu_ps(out[3], b.p00.v); _mm256_storeu_ps(out[4], b.p01.v); _mm256_storeu_ps(out[5], b.p02.v);
+            _mm256_storeu_ps(out[6], b.p11.v); _mm256_storeu_ps(out[7], b.p12.v); _mm256_storeu_ps(out[8], b.p22.v);
+
+            for(int l = 0; l < 8; l++) {
+                int slot = slots ? slots[k + l] : k + l;
+                values(p)[slot] = out[0][l];
+                values(MEAS + p)[slot] = out[1][l];
+                values(2 * MEAS + p)[slot] = out[2][l];
+                for(int e = 0; e < COV; e++) {
+                    values(STATE + p * COV + e)[slot] = out[3 + e][l];
+                }
+            }
+        }
+    }
+
+    return k;
+}
+#endif
+
+
+/* -----------------------------------------------------------------------------
+ * Updates filters by measurements
+ */
+void KalmanBank::update(const int *slots, const float *dt, int n, const float *measurements)
+{
+    int k = 0;
+
+#if defined(BUT_OBJDET_CPU_DISPATCH)
+    if(cpuHasAvx2()) {
+        k = updateAvx2(slots, dt, n, measurements);
+    }
+#endif
+
+    for(; k < n; k++) {
+        int slot = slots ? slots[k] : k;
+        for(int p = 0; p < MEAS; p++) {
+            float *cov = values(STATE + p * COV) + slot;
+            Block<float> b;
+            b.x = values(p)[slot]; b.v = values(MEAS + p)[slot]; b.a = values(2 * MEAS + p)[slot];
+            b.p00 = cov[0]; b.p01 = cov[cap]; b.p02 = cov[2 * cap];
+            b.p11 = cov[3 * cap]; b.p12 = cov[4 * cap]; b.p22 = cov[5 * cap];
+
+            updateBlock(b, dt[k], measurements[p * n + k]);
+
+            values(p)[slot] = b.x; values(MEAS + p)[slot] = b.v; values(2 * MEAS + p)[slot] = b.a;
+            cov[0] = b.p00; cov[cap] = b.p01; cov[2 * cap] = b.p02;
+            cov[3 * cap] = b.p11; cov[4 * cap] = b.p12; cov[5 * cap] = b.p22;
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Copies a filter
+ */
+void KalmanBank::save(int slot, float *filter) const
+{
+    for(int v = 0; v < VALUES; v++) {
+        filter[v] = values(v)[slot];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets a filter to a copy
+ */
+void KalmanBank::restore(int slot, const float *filter)
+{
+    for(int v = 0; v < VALUES; v++) {
+        values(v)[slot] = filter[v];
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Copies filters of another bank
+ */
+void KalmanBank::copyFilters(const KalmanBank &other, const int *slots, int n)
+{
+    if(cap < other.cap) {
+        reserve(other.cap);
+    }
+    for(int v = 0; v < VALUES; v++) {
+        const float *src = other.values(v);
+        float *dst = values(v);
+        for(int k = 0; k < n; k++) {
+            dst[slots[k]] = src[slots[k]];
+        }
+    }
+}
+
+}
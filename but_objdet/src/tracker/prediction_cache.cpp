@@ -0,0 +1,140 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "but_objdet/tracker/prediction_cache.h"
+#include "but_objdet/tracker/track_shard.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+PredictionCache::PredictionCache()
+{
+    hitCount = 0;
+    missCount = 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Sets the number of filter slots
+ */
+void PredictionCache::resize(int slots)
+{
+    entries.resize(slots);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Takes the cached predictions (a prediction is valid if it was computed
+ * for the same time from the same version of the detection)
+ */
+void PredictionCache::lookup(const vector<const TrackView *> &tracks, int64 reqTime,
+                             float *boxes, float *variances, vector<int> &missing)
+{
+    int found = 0;
+    for(unsigned int k = 0; k < tracks.size(); k++) {
+        const Entry &entry = entries[tracks[k]->slot];
+        
+        // The entry is read between two reads of its sequence number
+        unsigned int seq = entry.seq;
+        __sync_synchronize();
+        bool valid = seq != 0 && (seq & 1) == 0 &&
+                     entry.reqTime == reqTime && entry.version == tracks[k]->version;
+        if(valid) {
+            for(int p = 0; p < MEAS; p++) {
+                boxes[k * MEAS + p] = entry.box[p];
+                variances[k * MEAS + p] = entry.variance[p];
+            }
+        }
+        __sync_synchronize();
+        
+        if(valid && entry.seq == seq) {
+            found++;
+        }
+        else {
+            missing.push_back(k);
+        }
+    }
+    
+    __sync_fetch_and_add(&hitCount, (int64)found);
+    __sync_fetch_and_add(&missCount, (int64)(tracks.size() - found));
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Stores the computed predictions
+ *
+ * Only the last prediction of each filter slot is kept. An entry being
+ * written by another thread is skipped.
+ */
+void PredictionCache::store(const vector<const TrackView *> &tracks, const vector<int> &missing,
+                            int64 reqTime, const float *boxes, const float *variances)
+{
+    for(unsigned int i = 0; i < missing.size(); i++) {
+        int k = missing[i];
+        Entry &entry = entries[tracks[k]->slot];
+        
+        unsigned int seq = entry.seq;
+        if((seq & 1) != 0 || !__sync_bool_compare_and_swap(&entry.seq, seq, seq + 1)) {
+            continue;
+        }
+        
+        entry.reqTime = reqTime;
+        entry.version = tracks[k]->version;
+        for(int p = 0; p < MEAS; p++) {
+            entry.box[p] = boxes[k * MEAS + p];
+            entry.variance[p] = variances[k * MEAS + p];
+        }
+        
+        __sync_synchronize(); // The entry is written before it is released
+        entry.seq = seq + 2;
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Number of the predictions found in the cache
+ */
+int64 PredictionCache::hits()
+{
+    return __sync_fetch_and_add(&hitCount, (int64)0);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Number of the predictions not found in the cache
+ */
+int64 PredictionCache::misses()
+{
+    return __sync_fetch_and_add(&missCount, (int64)0);
+}
+
+}
@@ -0,0 +1,261 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "but_objdet/tracker/timing_wheel.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+TimingWheel::TimingWheel(int64 resolution)
+{
+    this->resolution = (resolution > 0) ? resolution : 1;
+    current = 0;
+    started = false;
+    count = 0;
+    for(int b = 0; b < LEVELS * BUCKETS; b++) {
+        heads[b] = -1;
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Tick in which a timer fires (rounding up, so it never fires early)
+ */
+int64 TimingWheel::tickOf(int64 deadline) const
+{
+    int64 tick = deadline / resolution;
+    if(deadline % resolution > 0) {
+        tick++;
+    }
+    return tick;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Puts a timer to a bucket
+ *
+ * A timer due in less than BUCKETS ticks goes to level 0, to the bucket of its
+ * tick. Otherwise it goes to the lowest level L whose range (BUCKETS^(L+1)
+ * ticks) covers it, to the bucket which is cascaded at the start of the range
+ * of BUCKETS^L ticks containing its tick. Timers beyond the range of the wheel
+ * are put to the last bucket in range and they are placed again when it is
+ * cascaded. Before the first advance, the current tick is unknown, so all
+ * the timers are kept in one bucket (and placed by reset).
+ */
+void TimingWheel::link(int slot, int64 minDelta)
+{
+    Timer &timer = timers[slot];
+    int bucket = 0;
+    
+    if(started) {
+        int64 delta = tickOf(timer.deadline) - current;
+        if(delta < minDelta) {
+            delta = minDelta;
+        }
+        const int64 maxDelta = ((int64)1 << (BITS * LEVELS)) - 1;
+        if(delta > maxDelta) {
+            delta = maxDelta;
+        }
+        int64 tick = current + delta;
+        
+        int level = 0;
+        while(level < LEVELS - 1 && delta >= ((int64)1 << (BITS * (level + 1)))) {
+            level++;
+        }
+        bucket = level * BUCKETS + (int)((tick >> (BITS * level)) & (BUCKETS - 1));
+    }
+    
+    timer.bucket = bucket;
+    timer.prev = -1;
+    timer.next = heads[bucket];
+    if(heads[bucket] != -1) {
+        timers[heads[bucket]].prev = slot;
+    }
+    heads[bucket] = slot;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Removes a timer from its bucket
+ */
+void TimingWheel::unlink(int slot)
+{
+    Timer &timer = timers[slot];
+    if(timer.prev != -1) {
+        timers[timer.prev].next = timer.next;
+    }
+    else {
+        heads[timer.bucket] = timer.next;
+    }
+    if(timer.next != -1) {
+        timers[timer.next].prev = timer.prev;
+    }
+    timer.bucket = -1;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Schedules the timer of a track
+ */
+void TimingWheel::schedule(const TrackHandle &track, int64 deadline)
+{
+    if(track.slot < 0) {
+        return;
+    }
+    if(track.slot >= (int)timers.size()) {
+        Timer none;
+        none.deadline = 0;
+        none.generation = 0;
+        none.bucket = -1;
+        none.prev = none.next = -1;
+        timers.resize(track.slot + 1, none);
+    }
+    
+    Timer &timer = timers[track.slot];
+    if(timer.bucket != -1) {
+        unlink(track.slot);
+        count--;
+    }
+    timer.deadline = deadline;
+    timer.generation = track.generation;
+    link(track.slot, 1);
+    count++;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Cancels the timer of a track (a timer of a newer track in the same slot
+ * is not canceled)
+ */
+void TimingWheel::cancel(const TrackHandle &track)
+{
+    if(track.slot < 0 || track.slot >= (int)timers.size()) {
+        return;
+    }
+    Timer &timer = timers[track.slot];
+    if(timer.bucket != -1 && timer.generation == track.generation) {
+        unlink(track.slot);
+        count--;
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Moves the timers of a bucket to lower levels (relative to the current tick,
+ * the ones due in the current tick go to its bucket of level 0)
+ */
+void TimingWheel::cascade(int bucket)
+{
+    pending.clear();
+    for(int slot = heads[bucket]; slot != -1; slot = timers[slot].next) {
+        pending.push_back(slot);
+    }
+    heads[bucket] = -1;
+    
+    for(unsigned int i = 0; i < pending.size(); i++) {
+        link(pending[i], 0);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Reschedules all the timers relative to the given tick
+ */
+void TimingWheel::reset(int64 tick, int64 now, vector<TrackHandle> &expired)
+{
+    pending.clear();
+    for(int b = 0; b < LEVELS * BUCKETS; b++) {
+        for(int slot = heads[b]; slot != -1; slot = timers[slot].next) {
+            pending.push_back(slot);
+        }
+        heads[b] = -1;
+    }
+    
+    current = tick;
+    started = true;
+    
+    for(unsigned int i = 0; i < pending.size(); i++) {
+        Timer &timer = timers[pending[i]];
+        if(timer.deadline <= now) {
+            timer.bucket = -1;
+            count--;
+            expired.push_back(TrackHandle(pending[i], timer.generation));
+        }
+        else {
+            link(pending[i], 1);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Advances the wheel tick by tick
+ *
+ * At the start of a range of BUCKETS^L ticks, the bucket of level L covering
+ * the range is cascaded (from the lower levels to the higher ones, so
+ * the timers of a higher level, which are due sooner than the next range
+ * of a lower level, go directly to the right bucket). Then the bucket of level
+ * 0 of the tick is fired.
+ */
+void TimingWheel::advance(int64 now, vector<TrackHandle> &expired)
+{
+    int64 nowTick = now / resolution;
+    if(now % resolution < 0) {
+        nowTick--;
+    }
+    
+    // Time jumped back or too far to go tick by tick
+    if(!started || nowTick < current || nowTick - current > BUCKETS * BUCKETS) {
+        reset(nowTick, now, expired);
+        return;
+    }
+    
+    while(current < nowTick) {
+        current++;
+        
+        for(int level = 1; level < LEVELS; level++) {
+            if((current & (((int64)1 << (BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level * BUCKETS + (int)((current >> (BITS * level)) & (BUCKETS - 1)));
+        }
+        
+        int bucket = (int)(current & (BUCKETS - 1));
+        while(heads[bucket] != -1) {
+            int slot = heads[bucket];
+            unlink(slot);
+            count--;
+            expired.push_back(TrackHandle(slot, timers[slot].generation));
+        }
+    }
+}
+
+}
@@ -0,0 +1,385 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "but_objdet/tracker/track_grid.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+TrackGrid::TrackGrid(int cellSize)
+{
+    this->cellSize = (cellSize > 0) ? cellSize : 1;
+    count = 0;
+    largeCount = 0;
+    for(int b = 0; b <= BUCKETS; b++) {
+        heads[b] = -1;
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Index of a cell covering the given coordinate
+ */
+int TrackGrid::cellOf(float coord) const
+{
+    return (int)floor(coord / cellSize);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Bucket of a cell (hash of its coordinates)
+ */
+int TrackGrid::bucketOf(int cx, int cy)
+{
+    return (int)(((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u) & (BUCKETS - 1));
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Puts an object to the list of the cell of the centre of its box (a box
+ * larger than a cell goes to the list of the large boxes)
+ */
+void TrackGrid::link(int slot)
+{
+    Node &node = nodes[slot];
+    node.x = node.box.x + node.box.width / 2.0f;
+    node.y = node.box.y + node.box.height / 2.0f;
+    node.cx = cellOf(node.x);
+    node.cy = cellOf(node.y);
+    
+    if(node.box.width > cellSize || node.box.height > cellSize) {
+        node.bucket = LARGE;
+        largeCount++;
+    }
+    else {
+        node.bucket = bucketOf(node.cx, node.cy);
+    }
+    
+    node.prev = -1;
+    node.next = heads[node.bucket];
+    if(heads[node.bucket] != -1) {
+        nodes[heads[node.bucket]].prev = slot;
+    }
+    heads[node.bucket] = slot;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Removes an object from its list
+ */
+void TrackGrid::unlink(int slot)
+{
+    Node &node = nodes[slot];
+    if(node.prev != -1) {
+        nodes[node.prev].next = node.next;
+    }
+    else {
+        heads[node.bucket] = node.next;
+    }
+    if(node.next != -1) {
+        nodes[node.next].prev = node.prev;
+    }
+    if(node.bucket == LARGE) {
+        largeCount--;
+    }
+    node.bucket = -1;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Adds an object
+ */
+void TrackGrid::insert(int slot, int objClass, int id, const cv::Rect &box)
+{
+    if(slot < 0) {
+        return;
+    }
+    if(slot >= (int)nodes.size()) {
+        Node none;
+        none.cx = none.cy = 0;
+        none.x = none.y = 0;
+        none.objClass = -1;
+        none.id = -1;
+        none.bucket = -1;
+        none.prev = none.next = -1;
+        nodes.resize(slot + 1, none);
+    }
+    
+    Node &node = nodes[slot];
+    if(node.bucket != -1) {
+        unlink(slot);
+        count--;
+    }
+    node.box = box;
+    node.objClass = objClass;
+    node.id = id;
+    link(slot);
+    count++;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Moves an object (it is moved to another list only if it changes its cell)
+ */
+void TrackGrid::move(int slot, const cv::Rect &box)
+{
+    if(slot < 0 || slot >= (int)nodes.size() || nodes[slot].bucket == -1) {
+        return;
+    }
+    
+    Node &node = nodes[slot];
+    float x = box.x + box.width / 2.0f;
+    float y = box.y + box.height / 2.0f;
+    bool large = (box.width > cellSize || box.height > cellSize);
+    if(!large && node.bucket != LARGE && cellOf(x) == node.cx && cellOf(y) == node.cy) {
+        node.box = box;
+        node.x = x;
+        node.y = y;
+        return;
+    }
+    
+    unlink(slot);
+    node.box = box;
+    link(slot);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Removes an object
+ */
+void TrackGrid::remove(int slot)
+{
+    if(slot < 0 || slot >= (int)nodes.size() || nodes[slot].bucket == -1) {
+        return;
+    }
+    unlink(slot);
+    count--;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * If an object is of the class and has one of the IDs of a query
+ */
+bool TrackGrid::accepts(const Node &node, int objClass, const vector<int> *ids)
+{
+    return (objClass == -1 || node.objClass == objClass) &&
+           (ids == NULL || binary_search(ids->begin(), ids->end(), node.id));
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Tests an object by a query (the box must intersect the region of ROI,
+ * the centre must be within the radius of RADIUS)
+ */
+void TrackGrid::test(const Node &node, int slot, const GridQuery &query, int objClass,
+                     const vector<int> *ids,
+                     vector<int> &slots, vector<float> &distances) const
+{
+    if(!accepts(node, objClass, ids)) {
+        return;
+    }
+    
+    if(query.type == GridQuery::ROI) {
+        const cv::Rect &roi = query.roi;
+        if(node.box.x < roi.x + roi.width && roi.x < node.box.x + node.box.width &&
+           node.box.y < roi.y + roi.height && roi.y < node.box.y + node.box.height) {
+            slots.push_back(slot);
+            distances.push_back(0);
+        }
+    }
+    else {
+        float dx = node.x - query.x;
+        float dy = node.y - query.y;
+        float dist = sqrt(dx * dx + dy * dy);
+        if(dist <= query.radius) {
+            slots.push_back(slot);
+            distances.push_back(dist);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Appends the objects of a cell with their distances (the bucket of the cell
+ * can contain objects of other cells too)
+ */
+int TrackGrid::collect(int cx, int cy, const GridQuery &query, int objClass,
+                       const vector<int> *ids,
+                       vector<pair<float, int> > &nearest) const
+{
+    int inCell = 0;
+    for(int s = heads[bucketOf(cx, cy)]; s != -1; s = nodes[s].next) {
+        const Node &node = nodes[s];
+        if(node.cx != cx || node.cy != cy) {
+            continue;
+        }
+        inCell++;
+        if(accepts(node, objClass, ids)) {
+            float dx = node.x - query.x;
+            float dy = node.y - query.y;
+            nearest.push_back(make_pair((float)sqrt(dx * dx + dy * dy), s));
+        }
+    }
+    return inCell;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Finds the objects satisfying a query
+ *
+ * ROI and RADIUS visit the cells which can contain centres of the matching
+ * boxes (the region grown by a cell for ROI, the boxes in the cells are not
+ * larger than a cell) and the large boxes. NEAREST visits rings of cells
+ * around the point until it has k objects and the k-th of them is not farther
+ * than any object in the cells not visited yet.
+ */
+void TrackGrid::query(const GridQuery &query, int objClass,
+                      vector<int> &slots, vector<float> &distances,
+                      const vector<int> *ids) const
+{
+    slots.clear();
+    distances.clear();
+    
+    // All the objects
+    if(query.type == GridQuery::NONE) {
+        for(unsigned int s = 0; s < nodes.size(); s++) {
+            if(nodes[s].bucket != -1 && accepts(nodes[s], objClass, ids)) {
+                slots.push_back(s);
+                distances.push_back(0);
+            }
+        }
+    }
+    
+    // Objects in a region
+    else if(query.type == GridQuery::ROI || query.type == GridQuery::RADIUS) {
+        for(int s = heads[LARGE]; s != -1; s = nodes[s].next) {
+            test(nodes[s], s, query, objClass, ids, slots, distances);
+        }
+        
+        float left, top, right, bottom;
+        if(query.type == GridQuery::ROI) {
+            left = query.roi.x - cellSize;
+            top = query.roi.y - cellSize;
+            right = query.roi.x + query.roi.width + cellSize;
+            bottom = query.roi.y + query.roi.height + cellSize;
+        }
+        else {
+            left = query.x - query.radius;
+            top = query.y - query.radius;
+            right = query.x + query.radius;
+            bottom = query.y + query.radius;
+        }
+        int x0 = cellOf(left), x1 = cellOf(right);
+        int y0 = cellOf(top), y1 = cellOf(bottom);
+        
+        // Less objects than cells => test all of them
+        if((double)(x1 - x0 + 1) * (y1 - y0 + 1) > nodes.size()) {
+            for(unsigned int s = 0; s < nodes.size(); s++) {
+                if(nodes[s].bucket != -1 && nodes[s].bucket != LARGE) {
+                    test(nodes[s], s, query, objClass, ids, slots, distances);
+                }
+            }
+            return;
+        }
+        
+        for(int cy = y0; cy <= y1; cy++) {
+            for(int cx = x0; cx <= x1; cx++) {
+                for(int s = heads[bucketOf(cx, cy)]; s != -1; s = nodes[s].next) {
+                    if(nodes[s].cx == cx && nodes[s].cy == cy) {
+                        test(nodes[s], s, query, objClass, ids, slots, distances);
+                    }
+                }
+            }
+        }
+    }
+    
+    // The nearest objects
+    else if(query.type == GridQuery::NEAREST && query.k > 0) {
+        vector<pair<float, int> > nearest;
+        for(int s = heads[LARGE]; s != -1; s = nodes[s].next) {
+            const Node &node = nodes[s];
+            if(accepts(node, objClass, ids)) {
+                float dx = node.x - query.x;
+                float dy = node.y - query.y;
+                nearest.push_back(make_pair((float)sqrt(dx * dx + dy * dy), s));
+            }
+        }
+        
+        int cx0 = cellOf(query.x), cy0 = cellOf(query.y);
+        int visited = 0; // Objects in the visited cells
+        for(int r = 0; visited < count - largeCount; r++) {
+            
+            // Too many cells => take all the objects
+            if((double)(2 * r + 1) * (2 * r + 1) > nodes.size()) {
+                nearest.clear();
+                for(unsigned int s = 0; s < nodes.size(); s++) {
+                    const Node &node = nodes[s];
+                    if(node.bucket != -1 && accepts(node, objClass, ids)) {
+                        float dx = node.x - query.x;
+                        float dy = node.y - query.y;
+                        nearest.push_back(make_pair((float)sqrt(dx * dx + dy * dy), (int)s));
+                    }
+                }
+                break;
+            }
+            
+            // The ring of cells at the distance r from the cell of the point
+            for(int cy = cy0 - r; cy <= cy0 + r; cy++) {
+                int step = (cy == cy0 - r || cy == cy0 + r) ? 1 : 2 * r;
+                for(int cx = cx0 - r; cx <= cx0 + r; cx += step) {
+                    visited += collect(cx, cy, query, objClass, ids, nearest);
+                }
+            }
+            
+            // The objects in the next rings are farther than r cells
+            if((int)nearest.size() >= query.k) {
+                nth_element(nearest.begin(), nearest.begin() + (query.k - 1), nearest.end());
+                if(nearest[query.k - 1].first <= (float)r * cellSize) {
+                    break;
+                }
+            }
+        }
+        
+        int k = min((int)nearest.size(), query.k);
+        partial_sort(nearest.begin(), nearest.begin() + k, nearest.end());
+        for(int i = 0; i < k; i++) {
+            slots.push_back(nearest[i].second);
+            distances.push_back(nearest[i].first);
+        }
+    }
+}
+
+}
+
@@ -0,0 +1,318 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ros/ros.h>
+
+#include "but_objdet/tracker/track_shard.h"
+
+using namespace std;
+
+
+namespace but_objdet
+{
+
+/* -----------------------------------------------------------------------------
+ * Constructor
+ */
+TrackShard::TrackShard(int ttl, int ttlTime)
+    : countWheel(1), timeWheel(10000000) // Ticks of 1 message and 10 ms
+{
+    this->ttl = ttl;
+    this->ttlTime = ttlTime;
+    snapshotDirty = true;
+    updateCount = 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Processes the detections of a message
+ *
+ * The messages can come out of order (e.g. from several detectors with
+ * different latencies). A detection newer than the last one of its object
+ * updates the filter in the batch of this message, an older one is assimilated
+ * by replaying the measurements of the object from the preceding one
+ * (see ReplayBuffer).
+ */
+void TrackShard::process(const vector<const but_objdet_msgs::Detection *> &detections,
+                         int64 time, int64 msgCount, int64 latestTime, bool publish)
+{
+    for(unsigned int i = 0; i < detections.size(); i++) {
+        const but_objdet_msgs::Detection &det = *detections[i];
+
+        float measurement[KalmanBank::MEAS];
+        measurement[0] = det.m_bb.x;
+        measurement[1] = det.m_bb.y;
+        measurement[2] = det.m_bb.width;
+        measurement[3] = det.m_bb.height;
+        
+        // Check if the current detection is already in the memory
+        // (it is added if not, a single lookup in both cases)
+        bool isNew;
+        TrackHandle handle = detectionMem.insert(det.m_class, det.m_id, &isNew);
+        DetM &detM = *detectionMem.get(handle);
+        
+        // When it wasn't found => add it to memory
+        if(isNew) {
+            detM.det = det;
+            detM.nsTime = time;
+            detM.version = ++updateCount;
+            detM.queued = false;
+            
+		    // Initialization with the first measurement
+            detM.slot = bank.add(measurement);
+            grid.insert(detM.slot, det.m_class, det.m_id, cv::Rect(det.m_bb.x, det.m_bb.y, det.m_bb.width, det.m_bb.height));
+            detM.history.clear();
+            detM.history.insert(time, measurement);
+            bank.save(detM.slot, detM.history.snapshot(0));
+        }
+        
+        // When it was found and it is the newest detection => update
+        // (in the batch)
+        else if(time >= detM.nsTime) {
+            
+            // The object is twice in the message
+            if(detM.queued) {
+                updateQueued();
+            }
+            
+            detM.det = det;
+            grid.move(detM.slot, cv::Rect(det.m_bb.x, det.m_bb.y, det.m_bb.width, det.m_bb.height));
+            queuedTracks.push_back(handle);
+            queuedDts.push_back((time - detM.nsTime) / 1e9f);
+            queuedMeasurements.insert(queuedMeasurements.end(), measurement, measurement + KalmanBank::MEAS);
+            detM.queued = true;
+            
+            detM.history.insert(time, measurement);
+            detM.nsTime = time;
+            detM.version = ++updateCount;
+        }
+        
+        // An older detection => assimilate it by replaying
+        else {
+            if(detM.queued) {
+                updateQueued();
+            }
+            
+            int pos = detM.history.insert(time, measurement);
+            if(pos < 0) {
+                ROS_DEBUG("Detection of object %d (class %d) is too late, it is ignored", det.m_id, det.m_class);
+            }
+            else {
+                replay(detM, pos);
+                detM.version = ++updateCount;
+            }
+        }
+        
+        // (Re)schedule the expiration of the track
+        countWheel.schedule(handle, msgCount + ttl);
+        timeWheel.schedule(handle, detM.nsTime + (int64)ttlTime * 1000000);
+    }
+    updateQueued();
+    
+    // Remove the detections which didn't show up in the specified number
+    // of last messages or during the specified time period. The time is given
+    // by the stamps of the messages (not by the clock of the node, which
+    // differs e.g. when a bag file is replayed).
+    expired.clear();
+    countWheel.advance(msgCount, expired);
+    timeWheel.advance(latestTime, expired);
+    for(unsigned int i = 0; i < expired.size(); i++) {
+        removeTrack(expired[i]);
+    }
+    
+    // The services see the new state
+    snapshotDirty = true;
+    if(publish) {
+        publishSnapshot();
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Updates the filters by the queued measurements (in one batch)
+ */
+void TrackShard::updateQueued()
+{
+    int n = queuedTracks.size();
+    if(n == 0) {
+        return;
+    }
+    
+    // Slots of the filters and the measurements in the layout of the bank
+    slots.resize(n);
+    boxes.resize(KalmanBank::MEAS * n);
+    for(int k = 0; k < n; k++) {
+        slots[k] = detectionMem.get(queuedTracks[k])->slot;
+        for(int p = 0; p < KalmanBank::MEAS; p++) {
+            boxes[p * n + k] = queuedMeasurements[k * KalmanBank::MEAS + p];
+        }
+    }
+    
+    bank.update(&slots[0], &queuedDts[0], n, &boxes[0]);
+    
+    // Snapshots of the updated filters (the measurements are the newest
+    // ones in the histories)
+    for(int k = 0; k < n; k++) {
+        DetM *detM = detectionMem.get(queuedTracks[k]);
+        bank.save(detM->slot, detM->history.snapshot(detM->history.size() - 1));
+        detM->queued = false;
+    }
+    
+    queuedTracks.clear();
+    queuedDts.clear();
+    queuedMeasurements.clear();
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Restores the filter of a stored detection from the snapshot preceding
+ * the given measurement of its history and replays the measurements from it
+ */
+void TrackShard::replay(DetM &detM, int pos)
+{
+    const TrackHistory &history = detM.history;
+    bank.restore(detM.slot, history.snapshot(pos - 1));
+    
+    for(int k = pos; k < history.size(); k++) {
+        float dt = (history.time(k) - history.time(k - 1)) / 1e9f;
+        bank.update(&detM.slot, &dt, 1, history.measurement(k));
+        bank.save(detM.slot, detM.history.snapshot(k));
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Removes a stored detection (if it was not removed yet, it can expire
+ * by both the number of messages and the time at once)
+ */
+void TrackShard::removeTrack(const TrackHandle &handle)
+{
+    DetM *detM = detectionMem.get(handle);
+    if(detM == NULL) {
+        return;
+    }
+    
+    bank.remove(detM->slot); // Free Kalman filter
+    grid.remove(detM->slot);
+    countWheel.cancel(handle);
+    timeWheel.cancel(handle);
+    detectionMem.erase(handle);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Publishes the current state of the stored detections for the services
+ * (see SnapshotExchange)
+ *
+ * The writable snapshot contains an older state, which is brought up to date
+ * by the versions of the detections: only the detections changed since then
+ * are copied, together with their filters and boxes in the grid. The indices
+ * by positions are rebuilt only if some detection was added or removed.
+ */
+void TrackShard::publishSnapshot()
+{
+    TrackSnapshot &snapshot = exchange.writable();
+    bool reindex = (snapshot.views.size() != (unsigned int)bank.capacity());
+    
+    // Remove the detections which do not exist anymore (or were replaced
+    // by a new detection of the same object with another filter)
+    for(int pos = snapshot.tracks.size() - 1; pos >= 0; pos--) {
+        TrackView &view = snapshot.tracks.at(pos);
+        const DetM *detM = detectionMem.find(snapshot.tracks.classAt(pos), snapshot.tracks.idAt(pos));
+        if(detM != NULL && detM->slot == view.slot) {
+            continue;
+        }
+        
+        snapshot.grid.remove(view.slot);
+        if(detM == NULL) {
+            snapshot.tracks.erase(snapshot.tracks.handleAt(pos));
+        }
+        else {
+            view.version = -1; // To be copied
+        }
+        reindex = true;
+    }
+    
+    // Copy the new and changed detections
+    snapshotSlots.clear();
+    for(int i = 0; i < detectionMem.size(); i++) {
+        const DetM &detM = detectionMem.at(i);
+        bool isNew;
+        TrackView &view = *snapshot.tracks.get(snapshot.tracks.insert(detectionMem.classAt(i),
+                                                                      detectionMem.idAt(i), &isNew));
+        if(isNew) {
+            view.version = -1;
+            reindex = true;
+        }
+        if(view.version == detM.version) {
+            continue;
+        }
+        
+        view.det = detM.det;
+        view.slot = detM.slot;
+        view.nsTime = detM.nsTime;
+        view.version = detM.version;
+        const but_objdet_msgs::Rect &bb = detM.det.m_bb;
+        snapshot.grid.insert(detM.slot, detM.det.m_class, detM.det.m_id,
+                             cv::Rect(bb.x, bb.y, bb.width, bb.height));
+        snapshotSlots.push_back(detM.slot);
+    }
+    if(!snapshotSlots.empty()) {
+        snapshot.bank.copyFilters(bank, &snapshotSlots[0], snapshotSlots.size());
+    }
+    snapshot.predictions.resize(bank.capacity());
+    
+    // Positions of the detections by the slots of their filters and by their
+    // ID alone (of all the classes)
+    if(reindex) {
+        snapshot.views.assign(bank.capacity(), -1);
+        snapshot.ids.clear();
+        snapshot.sameId.resize(snapshot.tracks.size());
+        for(int pos = 0; pos < snapshot.tracks.size(); pos++) {
+            snapshot.views[snapshot.tracks.at(pos).slot] = pos;
+            
+            bool isNew;
+            int &last = *snapshot.ids.get(snapshot.ids.insert(0, snapshot.tracks.idAt(pos), &isNew));
+            snapshot.sameId[pos] = isNew ? -1 : last;
+            last = pos;
+        }
+    }
+    
+    exchange.publish();
+    snapshotDirty = false;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Publishes a snapshot if the state changed
+ */
+void TrackShard::refreshSnapshot()
+{
+    if(snapshotDirty) {
+        publishSnapshot();
+    }
+}
+
+}
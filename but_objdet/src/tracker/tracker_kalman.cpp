@@ -29,6 +29,7 @@
 #include <opencv2/video/tracking.hpp>
 
 #include "but_objdet/tracker/tracker_kalman.h"
+#include "but_objdet/tracker/kalman_blocks.h"
 
 using namespace cv;
 
@@ -36,6 +37,46 @@ using namespace cv;
 namespace but_objdet
 {
 
+//the covariance of the state never correlates different parameters (see
+//KalmanBlock), so the filter is computed by the blocks of the parameters;
+//block of the i-th parameter of errorCovPost
+template <int Order>
+static void getBlock(const KalmanFilter& KF, int i, int nParams, float P[Order + 1][Order + 1])
+{
+	for(int d = 0; d <= Order; d++)
+		for(int e = 0; e <= Order; e++)
+			P[d][e] = KF.errorCovPost.at<float>(i + d * nParams, i + e * nParams);
+}
+
+//prediction and correction of the i-th parameter (the same as KF.predict
+//and KF.correct restricted to the block of the parameter)
+template <int Order>
+static void updateParam(KalmanFilter& KF, int i, int nParams, float dt, float z)
+{
+	typedef KalmanBlock<Order> Block;
+	float P[Order + 1][Order + 1];
+	getBlock<Order>(KF, i, nParams, P);
+
+	float *x = KF.statePost.ptr<float>(0) + i;
+	Block::predictState(x, nParams, dt, x);
+	Block::predictCov(P, dt, KF.processNoiseCov.at<float>(i, i), P);
+	Block::correct(x, nParams, P, z, KF.measurementNoiseCov.at<float>(i, i));
+
+	for(int d = 0; d <= Order; d++)
+		for(int e = 0; e <= Order; e++)
+			KF.errorCovPost.at<float>(i + d * nParams, i + e * nParams) = P[d][e];
+}
+
+//predicted variance of the i-th parameter (without the measurement noise)
+template <int Order>
+static float predictVariance(const KalmanFilter& KF, int i, int nParams, float dt)
+{
+	float P[Order + 1][Order + 1];
+	getBlock<Order>(KF, i, nParams, P);
+	KalmanBlock<Order>::predictCov(P, dt, KF.processNoiseCov.at<float>(i, i), P);
+	return P[0][0];
+}
+
 TrackerKalman::TrackerKalman()
 {
 }
@@ -73,7 +114,7 @@ bool TrackerKalman::init(const Mat& measurement, bool secDerivate)
 	if(secDerivate)
 	{
 		//3*: for position, first (velocity) and second (acceleration) derivate
-		KF.init(3 * nParams, measurement.cols);
+		KF.init(3 * nParams, nParams);
 
 		KF.transitionMatrix.create(3 * nParams, 3 * nParams, CV_32F);
 
@@ -118,66 +159,68 @@ bool TrackerKalman::init(const Mat& measurement, bool secDerivate)
 	return true;
 }
 
-//it will modify the trans. matrix according to time elapsed
-void TrackerKalman::modifyTransMat(int64 miliseconds)
+//the same as transitionMatrix * statePost with the transition matrix for the
+//elapsed time, but computed in the closed form for each parameter (see KalmanBlock)
+const Mat& TrackerKalman::predict(int64 miliseconds)
 {
-	//number of predicted parameters (only the position, neither the velocity
-	// nor the acceleration)
-	int nParams;
-	//the factor for the translation (could be without / 1000.0, its just normalization
-	// so that whole process is in seconds (but ultimately its irrelevant, if not used anywhere)
 	float factor = miliseconds / 1000.0;
-	//in case of second derivate
+	int nStates = KF.statePost.rows;
+
+	temp.create(nStates, 1, CV_32F);
+	const float *state = KF.statePost.ptr<float>(0);
+	float *pred = temp.ptr<float>(0);
+
 	if(_secDerivate)
 	{
-		//1/3 of size of trans. matrix is the predicted parameters, couse the other
-		//thirds are the 1st and 2nd derivate
-		nParams = KF.transitionMatrix.cols / 3;
-
-		//need to put the factor in only at position of velocity and acceleration
-		//for the rows expressing position
+		int nParams = nStates / 3;
 		for(int i = 0; i < nParams; i++)
-		{
-			KF.transitionMatrix.at<float>(i, i + nParams) = factor;
-			KF.transitionMatrix.at<float>(i, i + 2 * nParams) = 0.5 * factor;
-		}
-		//need to put the factor in only at position of acceleration for the rows
-		//expressing acceleration
-		for(int i = 0; i < nParams; i++)
-		{
-			KF.transitionMatrix.at<float>(i + nParams, i + 2 * nParams) = factor;
-		}
+			KalmanBlock<2>::predictState(state + i, nParams, factor, pred + i);
 	}
-	//in case of only first derivate
 	else
 	{
-		//1/2 of size of trans. matrix is the predicted parameters, couse the other
-		//half are the 1st derivate
-		nParams = KF.transitionMatrix.cols / 2;
-		//need to put the factor in only at position of velocity for the rows 
-		//expressing position
+		int nParams = nStates / 2;
 		for(int i = 0; i < nParams; i++)
-		{
-			KF.transitionMatrix.at<float>(i, i + nParams) = factor;
-		}
+			KalmanBlock<1>::predictState(state + i, nParams, factor, pred + i);
 	}
+	return temp;
 }
 
-const Mat& TrackerKalman::predict(int64 miliseconds)
+//covariance of the predicted measurement: H * (F * P * F^T + Q) * H^T + R,
+//which is diagonal (computed by the blocks of the parameters)
+bool TrackerKalman::predictCovariance(int64 miliseconds, Mat& covariance)
 {
-	//has to modify the trans. matrix of kalman to acount for the time passed
-	modifyTransMat(miliseconds);
-	temp = KF.transitionMatrix * KF.statePost;
-	return temp;
+	float factor = miliseconds / 1000.0;
+	int nStates = KF.statePost.rows;
+	int nParams = _secDerivate ? nStates / 3 : nStates / 2;
+
+	covariance.create(nParams, nParams, CV_32F);
+	covariance.setTo(Scalar(0));
+	for(int i = 0; i < nParams; i++)
+	{
+		float variance = _secDerivate ? predictVariance<2>(KF, i, nParams, factor)
+		                              : predictVariance<1>(KF, i, nParams, factor);
+		covariance.at<float>(i, i) = variance + KF.measurementNoiseCov.at<float>(i, i);
+	}
+	return true;
 }
 
+//the same as KF.predict and KF.correct with the transition matrix for the
+//elapsed time, computed by the blocks of the parameters
 const Mat& TrackerKalman::update(const Mat& measurement, int64 miliseconds)
 {
-	//has to modify the trans. matrix of kalman to acount for the time passed
-	modifyTransMat(miliseconds);
-	KF.predict();
+	float factor = miliseconds / 1000.0;
+	int nStates = KF.statePost.rows;
+	int nParams = _secDerivate ? nStates / 3 : nStates / 2;
 
-	return KF.correct(measurement.t());
+	for(int i = 0; i < nParams; i++)
+	{
+		float z = measurement.at<float>(i);
+		if(_secDerivate)
+			updateParam<2>(KF, i, nParams, factor, z);
+		else
+			updateParam<1>(KF, i, nParams, factor, z);
+	}
+	return KF.statePost;
 }
 
 }
@@ -197,7 +240,8 @@ x	0	dx	0	=	1	0	1	0	expressing: x' = x + dx
 0	0	dx	0	=	0	0	1	0	expressing: dx' = dx
 0	0	0	dy	=	0	0	0	1	expressing: dy' = dy
 
-2nd. derivate (equations are: x' = x + dx + ddx/2 and dx' = dx + ddx):
+2nd. derivate (equations are: x' = x + dx + ddx/2 and dx' = dx + ddx, for the time t
+the factors are t for dx and t^2/2 for ddx):
 x	0	dx	0	ddx/2	0		=	1	0	1	0	0.5	0	expressing: x' = x + dx	+ ddx/2
 0	y	0	dy	0		ddy/2	=	0	1	0	1	0	0.5	expressing: y' = y + dy	+ ddy/2
 0	0	dx	0	ddx		0		=	0	0	1	0	1	0	expressing: dx' = dx + ddx
@@ -25,7 +25,11 @@
  * along with this file.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <sstream>
+#include <algorithm>
 #include <ros/ros.h> // Main header of ROS
+#include <ros/callback_queue.h>
+#include <boost/bind.hpp>
 
 // ObjDet API
 #include "but_objdet/but_objdet.h" // Main objects of ObjDet API
@@ -37,7 +41,6 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <cv_bridge/cv_bridge.h>
 
-#include "but_objdet/tracker/tracker_kalman.h"
 #include "but_objdet/tracker/tracker_kalman_node.h"
 #include <../../opt/ros/electric/stacks/ros_comm/utilities/rostime/include/ros/duration.h>
 
@@ -51,6 +54,7 @@ using namespace but_objdet_msgs;
 
 const string imageTopic = "/cam3d/rgb/image";
 const string detectionTopic = "/but_objdet/detections";
+const string frameTopic = "/camera/rgb/image_color"; // Images processed by the detectors
 
 
 namespace but_objdet
@@ -63,6 +67,14 @@ TrackerKalmanNode::TrackerKalmanNode()
 {   
     defaultTtl = 5;
     defaultTtlTime = 5000; // = 5s
+    poolAllocations = 0;
+    msgCount = 0;
+    msgTime = 0;
+    latestTime = 0;
+    spinner = NULL;
+    generation = 0;
+    active = 0;
+    quit = false;
 
     // Window name (for visualization detections and predictions)
     if(VISUAL_OUTPUT) {
@@ -78,17 +90,24 @@ TrackerKalmanNode::TrackerKalmanNode()
  */
 TrackerKalmanNode::~TrackerKalmanNode()
 {
+    // Stop the threads serving the services
+    if(spinner != NULL) {
+        spinner->stop();
+        delete spinner;
+    }
     
-	DetMem::iterator it;
-        for (it = detectionMem.begin(); it != detectionMem.end(); it++) {
-            _DetMem::iterator it2;
-            for (it2 = it->second.begin(); it2 != it->second.end(); it2++) {
-                delete it2->second.kf; // Free Kalman filter
-                
-
-            }  
-            
-        }
+    // Stop the threads of the shards
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        quit = true;
+    }
+    workCond.notify_all();
+    threads.join_all();
+    
+    // (the Kalman filters are freed together with the shards)
+    for(unsigned int s = 0; s < shards.size(); s++) {
+        delete shards[s];
+    }
     
     // Create a window to vizualize the incoming video, detections and predictions
     if(VISUAL_OUTPUT) {
@@ -102,16 +121,68 @@ TrackerKalmanNode::~TrackerKalmanNode()
  */
 void TrackerKalmanNode::rosInit()
 {
+    // The stored detections are split into shards by their class, each
+    // processed by its own thread (the first one by the main thread)
+    int nShards;
+    ros::param::param<int>("~shards", nShards, 1);
+    nShards = max(nShards, 1);
+    batches.resize(nShards);
+    for(int s = 0; s < nShards; s++) {
+        shards.push_back(new TrackShard(defaultTtl, defaultTtlTime));
+    }
+    for(int s = 1; s < nShards; s++) {
+        threads.create_thread(boost::bind(&TrackerKalmanNode::workerLoop, this, s));
+    }
+    
+    // In the multi-threaded mode, the services are called by a pool of threads
+    // (from their own queue) while the detections are processed, otherwise
+    // all the callbacks are called by the main thread
+    ros::param::param<bool>("~multithreaded", multithreaded, false);
+    int serviceThreads;
+    ros::param::param<int>("~service_threads", serviceThreads, 2);
+    
+    ros::NodeHandle serviceNh;
+    if(multithreaded) {
+        serviceNh.setCallbackQueue(&serviceQueue);
+    }
+    
     // Create and advertise a service for prediction of detections
-    predictionSRV = nh.advertiseService(BUT_OBJDET_PredictDetections_SRV,
+    predictionSRV = serviceNh.advertiseService(BUT_OBJDET_PredictDetections_SRV,
         &TrackerKalmanNode::predictDetections, this);
 
     // Create and advertise a service for providing objects
-    objectsSRV = nh.advertiseService(BUT_OBJDET_GetObjects_SRV,
+    objectsSRV = serviceNh.advertiseService(BUT_OBJDET_GetObjects_SRV,
         &TrackerKalmanNode::getObjects, this);
     
-    // Subscribe to a topic with detections (published by a detector node)
-    detSub = nh.subscribe(detectionTopic, 10, &TrackerKalmanNode::newDataCallback, this);
+    // Predictions of all the objects are published for each image processed
+    // by the detectors (for the stamp of the image), so the detectors need
+    // not call the prediction service (the name of the topic is defined
+    // in but_objdet/services_list.h). The images are handled as the services.
+    predictionsPub = nh.advertise<but_objdet_msgs::DetectionArray>(BUT_OBJDET_Predictions_TOPIC, 10);
+    string frames;
+    ros::param::param<string>("~frame_topic", frames, frameTopic);
+    frameSub = serviceNh.subscribe(frames, 10, &TrackerKalmanNode::newFrameCallback, this);
+    int topicFields;
+    ros::param::param<int>("~prediction_fields", topicFields, 0); // (as in PredictDetections)
+    frameFields = (topicFields != 0) ? topicFields : ALL_FIELDS;
+    
+    if(multithreaded) {
+        for(int s = 0; s < nShards; s++) {
+            shards[s]->refreshSnapshot();
+        }
+        spinner = new ros::AsyncSpinner(max(serviceThreads, 1), &serviceQueue);
+        spinner->start();
+    }
+    
+    // Subscribe to topics with detections (published by detector nodes),
+    // the names can be given by a parameter (separated by spaces)
+    string topics;
+    ros::param::param<string>("~detection_topics", topics, detectionTopic);
+    istringstream topicStream(topics);
+    string topic;
+    while(topicStream >> topic) {
+        detSubs.push_back(nh.subscribe(topic, 10, &TrackerKalmanNode::newDataCallback, this));
+    }
     
     if(VISUAL_OUTPUT) {
         // Subscribe to a topic with images
@@ -122,49 +193,75 @@ void TrackerKalmanNode::rosInit()
     ROS_INFO("Tracker is running...");
 }
 
+/* -----------------------------------------------------------------------------
+ * Shard of the detections of a class
+ */
+int TrackerKalmanNode::shardOf(int objClass) const
+{
+    return ((unsigned int)objClass * 0x9E3779B1u >> 8) % shards.size();
+}
+
+
 /* -----------------------------------------------------------------------------
  * Function implementing the detection service
  * 
+ * The objects are taken from the current snapshots of the shards (in
+ * the multi-threaded mode, they are published after each message with
+ * detections, otherwise they are published when needed).
  */
 bool TrackerKalmanNode::getObjects(but_objdet::GetObjects::Request &req,
                                           but_objdet::GetObjects::Response &res)
 {
-    // Object ID was specified
-    if (req.object_id != -1) {
-       
-    }
-    // Class ID was specified => return all objects from that class
-    else if(req.class_id != -1) {
-		DetMem::iterator it;
-		it = detectionMem.find(req.class_id);
-		if (it == detectionMem.end())
-		{
-			
-			return true;
-		}
-        _DetMem::iterator it2;
-        for (it2 = it->second.begin(); it2 != it->second.end(); it2++) {
-           	but_objdet_msgs::Detection det = it2->second.det;
-			res.objects.push_back(det);
-           
-        }
+    // All the fields if none is specified
+    unsigned int fields = req.fields;
+    if(fields == 0) {
+        fields = ALL_FIELDS;
     }
-    // Nothing specified => return all stored objects
-    else {
-	DetMem::iterator it;
-        for (it = detectionMem.begin(); it != detectionMem.end(); it++) {
-            _DetMem::iterator it2;
-            for (it2 = it->second.begin(); it2 != it->second.end(); it2++) {
-                but_objdet_msgs::Detection det = it2->second.det;
-            	res.objects.push_back(det);
-                
-
-
-            }  
-            
+    
+    // Objects specified by IDs (one or more, sorted for selectTracks)
+    vector<int> objectIds(req.object_ids.begin(), req.object_ids.end());
+    if(req.object_id != -1) {
+        objectIds.push_back(req.object_id);
+    }
+    sort(objectIds.begin(), objectIds.end());
+    objectIds.erase(unique(objectIds.begin(), objectIds.end()), objectIds.end());
+    
+    GridQuery spatial;
+    spatial.type = req.spatial;
+    spatial.roi = cv::Rect(req.roi.x, req.roi.y, req.roi.width, req.roi.height);
+    spatial.x = req.point.x;
+    spatial.y = req.point.y;
+    spatial.radius = req.radius;
+    spatial.k = max(0, (int)req.k); // k <= 0 => no objects
+    
+    // Only the shard of the class is needed if it is specified
+    int firstShard = 0, endShard = shards.size();
+    if(req.class_id != -1) {
+        firstShard = shardOf(req.class_id);
+        endShard = firstShard + 1;
+    }
+    
+    vector<const TrackView *> selected;
+    vector<float> distances;
+    for(int s = firstShard; s < endShard; s++) {
+        if(!multithreaded) {
+            shards[s]->refreshSnapshot();
+        }
+        SnapshotExchange<TrackSnapshot>::Reader snapshot(shards[s]->snapshots());
+        
+        selected.clear();
+        selectTracks(*snapshot, req.class_id, objectIds, spatial, selected, distances);
+        
+        unsigned int first = res.objects.size();
+        res.objects.resize(first + selected.size());
+        for(unsigned int j = 0; j < selected.size(); j++) {
+            copyFields(selected[j]->det, fields, res.objects[first + j]);
         }
-	}
-     
+    }
+    
+    if(spatial.type == GridQuery::NEAREST && endShard - firstShard > 1) {
+        keepNearest(distances, spatial.k, 0, res.objects);
+    }
     
     return true;
 }
@@ -178,172 +275,490 @@ bool TrackerKalmanNode::predictDetections(but_objdet::PredictDetections::Request
 {   
     //ROS_INFO("New request: object_id: %d, class_id: %d", req.object_id, req.class_id);
 
-	//Object ID and Class ID was specified
-  
-    if(req.object_id != -1 && req.class_id != -1) {
-        
-		DetMem::iterator it = detectionMem.find(req.class_id);	
-		
-		if (it == detectionMem.end())
-		{
-			//no obj in this class
-			return true;
-		}
+    // All the fields if none is specified
+    unsigned int fields = req.fields;
+    if(fields == 0) {
+        fields = ALL_FIELDS;
+    }
+    
+    // Spatial selection of the objects
+    GridQuery spatial;
+    spatial.type = req.spatial;
+    spatial.roi = cv::Rect(req.roi.x, req.roi.y, req.roi.width, req.roi.height);
+    spatial.x = req.point.x;
+    spatial.y = req.point.y;
+    spatial.radius = req.radius;
+    spatial.k = max(0, (int)req.k); // k <= 0 => no objects
+    
+    // The object ID is used also without the class ID (see GetObjects)
+    vector<int> objectIds;
+    if(req.object_id != -1) {
+        objectIds.push_back(req.object_id);
+    }
+    
+    // Times were specified => trajectories (not cached)
+    if(!req.times.empty()) {
+        vector<int64> times(req.times.size());
+        for(unsigned int j = 0; j < times.size(); j++) {
+            times[j] = rosTimeToNs(req.times[j]);
+        }
+        predictObjectTrajectories(req.class_id, objectIds, spatial, times,
+                                  (fields & PredictDetectionsRequest::FIELD_COVARIANCE) != 0,
+                                  res.trajectories);
+        return true;
+    }
+    
+    predictObjects(req.class_id, objectIds, spatial, rosTimeToNs(req.header.stamp), fields,
+                   res.predictions);
+    
+    return true;
+}
 
-		_DetMem::iterator it2 = it->second.find(req.object_id);
-		but_objdet_msgs::Detection det = it->second[req.object_id].det;
-		
-		// Request time in miliseconds from the time of detection
-                int predTime = rosTimeToMs(req.header.stamp) - detectionMem[req.class_id][req.object_id].msTime;
 
-                // Get prediction
-                Mat prediction = detectionMem[req.class_id][req.object_id].kf->predict(predTime);
-                det.m_bb.x = prediction.at<float>(0);
-                det.m_bb.y = prediction.at<float>(1);
-                det.m_bb.width = prediction.at<float>(2);
-                det.m_bb.height = prediction.at<float>(3);
+/* -----------------------------------------------------------------------------
+ * Prediction of the requested objects (for the service and the topic)
+ *
+ * The predictions are computed from the current snapshot (as in getObjects).
+ * Repeated requests for the same time (e.g. from several detectors processing
+ * the same frame) are served from the caches of the snapshots.
+ */
+void TrackerKalmanNode::predictObjects(int classId, const vector<int> &objectIds,
+                                       const GridQuery &spatial, int64 reqTime,
+                                       unsigned int fields,
+                                       vector<but_objdet_msgs::Detection> &predictions)
+{
+    // Only the shard of the class is needed if it is specified
+    int firstShard = 0, endShard = shards.size();
+    if(classId != -1) {
+        firstShard = shardOf(classId);
+        endShard = firstShard + 1;
+    }
+    
+    unsigned int first = predictions.size();
+    vector<const TrackView *> requested;
+    vector<float> distances;
+    for(int s = firstShard; s < endShard; s++) {
+        if(!multithreaded) {
+            shards[s]->refreshSnapshot();
+        }
+        SnapshotExchange<TrackSnapshot>::Reader snapshot(shards[s]->snapshots());
+        
+        requested.clear();
+        selectTracks(*snapshot, classId, objectIds, spatial, requested, distances);
+        predictTracks(*snapshot, requested, reqTime, fields, predictions);
+    }
+    
+    if(spatial.type == GridQuery::NEAREST && endShard - firstShard > 1) {
+        keepNearest(distances, spatial.k, first, predictions);
+    }
+}
 
-                res.predictions.push_back(det);
 
+/* -----------------------------------------------------------------------------
+ * Prediction of trajectories of the requested objects (as predictObjects)
+ */
+void TrackerKalmanNode::predictObjectTrajectories(int classId, const vector<int> &objectIds,
+                                                  const GridQuery &spatial,
+                                                  const vector<int64> &times, bool variances,
+                                                  vector<but_objdet_msgs::Trajectory> &trajectories)
+{
+    // Only the shard of the class is needed if it is specified
+    int firstShard = 0, endShard = shards.size();
+    if(classId != -1) {
+        firstShard = shardOf(classId);
+        endShard = firstShard + 1;
+    }
+    
+    unsigned int first = trajectories.size();
+    vector<const TrackView *> requested;
+    vector<float> distances;
+    for(int s = firstShard; s < endShard; s++) {
+        if(!multithreaded) {
+            shards[s]->refreshSnapshot();
+        }
+        SnapshotExchange<TrackSnapshot>::Reader snapshot(shards[s]->snapshots());
+        
+        requested.clear();
+        selectTracks(*snapshot, classId, objectIds, spatial, requested, distances);
+        predictTrajectories(*snapshot, requested, times, variances, trajectories);
+    }
+    
+    if(spatial.type == GridQuery::NEAREST && endShard - firstShard > 1) {
+        keepNearest(distances, spatial.k, first, trajectories);
+    }
+}
 
+
+/* -----------------------------------------------------------------------------
+ * Selection of the requested detections of a snapshot
+ *
+ * The detections selected spatially are found by the grid of the snapshot,
+ * the ones specified by IDs by the index of the IDs (of the specified class
+ * or of all the classes), i.e. each ID is found in O(1).
+ */
+void TrackerKalmanNode::selectTracks(const TrackSnapshot &snapshot, int classId,
+                                     const vector<int> &objectIds, const GridQuery &spatial,
+                                     vector<const TrackView *> &selected,
+                                     vector<float> &distances) const
+{
+    const TrackStore<TrackView> &tracks = snapshot.tracks;
+    
+    // Region or point was specified => detections selected by the grid
+    // (of the specified class and objects if any, the grid filters them
+    // before taking the k nearest)
+    if(spatial.type != GridQuery::NONE) {
+        vector<int> gridSlots;
+        vector<float> gridDistances;
+        snapshot.grid.query(spatial, classId, gridSlots, gridDistances,
+                            objectIds.empty() ? NULL : &objectIds);
+        for(unsigned int j = 0; j < gridSlots.size(); j++) {
+            selected.push_back(&tracks.at(snapshot.views[gridSlots[j]]));
+            distances.push_back(gridDistances[j]);
+        }
+    }
+    
+    // Object IDs were specified => return these objects
+    else if(!objectIds.empty()) {
+        for(unsigned int j = 0; j < objectIds.size(); j++) {
+            if(classId != -1) {
+                const TrackView *view = tracks.find(classId, objectIds[j]);
+                if(view != NULL) {
+                    selected.push_back(view);
+                }
+            }
+            else {
+                const int *last = snapshot.ids.find(0, objectIds[j]);
+                for(int pos = (last != NULL) ? *last : -1; pos != -1; pos = snapshot.sameId[pos]) {
+                    selected.push_back(&tracks.at(pos));
+                }
+            }
+        }
     }
     
     // Class ID was specified => return all detections from that class
-    else if(req.class_id != -1) {
-        _DetMem::iterator it;
-        for (it = detectionMem[req.class_id].begin(); it != detectionMem[req.class_id].end(); it++) {
-            
-                
-                but_objdet_msgs::Detection det = it->second.det;
-        
-                // Request time in miliseconds from the time of detection
-                int predTime = rosTimeToMs(req.header.stamp) - it->second.msTime;
-                
-                // Get prediction
-                Mat prediction = it->second.kf->predict(predTime);
-                det.m_bb.x = prediction.at<float>(0);
-                det.m_bb.y = prediction.at<float>(1);
-                det.m_bb.width = prediction.at<float>(2);
-                det.m_bb.height = prediction.at<float>(3);
-                
-                res.predictions.push_back(det);
-            
+    else if(classId != -1) {
+        for (int i = 0; i < tracks.size(); i++) {
+            if (tracks.classAt(i) == classId) {
+                selected.push_back(&tracks.at(i));
+            }
         }
     }
     
-    // Nothing specified => return predictions for all stored detections
+    // Nothing specified => return all stored detections
     else {
-		DetMem::iterator it;
-        for (it = detectionMem.begin(); it != detectionMem.end(); it++) {
-            _DetMem::iterator it2;
-            for (it2 = it->second.begin(); it2 != it->second.end(); it2++) {
-                but_objdet_msgs::Detection det = it2->second.det;
-
-		        // Request time in miliseconds from the time of detection
-		        int predTime = rosTimeToMs(req.header.stamp) - it2->second.msTime;
-		        
-		        // Get prediction
-		        Mat prediction = it2->second.kf->predict(predTime);
-		        det.m_bb.x = prediction.at<float>(0);
-		        det.m_bb.y = prediction.at<float>(1);
-		        det.m_bb.width = prediction.at<float>(2);
-		        det.m_bb.height = prediction.at<float>(3);
-		        
-		        res.predictions.push_back(det);
-
-            }  
-            
+        for (int i = 0; i < tracks.size(); i++) {
+            selected.push_back(&tracks.at(i));
         }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Keeps the k nearest of the detections found in the shards (sorted by their
+ * distance)
+ */
+template <class T>
+void TrackerKalmanNode::keepNearest(const vector<float> &distances, int k, unsigned int first,
+                                    vector<T> &detections)
+{
+    vector<pair<float, int> > order(distances.size());
+    for(unsigned int j = 0; j < distances.size(); j++) {
+        order[j] = make_pair(distances[j], j);
+    }
+    sort(order.begin(), order.end());
+    
+    k = max(0, min((int)order.size(), k));
+    vector<T> nearest(k);
+    for(int j = 0; j < k; j++) {
+        nearest[j] = detections[first + order[j].second];
+    }
+    detections.resize(first);
+    detections.insert(detections.end(), nearest.begin(), nearest.end());
+}
 
 
+/* -----------------------------------------------------------------------------
+ * Prediction of stored detections (their bounding boxes and the covariances
+ * of the bounding boxes, which can be used by matchers for gating). The other
+ * fields of the stored detections are copied only if they are requested
+ * (e.g. the masks are not needed by the matchers). All the
+ * filters missing in the cache of the snapshot are predicted by one call
+ * of the bank of the snapshot.
+ */
+void TrackerKalmanNode::predictTracks(const TrackSnapshot &snapshot,
+                                      const vector<const TrackView *> &tracks, int64 reqTime,
+                                      unsigned int fields,
+                                      vector<but_objdet_msgs::Detection> &predictions) const
+{
+    int n = tracks.size();
+    if(n == 0) {
+        return;
+    }
+    
+    // Predicted bounding boxes and their variances (MEAS values per track),
+    // the ones computed before for the same time are taken from the cache
+    vector<float> predBoxes(KalmanBank::MEAS * n);
+    vector<float> predVariances(KalmanBank::MEAS * n);
+    vector<int> missing;
+    PredictionCache &cache = snapshot.predictions;
+    cache.lookup(tracks, reqTime, &predBoxes[0], &predVariances[0], missing);
+    
+    // The remaining ones are computed
+    int m = missing.size();
+    if(m > 0) {
+        
+        // Slots of the filters and times (in seconds) from the detections
+        vector<int> filterSlots(m);
+        vector<float> dts(m);
+        for(int j = 0; j < m; j++) {
+            filterSlots[j] = tracks[missing[j]]->slot;
+            dts[j] = (reqTime - tracks[missing[j]]->nsTime) / 1e9f;
+        }
+        
+        vector<float> bankBoxes(KalmanBank::MEAS * m);
+        vector<float> bankVariances(KalmanBank::MEAS * m);
+        snapshot.bank.predict(&filterSlots[0], &dts[0], m, &bankBoxes[0], &bankVariances[0]);
+        
+        for(int j = 0; j < m; j++) {
+            for(int p = 0; p < KalmanBank::MEAS; p++) {
+                predBoxes[missing[j] * KalmanBank::MEAS + p] = bankBoxes[p * m + j];
+                predVariances[missing[j] * KalmanBank::MEAS + p] = bankVariances[p * m + j];
+            }
+        }
+        
+        cache.store(tracks, missing, reqTime, &predBoxes[0], &predVariances[0]);
+    }
+    
+    // (the totals are read only if the message is logged)
+    ROS_DEBUG("Prediction cache: %d hits, %d misses (%lld, %lld in the snapshot)", n - m, m,
+              (long long)cache.hits(), (long long)cache.misses());
+    
+    // Fill in the predicted detections (just the requested fields)
+    unsigned int first = predictions.size();
+    predictions.resize(first + n);
+    for(int k = 0; k < n; k++) {
+        but_objdet_msgs::Detection &det = predictions[first + k];
+        copyFields(tracks[k]->det, fields, det);
+        
+        const float *box = &predBoxes[k * KalmanBank::MEAS];
+        det.m_bb.x = box[0];
+        det.m_bb.y = box[1];
+        det.m_bb.width = box[2];
+        det.m_bb.height = box[3];
+        
+        // Covariance of the predicted bounding box (diagonal for this model)
+        if(fields & PredictDetectionsRequest::FIELD_COVARIANCE) {
+            det.m_cov.assign(16, 0);
+            for(int p = 0; p < KalmanBank::MEAS; p++) {
+                det.m_cov[p * 5] = predVariances[k * KalmanBank::MEAS + p];
+            }
+        }
+    }
+}
 
+
+/* -----------------------------------------------------------------------------
+ * Prediction of trajectories of stored detections
+ *
+ * All the times of all the filters are predicted by one call of the bank
+ * of the snapshot (each filter is read once for all the times).
+ */
+void TrackerKalmanNode::predictTrajectories(const TrackSnapshot &snapshot,
+                                            const vector<const TrackView *> &tracks,
+                                            const vector<int64> &times, bool variances,
+                                            vector<but_objdet_msgs::Trajectory> &trajectories) const
+{
+    int n = tracks.size();
+    int m = times.size();
+    if(n == 0 || m == 0) {
+        return;
     }
     
-    return true;
+    // Slots of the filters and times (in seconds) from the detections
+    vector<int> filterSlots(n);
+    vector<float> dts(n * m);
+    for(int k = 0; k < n; k++) {
+        filterSlots[k] = tracks[k]->slot;
+        for(int j = 0; j < m; j++) {
+            dts[k * m + j] = (times[j] - tracks[k]->nsTime) / 1e9f;
+        }
+    }
+    
+    vector<float> trajBoxes(KalmanBank::MEAS * n * m);
+    vector<float> trajVariances(variances ? KalmanBank::MEAS * n * m : 0);
+    snapshot.bank.predictTrajectories(&filterSlots[0], &dts[0], n, m, &trajBoxes[0],
+                                      variances ? &trajVariances[0] : NULL);
+    
+    // Fill in the trajectories
+    unsigned int first = trajectories.size();
+    trajectories.resize(first + n);
+    for(int k = 0; k < n; k++) {
+        but_objdet_msgs::Trajectory &trajectory = trajectories[first + k];
+        trajectory.m_id = tracks[k]->det.m_id;
+        trajectory.m_class = tracks[k]->det.m_class;
+        
+        trajectory.m_bb.resize(m);
+        for(int j = 0; j < m; j++) {
+            const float *box = &trajBoxes[(k * m + j) * KalmanBank::MEAS];
+            trajectory.m_bb[j].x = box[0];
+            trajectory.m_bb[j].y = box[1];
+            trajectory.m_bb[j].width = box[2];
+            trajectory.m_bb[j].height = box[3];
+        }
+        if(variances) {
+            trajectory.m_var.assign(trajVariances.begin() + k * m * KalmanBank::MEAS,
+                                    trajVariances.begin() + (k + 1) * m * KalmanBank::MEAS);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Copies the requested fields of a detection (m_id, m_class and m_bb
+ * are copied always, see FIELD_BOX)
+ */
+void TrackerKalmanNode::copyFields(const but_objdet_msgs::Detection &src, unsigned int fields,
+                                   but_objdet_msgs::Detection &dst)
+{
+    dst.m_id = src.m_id;
+    dst.m_class = src.m_class;
+    dst.m_bb = src.m_bb;
+    if(fields & PredictDetectionsRequest::FIELD_HEADER) {
+        dst.header = src.header;
+    }
+    if(fields & PredictDetectionsRequest::FIELD_SCORE) {
+        dst.m_score = src.m_score;
+    }
+    if(fields & PredictDetectionsRequest::FIELD_POSITION) {
+        dst.m_pos_2D = src.m_pos_2D;
+    }
+    if(fields & PredictDetectionsRequest::FIELD_MASK) {
+        dst.m_mask = src.m_mask;
+    }
+    if(fields & PredictDetectionsRequest::FIELD_ANGLE) {
+        dst.m_angle = src.m_angle;
+    }
+    if(fields & PredictDetectionsRequest::FIELD_SPEED) {
+        dst.m_speed = src.m_speed;
+    }
 }
 
 
 /* -----------------------------------------------------------------------------
  * Callback function called when new detections are received
+ *
+ * The detections are split by the shards of their classes and the shards
+ * process them concurrently (each shard is called even if there are none
+ * of its detections, so its detections expire).
  */
 void TrackerKalmanNode::newDataCallback(const but_objdet_msgs::DetectionArrayConstPtr &detArrayMsg)
 {   
    //ROS_ERROR("%d",detArrayMsg->detections.size());
     
-    int detClass;
+    msgTime = rosTimeToNs(detArrayMsg->header.stamp);
+    if(msgTime > latestTime) {
+        latestTime = msgTime;
+    }
+    msgCount++;
 	
+    for(unsigned int s = 0; s < batches.size(); s++) {
+        batches[s].clear();
+    }
     for(unsigned int i = 0; i < detArrayMsg->detections.size(); i++) {
-		detClass = detArrayMsg->detections[i].m_class;
-		int detId = detArrayMsg->detections[i].m_id;
-
-		    
-        
-        // Check if the current detection is already in the memory
-        
-		_DetMem::iterator it = detectionMem[detClass].find(detId);
-        
-        // When it was found
-        if(it != detectionMem[detClass].end()) {
-            //ROS_ERROR("Object ID found!");
-            detectionMem[detClass][detId].det = detArrayMsg->detections[i];
-            detectionMem[detClass][detId].ttl++;
-            
-            int time = rosTimeToMs(detArrayMsg->header.stamp);
-            int timeFromLastUpdate = time - detectionMem[detClass][detId].msTime;
-            detectionMem[detClass][detId].msTime = time;
-            
-            // Update
-            Mat newMeasurement(1, 4, CV_32F);
-		    newMeasurement.at<float>(0) = detectionMem[detClass][detId].det.m_bb.x;
-		    newMeasurement.at<float>(1) = detectionMem[detClass][detId].det.m_bb.y;
-		    newMeasurement.at<float>(2) = detectionMem[detClass][detId].det.m_bb.width;
-		    newMeasurement.at<float>(3) = detectionMem[detClass][detId].det.m_bb.height;
-
-            
+        const Detection &det = detArrayMsg->detections[i];
+        batches[shardOf(det.m_class)].push_back(&det);
+    }
+    
+    // Shard 0 is processed by this thread, the others by their threads
+    if(shards.size() == 1) {
+        processShard(0);
+    }
+    else {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            active = shards.size() - 1;
+            generation++;
         }
+        workCond.notify_all();
         
-        // When it wasn't found => add it to memory
-        else {
-           // ROS_ERROR("Object ID not found!");
-            detectionMem[detClass][detId].det = detArrayMsg->detections[i];
-            detectionMem[detClass][detId].ttl = defaultTtl;
-            detectionMem[detClass][detId].kf = new TrackerKalman();
-            detectionMem[detClass][detId].msTime = rosTimeToMs(detArrayMsg->header.stamp);
-            
-		    // Initialization with the first measurement
-		    Mat initMeasurement(1, 4, CV_32F);
-		    initMeasurement.at<float>(0) = detectionMem[detClass][detId].det.m_bb.x;
-		    initMeasurement.at<float>(1) = detectionMem[detClass][detId].det.m_bb.y;
-		    initMeasurement.at<float>(2) = detectionMem[detClass][detId].det.m_bb.width;
-		    initMeasurement.at<float>(3) = detectionMem[detClass][detId].det.m_bb.height;
-            detectionMem[detClass][detId].kf->init(initMeasurement, true);
-            
+        processShard(0);
+        
+        boost::mutex::scoped_lock lock(mutex);
+        while(active > 0) {
+            doneCond.wait(lock);
         }
     }
     
-    // Decrease TTL to all saved detections
-    _DetMem::iterator it;
-    vector<int> toBeRemoved; // Vector of IDs whose detection has TTL = 0
-    for (it = detectionMem[detClass].begin(); it != detectionMem[detClass].end(); it++) {
-        it->second.ttl--;
-        //std::cout << "TTL: " << it->second.ttl << " " << detectionMem.size() << std::endl;
+    // Expired tracks are recycled, so the pools grow (and allocate) only
+    // when there are more tracks than ever before
+    int allocations = 0;
+    for(unsigned int s = 0; s < shards.size(); s++) {
+        allocations += shards[s]->allocations();
+    }
+    if(allocations != poolAllocations) {
+        poolAllocations = allocations;
+        ROS_DEBUG("Track pools grew: %d allocations", allocations);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Processes the detections of the current message by a shard
+ */
+void TrackerKalmanNode::processShard(int s)
+{
+    // In the multi-threaded mode, the services see the new state at once
+    shards[s]->process(batches[s], msgTime, msgCount, latestTime, multithreaded);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Main loop of a thread of a shard
+ */
+void TrackerKalmanNode::workerLoop(int s)
+{
+    int seen = 0;
+    
+    for(;;) {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while(generation == seen && !quit) {
+                workCond.wait(lock);
+            }
+            if(quit) return;
+            seen = generation;
+        }
         
-        // If it didn't show up in the specified number of last detections
-        // or during the specified time period => mark it for removal
+        processShard(s);
         
-        //TODO: not working, why? if(it->second.ttl == 0 || (rosTimeToMs(ros::Time::now()) - it->second.msTime) > defaultTtlTime) {
-        if(it->second.ttl == 0)    {
-                toBeRemoved.push_back(it->second.det.m_id);
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            if(--active == 0) {
+                doneCond.notify_one();
+            }
         }
     }
-    
-    // Remove marked detections
-    for(unsigned int i = 0; i < toBeRemoved.size(); i++) {
-        delete detectionMem[detClass][toBeRemoved[i]].kf; // Free Kalman filter
-        detectionMem[detClass].erase(toBeRemoved[i]);
-      // ROS_ERROR("remove");
-    }
+}
 
+
+/* -----------------------------------------------------------------------------
+ * Callback function called when an image processed by the detectors is received
+ *
+ * Only the stamp of the image is used. The predictions are computed just
+ * if somebody listens (a detector requesting the same time by the service
+ * then gets them from the cache).
+ */
+void TrackerKalmanNode::newFrameCallback(const sensor_msgs::ImageConstPtr &imageMsg)
+{
+    if(predictionsPub.getNumSubscribers() == 0) {
+        return;
+    }
+    
+    DetectionArray predArray;
+    predArray.header = imageMsg->header;
+    predictObjects(-1, vector<int>(), GridQuery(), rosTimeToNs(imageMsg->header.stamp),
+                   frameFields, predArray.detections);
+    predictionsPub.publish(predArray);
 }
 
 
@@ -374,13 +789,13 @@ void TrackerKalmanNode::newImageCallback(const sensor_msgs::ImageConstPtr &image
         image.copyTo(img3ch);
     }
   
-	DetMem::iterator it0;
-    _DetMem::iterator it;
-    for (it0 = detectionMem.begin(); it0 != detectionMem.end(); it0++) {
-    for (it = it0->second.begin(); it != it0->second.end(); it++) {
+    for (unsigned int s = 0; s < shards.size(); s++) {
+    const TrackStore<DetM> &tracks = shards[s]->tracks();
+    for (int i = 0; i < tracks.size(); i++) {
+        const DetM &detM = tracks.at(i);
         
         // Visualize detection
-        Detection det = it->second.det;
+        Detection det = detM.det;
         rectangle(
 	        img3ch,
 	        cvPoint(det.m_bb.x, det.m_bb.y),
@@ -389,14 +804,15 @@ void TrackerKalmanNode::newImageCallback(const sensor_msgs::ImageConstPtr &image
 	    );
 	    
 	    // Obtain and visualize corresponding prediction
-	    int predTime = rosTimeToMs(ros::Time::now()) - it->second.msTime;
+	    int64 predTime = rosTimeToNs(ros::Time::now()) - detM.nsTime;
             
-	    Mat prediction = it->second.kf->predict(predTime);
+	    float prediction[KalmanBank::STATE];
+	    shards[s]->filters().predictState(detM.slot, predTime / 1e9f, prediction);
 	    Detection pred;
-        pred.m_bb.x = prediction.at<float>(0);
-        pred.m_bb.y = prediction.at<float>(1);
-        pred.m_bb.width = prediction.at<float>(2);
-        pred.m_bb.height = prediction.at<float>(3);
+        pred.m_bb.x = prediction[0];
+        pred.m_bb.y = prediction[1];
+        pred.m_bb.width = prediction[2];
+        pred.m_bb.height = prediction[3];
 
         rectangle(
 	        img3ch,
@@ -405,7 +821,7 @@ void TrackerKalmanNode::newImageCallback(const sensor_msgs::ImageConstPtr &image
 	        cvScalar(0,0,255)
 	    );
     }
-	}
+    }
     
     if(VISUAL_OUTPUT) {
         imshow(winName, img3ch);
@@ -414,12 +830,11 @@ void TrackerKalmanNode::newImageCallback(const sensor_msgs::ImageConstPtr &image
 
 
 /* =============================================================================
- * Converts ros::Time to miliseconds
+ * Converts ros::Time to nanoseconds
  */
-int TrackerKalmanNode::rosTimeToMs(ros::Time stamp)
+int64 TrackerKalmanNode::rosTimeToNs(ros::Time stamp)
 {
-    //std::cout << "Time: " << stamp.sec << " " << stamp.nsec << " " << stamp.sec * 1000 + stamp.nsec / 1000000 << std::endl;
-    return stamp.sec * 1000 + stamp.nsec / 1000000;
+    return (int64)stamp.sec * 1000000000 + stamp.nsec;
 }
 
 }
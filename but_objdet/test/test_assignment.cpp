@@ -0,0 +1,199 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cfloat>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/matcher/assignment.h"
+
+using namespace but_objdet;
+using namespace std;
+
+
+/**
+ * A small problem as a dense matrix (the stored entries are marked by allowed).
+ */
+struct Problem
+{
+    int rows, cols;
+    vector<vector<float> > cost;
+    vector<vector<bool> > allowed;
+    float unassignedCost;
+};
+
+/* -----------------------------------------------------------------------------
+ * Random problem of at most 7 x 7 entries, about a half of them stored
+ */
+static Problem randomProblem()
+{
+    Problem p;
+    p.rows = rand() % 8;
+    p.cols = rand() % 8;
+    p.unassignedCost = (rand() % 3 == 0) ? 0 : (rand() % 100 - 50) / 10.0f;
+    p.cost.assign(p.rows, vector<float>(p.cols, 0));
+    p.allowed.assign(p.rows, vector<bool>(p.cols, false));
+    for(int i = 0; i < p.rows; i++) {
+        for(int j = 0; j < p.cols; j++) {
+            p.allowed[i][j] = (rand() % 2 == 0);
+            p.cost[i][j] = (rand() % 2000 - 1500) / 10.0f;
+        }
+    }
+    return p;
+}
+
+/* -----------------------------------------------------------------------------
+ * The sparse matrix of a problem
+ */
+static void toSparse(const Problem &p, SparseCostMatrix &costs)
+{
+    costs.reset(p.cols);
+    for(int i = 0; i < p.rows; i++) {
+        for(int j = 0; j < p.cols; j++) {
+            if(p.allowed[i][j]) {
+                costs.addEntry(j, p.cost[i][j]);
+            }
+        }
+        costs.endRow();
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * The minimal total cost by trying all the assignments of the rows
+ * from the given one
+ */
+static float exhaustive(const Problem &p, int row, vector<bool> &used)
+{
+    if(row == p.rows) {
+        return 0;
+    }
+    float best = p.unassignedCost + exhaustive(p, row + 1, used);
+    for(int j = 0; j < p.cols; j++) {
+        if(p.allowed[row][j] && !used[j]) {
+            used[j] = true;
+            best = min(best, p.cost[row][j] + exhaustive(p, row + 1, used));
+            used[j] = false;
+        }
+    }
+    return best;
+}
+
+/* -----------------------------------------------------------------------------
+ * Checks that an assignment is valid and optimal
+ */
+static void checkOptimal(const Problem &p, const vector<int> &rowToCol)
+{
+    ASSERT_EQ(p.rows, (int)rowToCol.size());
+    vector<bool> used(p.cols, false);
+    float total = 0;
+    for(int i = 0; i < p.rows; i++) {
+        int j = rowToCol[i];
+        if(j == -1) {
+            total += p.unassignedCost;
+            continue;
+        }
+        ASSERT_TRUE(j >= 0 && j < p.cols);
+        ASSERT_TRUE(p.allowed[i][j]);
+        ASSERT_FALSE(used[j]);
+        used[j] = true;
+        total += p.cost[i][j];
+    }
+    
+    vector<bool> none(p.cols, false);
+    ASSERT_NEAR(exhaustive(p, 0, none), total, 1e-2);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Solves without prices
+ */
+TEST(AssignmentSolver, OptimalOnSmallProblems)
+{
+    AssignmentSolver solver;
+    SparseCostMatrix costs;
+    vector<int> rowToCol;
+    srand(1);
+    
+    for(int i = 0; i < 3000; i++) {
+        Problem p = randomProblem();
+        toSparse(p, costs);
+        solver.solve(costs, p.unassignedCost, rowToCol);
+        checkOptimal(p, rowToCol);
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Solves from random prices (some of them positive, which are clamped)
+ * and from the prices of the previous problem (warm start)
+ */
+TEST(AssignmentSolver, OptimalFromPrices)
+{
+    AssignmentSolver solver;
+    SparseCostMatrix costs;
+    vector<int> rowToCol;
+    vector<float> prices;
+    srand(2);
+    
+    for(int i = 0; i < 3000; i++) {
+        Problem p = randomProblem();
+        toSparse(p, costs);
+        
+        prices.resize(p.cols);
+        for(int j = 0; j < p.cols; j++) {
+            prices[j] = (rand() % 1200 - 1000) / 10.0f;
+        }
+        solver.solve(costs, p.unassignedCost, rowToCol, prices);
+        checkOptimal(p, rowToCol);
+        ASSERT_EQ(p.cols, (int)prices.size());
+        
+        // A similar problem starting from the final prices
+        for(int r = 0; r < p.rows; r++) {
+            for(int j = 0; j < p.cols; j++) {
+                if(rand() % 4 == 0) {
+                    p.cost[r][j] += (rand() % 200 - 100) / 10.0f;
+                }
+            }
+        }
+        toSparse(p, costs);
+        solver.solve(costs, p.unassignedCost, rowToCol, prices);
+        checkOptimal(p, rowToCol);
+        
+        // Empty prices (zero)
+        prices.clear();
+        solver.solve(costs, p.unassignedCost, rowToCol, prices);
+        checkOptimal(p, rowToCol);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,142 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/matcher/depth_index.h"
+
+using namespace but_objdet;
+using namespace std;
+
+
+/* -----------------------------------------------------------------------------
+ * Random depth: unknown (not positive) or a multiple of 1/8 (so that some
+ * pairs are exactly at the tolerance)
+ */
+static float randomDepth()
+{
+    switch(rand() % 8) {
+        case 0: return 0;
+        case 1: return -(rand() % 8) / 8.0f;
+        default: return 1 + (rand() % 64) / 8.0f;
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Objects of a class passing with a detection found by a scan of all
+ * the objects
+ */
+static void linearQuery(const Objects &objects, int objClass, float z, float absTol, float relTol,
+                        vector<int> &found)
+{
+    found.clear();
+    for(unsigned int j = 0; j < objects.size(); j++) {
+        if(objects[j].m_class == objClass && DepthIndex::passes(z, objects[j].m_pos_2D.z, absTol, relTol)) {
+            found.push_back(j);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * The index against a linear scan: count, query and both ways of pruning
+ * (filtering the candidates and replacing them by the passing objects
+ * of the class)
+ */
+TEST(DepthIndex, RandomizedAgainstLinearScan)
+{
+    const float relTols[] = { 0, 0.05f, 0.125f };
+    int filtered = 0, replaced = 0;
+    
+    srand(1);
+    DepthIndex index;
+    for(int round = 0; round < 2000; round++) {
+        float absTol = (rand() % 9) / 8.0f;
+        float relTol = relTols[rand() % 3];
+        index.setTolerance(absTol, relTol);
+        
+        // The index is rebuilt (its buckets are reused)
+        Objects objects(rand() % 60);
+        for(unsigned int j = 0; j < objects.size(); j++) {
+            objects[j].m_class = rand() % 3;
+            objects[j].m_pos_2D.z = randomDepth();
+        }
+        index.build(objects);
+        
+        for(int q = 0; q < 10; q++) {
+            int objClass = rand() % 4; // Class 3 is not indexed
+            float z = randomDepth();
+            
+            vector<int> expected, found;
+            linearQuery(objects, objClass, z, absTol, relTol, expected);
+            index.query(objClass, z, found);
+            ASSERT_EQ(expected, found) << "round " << round << ", z " << z;
+            ASSERT_EQ((int)expected.size(), index.count(objClass, z));
+            
+            // Candidates of any class (a small or a large subset)
+            vector<int> candidates;
+            int percent = (rand() % 2) ? 10 : 90;
+            for(unsigned int j = 0; j < objects.size(); j++) {
+                if(rand() % 100 < percent) {
+                    candidates.push_back(j);
+                }
+            }
+            
+            // Replaced only if less objects of the class pass than
+            // the candidates (unknown depth of the detection => kept)
+            vector<int> pruned(candidates);
+            if(z > 0 && expected.size() < candidates.size()) {
+                replaced++;
+            }
+            else {
+                expected.clear();
+                for(unsigned int c = 0; c < candidates.size(); c++) {
+                    if(DepthIndex::passes(z, objects[candidates[c]].m_pos_2D.z, absTol, relTol)) {
+                        expected.push_back(candidates[c]);
+                    }
+                }
+                filtered++;
+            }
+            index.prune(objClass, z, pruned);
+            ASSERT_EQ(expected, pruned) << "round " << round << ", z " << z;
+        }
+    }
+    
+    EXPECT_GT(filtered, 1000);
+    EXPECT_GT(replaced, 1000);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,305 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cmath>
+#include <cstdlib>
+
+#include <gtest/gtest.h>
+#include <opencv2/video/tracking.hpp>
+
+#include "but_objdet/tracker/static_kalman.h"
+#include "but_objdet/tracker/tracker_kalman.h"
+
+using namespace but_objdet;
+using namespace std;
+
+// Relative tolerance of the comparison with the dense filter
+const float DENSE_TOLERANCE = 1e-3f;
+
+
+/* -----------------------------------------------------------------------------
+ * Compares two matrices within a relative tolerance
+ */
+static void expectNear(const cv::Mat &expected, const cv::Mat &actual, int n, float tolerance = 1e-4f)
+{
+    for(int i = 0; i < n; i++) {
+        float e = expected.at<float>(i), a = actual.at<float>(i);
+        ASSERT_NEAR(e, a, tolerance * (1 + fabs(e)));
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Runs both filters on the same random measurements
+ */
+template <int Order>
+static void compareFilters()
+{
+    typedef StaticKalman<4, Order> Filter;
+    srand(Order);
+    
+    for(int run = 0; run < 50; run++) {
+        cv::Mat measurement(1, 4, CV_32F);
+        for(int i = 0; i < 4; i++) {
+            measurement.at<float>(i) = rand() % 500;
+        }
+        
+        Filter fixed;
+        TrackerKalman general;
+        ASSERT_TRUE(fixed.init(measurement, Order == 2));
+        ASSERT_TRUE(general.init(measurement, Order == 2));
+        
+        for(int step = 0; step < 30; step++) {
+            int64 miliseconds = 20 + rand() % 80;
+            for(int i = 0; i < 4; i++) {
+                measurement.at<float>(i) += rand() % 11 - 5;
+            }
+            cv::Mat fixedState = fixed.update(measurement, miliseconds).clone();
+            cv::Mat generalState = general.update(measurement, miliseconds).clone();
+            expectNear(generalState, fixedState, Filter::STATE);
+            
+            miliseconds = rand() % 500;
+            cv::Mat fixedPred = fixed.predict(miliseconds).clone();
+            cv::Mat generalPred = general.predict(miliseconds).clone();
+            expectNear(generalPred, fixedPred, Filter::STATE);
+            
+            cv::Mat fixedCov, generalCov;
+            fixed.predictCovariance(miliseconds, fixedCov);
+            general.predictCovariance(miliseconds, generalCov);
+            expectNear(generalCov, fixedCov, 16);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Dense Kalman filter of the motion model (the model of TrackerKalman before
+ * the block computation): full transition matrix for the elapsed time and
+ * cv::KalmanFilter::predict/correct
+ */
+template <int Order>
+class DenseKalman
+{
+public:
+    enum { MEAS = 4, STATE = MEAS * (Order + 1) };
+
+    DenseKalman(const cv::Mat &measurement) : KF(STATE, MEAS)
+    {
+        KF.statePost.setTo(cv::Scalar(0));
+        for(int i = 0; i < MEAS; i++) {
+            KF.statePost.at<float>(i) = measurement.at<float>(i);
+        }
+        KF.measurementMatrix.setTo(cv::Scalar(0));
+        for(int i = 0; i < MEAS; i++) {
+            KF.measurementMatrix.at<float>(i, i) = 1;
+        }
+        setIdentity(KF.processNoiseCov, cv::Scalar::all(1e-4));
+        setIdentity(KF.measurementNoiseCov, cv::Scalar::all(1e-1));
+        setIdentity(KF.errorCovPost, cv::Scalar::all(.1));
+    }
+
+    const cv::Mat &update(const cv::Mat &measurement, int64 miliseconds)
+    {
+        setTime(miliseconds);
+        KF.predict();
+        return KF.correct(measurement.t());
+    }
+
+    cv::Mat predict(int64 miliseconds)
+    {
+        setTime(miliseconds);
+        return KF.transitionMatrix * KF.statePost;
+    }
+
+    cv::Mat predictCovariance(int64 miliseconds)
+    {
+        setTime(miliseconds);
+        cv::Mat errorCovPre = KF.transitionMatrix * KF.errorCovPost * KF.transitionMatrix.t() + KF.processNoiseCov;
+        return KF.measurementMatrix * errorCovPre * KF.measurementMatrix.t() + KF.measurementNoiseCov;
+    }
+
+    const cv::Mat &errorCov() const { return KF.errorCovPost; }
+
+private:
+    /**
+     * Transition matrix for the elapsed time (x' = x + v*dt + a*dt^2/2,
+     * v' = v + a*dt, a' = a for each parameter)
+     */
+    void setTime(int64 miliseconds)
+    {
+        float dt = miliseconds / 1000.0;
+        setIdentity(KF.transitionMatrix);
+        for(int i = 0; i < MEAS * Order; i++) {
+            KF.transitionMatrix.at<float>(i, i + MEAS) = dt;
+        }
+        if(Order == 2) {
+            for(int i = 0; i < MEAS; i++) {
+                KF.transitionMatrix.at<float>(i, i + 2 * MEAS) = 0.5f * dt * dt;
+            }
+        }
+    }
+
+    cv::KalmanFilter KF;
+};
+
+/* -----------------------------------------------------------------------------
+ * Runs the block filters and the dense one on the same random measurements
+ * (the dense products round differently, by up to about 1e-4 after 30 steps)
+ */
+template <int Order>
+static void compareWithDense()
+{
+    typedef StaticKalman<4, Order> Filter;
+    srand(10 + Order);
+    
+    for(int run = 0; run < 20; run++) {
+        cv::Mat measurement(1, 4, CV_32F);
+        for(int i = 0; i < 4; i++) {
+            measurement.at<float>(i) = rand() % 500;
+        }
+        
+        DenseKalman<Order> dense(measurement);
+        Filter fixed;
+        TrackerKalman general;
+        ASSERT_TRUE(fixed.init(measurement, Order == 2));
+        ASSERT_TRUE(general.init(measurement, Order == 2));
+        
+        cv::Mat fixedCov(Filter::STATE, Filter::STATE, CV_32F);
+        for(int step = 0; step < 30; step++) {
+            int64 miliseconds = 20 + rand() % 80;
+            for(int i = 0; i < 4; i++) {
+                measurement.at<float>(i) += rand() % 11 - 5;
+            }
+            cv::Mat denseState = dense.update(measurement, miliseconds).clone();
+            cv::Mat fixedState = fixed.update(measurement, miliseconds).clone();
+            cv::Mat generalState = general.update(measurement, miliseconds).clone();
+            expectNear(denseState, generalState, Filter::STATE, DENSE_TOLERANCE);
+            expectNear(denseState, fixedState, Filter::STATE, DENSE_TOLERANCE);
+            
+            fixed.errorCov(fixedCov.ptr<float>(0));
+            expectNear(dense.errorCov(), general.errorCov(), Filter::STATE * Filter::STATE, DENSE_TOLERANCE);
+            expectNear(dense.errorCov(), fixedCov, Filter::STATE * Filter::STATE, DENSE_TOLERANCE);
+            
+            miliseconds = rand() % 500;
+            cv::Mat densePred = dense.predict(miliseconds);
+            expectNear(densePred, general.predict(miliseconds), Filter::STATE, DENSE_TOLERANCE);
+            expectNear(densePred, fixed.predict(miliseconds), Filter::STATE, DENSE_TOLERANCE);
+            
+            cv::Mat denseCov = dense.predictCovariance(miliseconds), cov;
+            general.predictCovariance(miliseconds, cov);
+            expectNear(denseCov, cov, 16, DENSE_TOLERANCE);
+            fixed.predictCovariance(miliseconds, cov);
+            expectNear(denseCov, cov, 16, DENSE_TOLERANCE);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * The block computation gives the same results as the dense filter
+ */
+TEST(TrackerKalman, AgreesWithDenseFilterFirstOrder)
+{
+    compareWithDense<1>();
+}
+
+TEST(TrackerKalman, AgreesWithDenseFilterSecondOrder)
+{
+    compareWithDense<2>();
+}
+
+
+/* -----------------------------------------------------------------------------
+ * StaticKalman gives the same results as TrackerKalman
+ */
+TEST(StaticKalman, AgreesWithTrackerKalmanFirstOrder)
+{
+    compareFilters<1>();
+}
+
+TEST(StaticKalman, AgreesWithTrackerKalmanSecondOrder)
+{
+    compareFilters<2>();
+}
+
+TEST(StaticKalman, RejectsOtherModels)
+{
+    cv::Mat measurement(1, 4, CV_32F, cv::Scalar(1));
+    cv::Mat wrongSize(1, 3, CV_32F, cv::Scalar(1));
+    StaticKalman<4, 2> filter;
+    EXPECT_FALSE(filter.init(measurement, false));
+    EXPECT_FALSE(filter.init(wrongSize, true));
+    EXPECT_TRUE(filter.init(measurement, true));
+}
+
+
+/* -----------------------------------------------------------------------------
+ * A column measurement gives the same results as a row one (the noise
+ * of each parameter is in the covariance of the measurement)
+ */
+static void compareColumnWithRow(bool secDerivate)
+{
+    srand(secDerivate ? 2 : 1);
+    cv::Mat row(1, 4, CV_32F), column(4, 1, CV_32F);
+    for(int i = 0; i < 4; i++) {
+        row.at<float>(i) = column.at<float>(i) = rand() % 500;
+    }
+    
+    TrackerKalman byRow, byColumn;
+    ASSERT_TRUE(byRow.init(row, secDerivate));
+    ASSERT_TRUE(byColumn.init(column, secDerivate));
+    int states = secDerivate ? 12 : 8;
+    
+    for(int step = 0; step < 30; step++) {
+        int64 miliseconds = 20 + rand() % 80;
+        for(int i = 0; i < 4; i++) {
+            row.at<float>(i) = column.at<float>(i) += rand() % 11 - 5;
+        }
+        cv::Mat rowState = byRow.update(row, miliseconds).clone();
+        expectNear(rowState, byColumn.update(column, miliseconds), states, 0);
+        
+        cv::Mat rowCov, columnCov;
+        byRow.predictCovariance(miliseconds, rowCov);
+        byColumn.predictCovariance(miliseconds, columnCov);
+        expectNear(rowCov, columnCov, 16, 0);
+    }
+}
+
+TEST(TrackerKalman, ColumnMeasurementFirstOrder)
+{
+    compareColumnWithRow(false);
+}
+
+TEST(TrackerKalman, ColumnMeasurementSecondOrder)
+{
+    compareColumnWithRow(true);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,279 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/matcher/bit_mask.h"
+#include "but_objdet/matcher/matcher_mask.h"
+
+using namespace but_objdet;
+using namespace std;
+
+// Size of the image of the whole-image masks
+const int IMAGE_WIDTH = 640;
+const int IMAGE_HEIGHT = 480;
+
+
+/* -----------------------------------------------------------------------------
+ * Random mask of a given size (with the given share of object pixels
+ * in percent), the pixels outside the area are object pixels
+ * (the area is the whole mask by default)
+ */
+static cv::Mat randomMask(int rows, int cols, int fill, cv::Rect area = cv::Rect())
+{
+    if(area.area() == 0) {
+        area = cv::Rect(0, 0, cols, rows);
+    }
+    
+    cv::Mat mask(rows, cols, CV_8U);
+    for(int y = 0; y < rows; y++) {
+        for(int x = 0; x < cols; x++) {
+            bool inside = x >= area.x && y >= area.y && x < area.x + area.width && y < area.y + area.height;
+            mask.at<uchar>(y, x) = (!inside || rand() % 100 < fill) ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+/* -----------------------------------------------------------------------------
+ * Random object with a mask covering the whole image, anchored at the box
+ * (possibly smaller than the box) or without a mask. The boxes are not
+ * aligned to words and some of them start at negative coordinates.
+ */
+static Object randomObject(const cv::Rect &near)
+{
+    Object obj;
+    obj.m_class = 0;
+    obj.m_bb = cv::Rect(near.x + rand() % 41 - 20, near.y + rand() % 41 - 20,
+                        1 + rand() % 150, 1 + rand() % 60);
+    int fill = 20 + rand() % 80;
+    
+    switch(rand() % 4) {
+    case 0:
+        obj.m_bb.x = max(0, min(obj.m_bb.x, IMAGE_WIDTH - obj.m_bb.width));
+        obj.m_bb.y = max(0, min(obj.m_bb.y, IMAGE_HEIGHT - obj.m_bb.height));
+        obj.m_mask = randomMask(IMAGE_HEIGHT, IMAGE_WIDTH, fill, obj.m_bb);
+        break;
+    case 1:
+        obj.m_mask = randomMask(obj.m_bb.height, obj.m_bb.width, fill);
+        break;
+    case 2:
+        obj.m_mask = randomMask(1 + rand() % obj.m_bb.height, 1 + rand() % obj.m_bb.width, fill);
+        break;
+    default:
+        break;
+    }
+    return obj;
+}
+
+/* -----------------------------------------------------------------------------
+ * Random box near which the objects of a test are placed
+ */
+static cv::Rect randomArea()
+{
+    return cv::Rect(rand() % (IMAGE_WIDTH + 100) - 100, rand() % (IMAGE_HEIGHT + 40) - 40, 0, 0);
+}
+
+/* -----------------------------------------------------------------------------
+ * A pixel (in image coordinates) belongs to the object (see BitMask::pack)
+ */
+static bool isObjectPixel(const Object &obj, int x, int y)
+{
+    const cv::Rect &bb = obj.m_bb;
+    const cv::Mat &mask = obj.m_mask;
+    if(x < bb.x || y < bb.y || x >= bb.x + bb.width || y >= bb.y + bb.height) {
+        return false;
+    }
+    
+    bool wholeImage = (mask.cols == IMAGE_WIDTH && mask.rows == IMAGE_HEIGHT);
+    int mx = wholeImage ? x : x - bb.x;
+    int my = wholeImage ? y : y - bb.y;
+    if(mx >= mask.cols || my >= mask.rows) {
+        return false;
+    }
+    return mask.at<uchar>(my, mx) != 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Number of object pixels of both objects counted pixel by pixel
+ * (in the box of the first one, or of both of them)
+ */
+static int countPixels(const Object &a, const Object *b)
+{
+    int count = 0;
+    for(int y = a.m_bb.y; y < a.m_bb.y + a.m_bb.height; y++) {
+        for(int x = a.m_bb.x; x < a.m_bb.x + a.m_bb.width; x++) {
+            count += isObjectPixel(a, x, y) && (!b || isObjectPixel(*b, x, y));
+        }
+    }
+    return count;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * The packed masks have the same pixels as the masks (counted by popcount,
+ * by the POPCNT kernel if the CPU supports it)
+ */
+TEST(BitMask, IntersectionAgainstPixelCount)
+{
+    BitMask a, b;
+    srand(1);
+    
+    for(int i = 0; i < 3000; i++) {
+        cv::Rect area = randomArea();
+        Object objA = randomObject(area), objB = randomObject(area);
+        
+        ASSERT_EQ(!objA.m_mask.empty(), a.pack(objA));
+        ASSERT_EQ(!objB.m_mask.empty(), b.pack(objB));
+        if(objA.m_mask.empty() || objB.m_mask.empty()) {
+            continue;
+        }
+        
+        ASSERT_EQ(countPixels(objA, NULL), a.count());
+        ASSERT_EQ(countPixels(objB, NULL), b.count());
+        
+        int common = countPixels(objA, &objB);
+        ASSERT_EQ(common, a.intersection(b));
+        ASSERT_EQ(common, b.intersection(a));
+        ASSERT_EQ(a.count(), a.intersection(a));
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * IoU of the masks (or of the boxes if a mask is missing) is the same
+ * as the one counted pixel by pixel
+ */
+TEST(MatcherMask, IoUAgainstPixelCount)
+{
+    srand(2);
+    
+    for(int i = 0; i < 3000; i++) {
+        cv::Rect area = randomArea();
+        Object det = randomObject(area), pred = randomObject(area);
+        
+        float expected = 0;
+        if(!det.m_mask.empty() && !pred.m_mask.empty()) {
+            int common = countPixels(det, &pred);
+            int all = countPixels(det, NULL) + countPixels(pred, NULL) - common;
+            expected = (all > 0) ? (float)common * 100 / (float)all : 0;
+        }
+        else {
+            int common = (det.m_bb & pred.m_bb).area();
+            int all = det.m_bb.area() + pred.m_bb.area() - common;
+            expected = (common > 0) ? (float)common * 100 / (float)all : 0;
+        }
+        ASSERT_FLOAT_EQ(expected, MatcherMask::iou(det, pred));
+        ASSERT_FLOAT_EQ(expected, MatcherMask::iou(pred, det));
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * The maximal sum of IoUs of one-to-one matches by trying all the assignments
+ * of the detections from the given one
+ */
+static float exhaustive(const vector<vector<float> > &scores, int det, vector<bool> &used)
+{
+    if(det == (int)scores.size()) {
+        return 0;
+    }
+    float best = exhaustive(scores, det + 1, used);
+    for(unsigned int p = 0; p < used.size(); p++) {
+        if(scores[det][p] > 0 && !used[p]) {
+            used[p] = true;
+            best = max(best, scores[det][p] + exhaustive(scores, det + 1, used));
+            used[p] = false;
+        }
+    }
+    return best;
+}
+
+/* -----------------------------------------------------------------------------
+ * The matcher maximizes the sum of IoUs of the pairs of the same class
+ * reaching the minimal IoU
+ */
+TEST(MatcherMask, OptimalOnSmallScenes)
+{
+    const float minIoU = 20;
+    MatcherMask matcher(minIoU);
+    srand(3);
+    
+    for(int i = 0; i < 300; i++) {
+        cv::Rect area = randomArea();
+        Objects detections, predictions;
+        for(int n = rand() % 6; n > 0; n--) {
+            detections.push_back(randomObject(area));
+            detections.back().m_class = rand() % 2;
+        }
+        for(int n = rand() % 6; n > 0; n--) {
+            predictions.push_back(randomObject(area));
+            predictions.back().m_class = rand() % 2;
+        }
+        
+        vector<vector<float> > scores(detections.size(), vector<float>(predictions.size(), 0));
+        for(unsigned int d = 0; d < detections.size(); d++) {
+            for(unsigned int p = 0; p < predictions.size(); p++) {
+                float iou = MatcherMask::iou(detections[d], predictions[p]);
+                if(detections[d].m_class == predictions[p].m_class && iou >= minIoU) {
+                    scores[d][p] = iou;
+                }
+            }
+        }
+        
+        Matches matches;
+        matcher.match(detections, predictions, matches);
+        ASSERT_EQ(detections.size(), matches.size());
+        
+        vector<bool> used(predictions.size(), false);
+        float total = 0;
+        for(unsigned int d = 0; d < matches.size(); d++) {
+            ASSERT_EQ((int)d, matches[d].detId);
+            int p = matches[d].predId;
+            if(p == -1) {
+                continue;
+            }
+            ASSERT_TRUE(p >= 0 && p < (int)predictions.size());
+            ASSERT_GT(scores[d][p], 0);
+            ASSERT_FALSE(used[p]);
+            used[p] = true;
+            total += scores[d][p];
+        }
+        
+        vector<bool> none(predictions.size(), false);
+        ASSERT_NEAR(exhaustive(scores, 0, none), total, 1e-2);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,382 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/matcher/spatial_grid.h"
+#include "but_objdet/matcher/basic_matcher.h"
+#include "but_objdet/matcher/matcher_overlap.h"
+#include "but_objdet/matcher/matcher_hungarian.h"
+#include "but_objdet/matcher/matcher_parallel.h"
+
+using namespace but_objdet;
+using namespace std;
+
+
+/* -----------------------------------------------------------------------------
+ * Random bounding box (some of them degenerate or large)
+ */
+static cv::Rect randomBox()
+{
+    int size = (rand() % 10 == 0) ? 300 : 80;
+    return cv::Rect(rand() % 700 - 50, rand() % 500 - 50, rand() % size - 3, rand() % size - 3);
+}
+
+/* -----------------------------------------------------------------------------
+ * Random object of one of three classes
+ */
+static Object randomObject()
+{
+    Object obj;
+    obj.m_class = rand() % 3;
+    obj.m_bb = randomBox();
+    return obj;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Object of class 0 with the bounding box
+ */
+static Object object(const cv::Rect &bb)
+{
+    Object obj;
+    obj.m_class = 0;
+    obj.m_bb = bb;
+    return obj;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * The candidates of a query contain every rectangle intersecting it
+ */
+TEST(SpatialGrid, RandomizedAgainstBruteForce)
+{
+    SpatialGrid grid;
+    vector<cv::Rect> rects;
+    vector<int> candidates;
+    srand(1);
+    
+    for(int i = 0; i < 500; i++) {
+        rects.clear();
+        for(int n = rand() % 100; n > 0; n--) {
+            rects.push_back(randomBox());
+        }
+        grid.build(rects);
+        ASSERT_EQ((int)rects.size(), grid.size());
+        
+        for(int q = 0; q < 20; q++) {
+            cv::Rect query = randomBox();
+            grid.query(query, candidates);
+            
+            for(unsigned int c = 1; c < candidates.size(); c++) {
+                ASSERT_LT(candidates[c - 1], candidates[c]); // Sorted, no duplicates
+            }
+            for(unsigned int j = 0; j < rects.size(); j++) {
+                if((query & rects[j]).area() > 0) {
+                    ASSERT_TRUE(binary_search(candidates.begin(), candidates.end(), (int)j));
+                }
+            }
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Overlapping percentage of two boxes computed in float, as MatcherOverlap
+ * computed it before the grid and the batched kernel (degenerate boxes never
+ * overlap, as in BoxOverlap; the original code divided by their areas)
+ */
+static float floatOverlap(const cv::Rect &det, const cv::Rect &pred, float minOverlap)
+{
+    if(det.width <= 0 || det.height <= 0 || pred.width <= 0 || pred.height <= 0) {
+        return 0;
+    }
+    
+    int detLeftX = det.x, detRightX = det.x + det.width;
+    int detTopY = det.y, detBottomY = det.y + det.height;
+    int predLeftX = pred.x, predRightX = pred.x + pred.width;
+    int predTopY = pred.y, predBottomY = pred.y + pred.height;
+    float detArea = det.width * det.height;
+    float predArea = pred.width * pred.height;
+    
+    float overlapped = 0;
+    if(detRightX > predLeftX && detLeftX < predRightX &&
+       detBottomY > predTopY && detTopY < predBottomY) {
+        float overlapArea = (min(detRightX, predRightX) - max(detLeftX, predLeftX)) *
+                            (min(detBottomY, predBottomY) - max(detTopY, predTopY));
+        float detOverlapped = (overlapArea * 100) / detArea;
+        float predOverlapped = (overlapArea * 100) / predArea;
+        if(detOverlapped >= minOverlap && predOverlapped >= minOverlap) {
+            overlapped = min(detOverlapped, predOverlapped);
+        }
+    }
+    return overlapped;
+}
+
+/* -----------------------------------------------------------------------------
+ * Random detections and predictions (fewer than maxObjects of each)
+ * @param close  Add a detection close to each prediction (so there are matches).
+ */
+static void randomScene(int maxObjects, bool close, Objects &detections, Objects &predictions)
+{
+    detections.clear();
+    predictions.clear();
+    for(int n = rand() % maxObjects; n > 0; n--) {
+        detections.push_back(randomObject());
+    }
+    for(int n = rand() % maxObjects; n > 0; n--) {
+        predictions.push_back(randomObject());
+    }
+    
+    if(close) {
+        for(unsigned int j = 0; j < predictions.size(); j++) {
+            Object obj = predictions[j];
+            obj.m_bb.x += rand() % 5;
+            obj.m_bb.y += rand() % 5;
+            detections.push_back(obj);
+        }
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Runs the matcher and a float scan of all predictions on random objects
+ * (the overlaps of all pairs are compared too)
+ */
+static void compareWithScan(float minOverlap)
+{
+    MatcherOverlap matcher(minOverlap);
+    srand(2);
+    
+    for(int i = 0; i < 2000; i++) {
+        Objects detections, predictions;
+        randomScene(60, i % 2 == 0, detections, predictions);
+        
+        Matches matches;
+        matcher.match(detections, predictions, matches);
+        ASSERT_EQ(detections.size(), matches.size());
+        
+        for(unsigned int d = 0; d < detections.size(); d++) {
+            float best = 0;
+            int bestId = -1;
+            for(unsigned int p = 0; p < predictions.size(); p++) {
+                if(detections[d].m_class != predictions[p].m_class) {
+                    continue;
+                }
+                float overlapped = floatOverlap(detections[d].m_bb, predictions[p].m_bb, minOverlap);
+                ASSERT_EQ(overlapped, MatcherOverlap::overlap(detections[d].m_bb, predictions[p].m_bb, minOverlap));
+                if(overlapped > best) {
+                    best = overlapped;
+                    bestId = p;
+                }
+            }
+            ASSERT_EQ((int)d, matches[d].detId);
+            ASSERT_EQ(bestId, matches[d].predId);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * The matcher chooses the same predictions as a float scan of all of them,
+ * also for thresholds which are not whole tenths of percent
+ */
+TEST(MatcherOverlap, RandomizedAgainstBruteForce)
+{
+    compareWithScan(30);
+    compareWithScan(12.5f);
+    compareWithScan(33.33f);
+    compareWithScan(66.67f);
+    for(int i = 0; i < 5; i++) {
+        compareWithScan((rand() % 100000) / 1000.0f);
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * A pair passes a threshold equal to its overlap and fails the next larger
+ * float (e.g. 33.32% of 17 x 98 of 50 x 100 passes 33.32 and fails 33.33)
+ */
+TEST(MatcherOverlap, ExactAtThreshold)
+{
+    cv::Rect det(0, 0, 50, 100), pred(33, 2, 50, 100);
+    EXPECT_FLOAT_EQ(33.32f, MatcherOverlap::overlap(det, pred, 33.32f));
+    EXPECT_EQ(0, MatcherOverlap::overlap(det, pred, 33.33f));
+    srand(3);
+    
+    for(int i = 0; i < 100000; i++) {
+        cv::Rect det = randomBox(), pred = det;
+        pred.x += rand() % 20 - 10;
+        pred.y += rand() % 20 - 10;
+        pred.width += rand() % 20 - 10;
+        pred.height += rand() % 20 - 10;
+        
+        float overlapped = floatOverlap(det, pred, 0);
+        if(overlapped <= 0) {
+            continue;
+        }
+        float above = nextafterf(overlapped, 200);
+        ASSERT_EQ(overlapped, MatcherOverlap::overlap(det, pred, overlapped));
+        ASSERT_EQ(0, MatcherOverlap::overlap(det, pred, above));
+        ASSERT_EQ(overlapped, OverlapMetric(overlapped).score(object(det), object(pred)));
+        ASSERT_EQ(0, OverlapMetric(above).score(object(det), object(pred)));
+        
+        // The batched kernel (9 copies, so the vectorized version runs too)
+        BoxArray preds;
+        for(int k = 0; k < 9; k++) {
+            preds.push_back(pred);
+        }
+        float out[9];
+        BoxOverlap::row(det, preds, NULL, 9, overlapped, out);
+        for(int k = 0; k < 9; k++) {
+            ASSERT_EQ(overlapped, out[k]);
+        }
+        BoxOverlap::row(det, preds, NULL, 9, above, out);
+        for(int k = 0; k < 9; k++) {
+            ASSERT_EQ(0, out[k]);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Checks that the matches are one-to-one pairs of the same class overlapping
+ * by at least minOverlap% and sums their overlaps
+ */
+static void checkOneToOne(const Objects &detections, const Objects &predictions, const Matches &matches,
+                          float minOverlap, double &total)
+{
+    ASSERT_EQ(detections.size(), matches.size());
+    vector<bool> used(predictions.size(), false);
+    total = 0;
+    for(unsigned int d = 0; d < matches.size(); d++) {
+        ASSERT_EQ((int)d, matches[d].detId);
+        int p = matches[d].predId;
+        if(p == -1) {
+            continue;
+        }
+        ASSERT_TRUE(p >= 0 && p < (int)predictions.size());
+        ASSERT_FALSE(used[p]);
+        used[p] = true;
+        ASSERT_EQ(detections[d].m_class, predictions[p].m_class);
+        float overlapped = MatcherOverlap::overlap(detections[d].m_bb, predictions[p].m_bb, minOverlap);
+        ASSERT_GT(overlapped, 0);
+        total += overlapped;
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * The components solved by the pool threads give the same total overlap
+ * as the whole problem solved at once (the scenes of up to 400 objects
+ * have more than 64 detections in the components, MIN_PARALLEL_ROWS
+ * of MatcherParallel, so they are solved by the threads)
+ */
+TEST(MatcherParallel, SameTotalOverlapAsHungarian)
+{
+    MatcherHungarian hungarian(30);
+    MatcherParallel parallel(30, 4);
+    MatcherOverlap overlap(30);
+    int threaded = 0;
+    srand(3);
+    
+    for(int i = 0; i < 600; i++) {
+        bool large = (i % 3 == 0);
+        Objects detections, predictions;
+        randomScene(large ? 400 : 60, large || i % 2 == 0, detections, predictions);
+        
+        Matches expected, matches;
+        hungarian.match(detections, predictions, expected);
+        parallel.match(detections, predictions, matches);
+        
+        double expectedTotal, total;
+        checkOneToOne(detections, predictions, expected, 30, expectedTotal);
+        checkOneToOne(detections, predictions, matches, 30, total);
+        ASSERT_NEAR(expectedTotal, total, 1e-2);
+        
+        // Detections in the components are the ones with some candidate
+        overlap.match(detections, predictions, matches);
+        int rows = 0;
+        for(unsigned int d = 0; d < matches.size(); d++) {
+            rows += (matches[d].predId != -1);
+        }
+        threaded += (rows >= 64);
+    }
+    EXPECT_GT(threaded, 100);
+}
+
+
+
+/* -----------------------------------------------------------------------------
+ * Runs a matcher and a BasicMatcher on the same random objects
+ * and compares the matches
+ */
+template <class Assigner>
+static void compareWithBasic(Matcher &matcher, unsigned int seed)
+{
+    BasicMatcher<OverlapMetric, ClassGate, Assigner> basic(OverlapMetric(30));
+    srand(seed);
+    
+    for(int i = 0; i < 1000; i++) {
+        Objects detections, predictions;
+        randomScene(60, i % 2 == 0, detections, predictions);
+        
+        Matches expected, matches;
+        matcher.match(detections, predictions, expected);
+        basic.match(detections, predictions, matches);
+        
+        ASSERT_EQ(expected.size(), matches.size());
+        for(unsigned int d = 0; d < matches.size(); d++) {
+            ASSERT_EQ(expected[d].detId, matches[d].detId);
+            ASSERT_EQ(expected[d].predId, matches[d].predId);
+        }
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * BasicMatcher composed of the overlap policies gives the same matches
+ * as the matchers it replaces
+ */
+TEST(BasicMatcher, GreedySameAsMatcherOverlap)
+{
+    MatcherOverlap matcher(30);
+    compareWithBasic<GreedyAssigner>(matcher, 4);
+}
+
+TEST(BasicMatcher, OptimalSameAsMatcherHungarian)
+{
+    MatcherHungarian matcher(30);
+    compareWithBasic<OptimalAssigner>(matcher, 5);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/tracker/track_store.h"
+#include "but_objdet/tracker/kalman_bank.h"
+
+using namespace but_objdet;
+using namespace std;
+
+
+/* -----------------------------------------------------------------------------
+ * A store keeps its arrays when the tracks are replaced by new ones
+ */
+TEST(TrackStore, AllocationsFlatUnderChurn)
+{
+    const int maxTracks = 200;
+    TrackStore<vector<float> > store;
+    srand(1);
+
+    // Grow the store to the maximal number of tracks
+    for(int id = 0; id < maxTracks; id++) {
+        store.insert(id % 5, id);
+    }
+    int allocations = store.allocations();
+    EXPECT_GT(allocations, 0);
+
+    // Erase random tracks and insert new ones (with new ids)
+    int nextId = maxTracks;
+    for(int i = 0; i < 100000; i++) {
+        if(store.size() > 0 && (store.size() == maxTracks || rand() % 2)) {
+            int pos = rand() % store.size();
+            ASSERT_TRUE(store.erase(store.classAt(pos), store.idAt(pos)));
+        }
+        else {
+            bool inserted = false;
+            store.insert(nextId % 5, nextId, &inserted);
+            ASSERT_TRUE(inserted);
+            nextId++;
+        }
+        ASSERT_LE(store.size(), maxTracks);
+    }
+    EXPECT_EQ(allocations, store.allocations());
+
+    // One more track than ever before grows the store again eventually
+    store.clear();
+    for(int id = 0; id < 4 * maxTracks; id++) {
+        store.insert(0, id);
+    }
+    EXPECT_GT(store.allocations(), allocations);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * A bank reuses the slots of removed filters
+ */
+TEST(KalmanBank, AllocationsFlatUnderChurn)
+{
+    const int maxFilters = 300;
+    KalmanBank bank;
+    vector<int> slots;
+    float measurement[KalmanBank::MEAS] = { 10, 20, 30, 40 };
+    srand(2);
+
+    for(int i = 0; i < maxFilters; i++) {
+        slots.push_back(bank.add(measurement));
+    }
+    int allocations = bank.allocations();
+
+    for(int i = 0; i < 100000; i++) {
+        if(!slots.empty() && ((int)slots.size() == maxFilters || rand() % 2)) {
+            int k = rand() % slots.size();
+            bank.remove(slots[k]);
+            slots[k] = slots.back();
+            slots.pop_back();
+        }
+        else {
+            slots.push_back(bank.add(measurement));
+        }
+    }
+    EXPECT_EQ(allocations, bank.allocations());
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,282 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/matcher/rotated_overlap.h"
+
+using namespace but_objdet;
+using namespace std;
+
+// Tolerance of points on the boundary of a box (in pixels)
+const double BOUNDARY_EPS = 1e-9;
+
+
+/**
+ * A point in double precision.
+ */
+struct Point
+{
+    double x, y;
+    Point(double px=0, double py=0) : x(px), y(py) {}
+};
+
+/* -----------------------------------------------------------------------------
+ * Corners of the rotated box of an object (as cv::RotatedRect, in double)
+ */
+static void boxCorners(const Object &obj, Point *pts)
+{
+    double a = obj.m_angle * CV_PI / 180;
+    double c = cos(a), s = sin(a);
+    double cx = obj.m_bb.x + obj.m_bb.width * 0.5, cy = obj.m_bb.y + obj.m_bb.height * 0.5;
+    double hw = obj.m_bb.width * 0.5, hh = obj.m_bb.height * 0.5;
+    static const double dx[4] = {-1, 1, 1, -1};
+    static const double dy[4] = {-1, -1, 1, 1};
+    for(int k = 0; k < 4; k++) {
+        pts[k] = Point(cx + c * dx[k] * hw - s * dy[k] * hh, cy + s * dx[k] * hw + c * dy[k] * hh);
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * The point is inside the rotated box of an object (or on its boundary)
+ */
+static bool insideBox(const Object &obj, const Point &p)
+{
+    double a = obj.m_angle * CV_PI / 180;
+    double c = cos(a), s = sin(a);
+    double ox = p.x - (obj.m_bb.x + obj.m_bb.width * 0.5);
+    double oy = p.y - (obj.m_bb.y + obj.m_bb.height * 0.5);
+    return fabs(c * ox + s * oy) <= obj.m_bb.width * 0.5 + BOUNDARY_EPS &&
+           fabs(-s * ox + c * oy) <= obj.m_bb.height * 0.5 + BOUNDARY_EPS;
+}
+
+/* -----------------------------------------------------------------------------
+ * Angle of a point around a center (for sorting the vertices)
+ */
+struct ByAngle
+{
+    Point center;
+    ByAngle(const Point &c) : center(c) {}
+    bool operator()(const Point &a, const Point &b) const
+    {
+        return atan2(a.y - center.y, a.x - center.x) < atan2(b.y - center.y, b.x - center.x);
+    }
+};
+
+/* -----------------------------------------------------------------------------
+ * Area of the intersection of the rotated boxes of two objects: the convex
+ * hull of the corners of each box inside the other one and of the crossings
+ * of the edges (as cv::rotatedRectangleIntersection, in double)
+ */
+static double referenceIntersection(const Object &a, const Object &b)
+{
+    if(a.m_bb.width <= 0 || a.m_bb.height <= 0 || b.m_bb.width <= 0 || b.m_bb.height <= 0) {
+        return 0;
+    }
+    
+    Point pa[4], pb[4];
+    boxCorners(a, pa);
+    boxCorners(b, pb);
+    
+    vector<Point> vertices;
+    for(int k = 0; k < 4; k++) {
+        if(insideBox(b, pa[k])) vertices.push_back(pa[k]);
+        if(insideBox(a, pb[k])) vertices.push_back(pb[k]);
+    }
+    for(int k = 0; k < 4; k++) {
+        const Point &p0 = pa[k], &p1 = pa[(k + 1) % 4];
+        for(int l = 0; l < 4; l++) {
+            const Point &q0 = pb[l], &q1 = pb[(l + 1) % 4];
+            double rx = p1.x - p0.x, ry = p1.y - p0.y;
+            double sx = q1.x - q0.x, sy = q1.y - q0.y;
+            double denom = rx * sy - ry * sx;
+            if(fabs(denom) < 1e-12) continue; // Parallel edges
+            double t = ((q0.x - p0.x) * sy - (q0.y - p0.y) * sx) / denom;
+            double u = ((q0.x - p0.x) * ry - (q0.y - p0.y) * rx) / denom;
+            if(t >= 0 && t <= 1 && u >= 0 && u <= 1) {
+                vertices.push_back(Point(p0.x + t * rx, p0.y + t * ry));
+            }
+        }
+    }
+    if(vertices.size() < 3) {
+        return 0;
+    }
+    
+    Point center;
+    for(unsigned int k = 0; k < vertices.size(); k++) {
+        center.x += vertices[k].x / vertices.size();
+        center.y += vertices[k].y / vertices.size();
+    }
+    sort(vertices.begin(), vertices.end(), ByAngle(center));
+    
+    double sum = 0;
+    for(unsigned int k = 0; k < vertices.size(); k++) {
+        const Point &u = vertices[k], &v = vertices[(k + 1) % vertices.size()];
+        sum += u.x * v.y - v.x * u.y;
+    }
+    return fabs(sum) * 0.5;
+}
+
+/* -----------------------------------------------------------------------------
+ * Random angle (often a multiple of 90 degrees)
+ */
+static float randomAngle()
+{
+    if(rand() % 3 == 0) {
+        return 90 * (rand() % 5 - 2);
+    }
+    return (rand() % 72000 - 36000) / 100.0f;
+}
+
+/* -----------------------------------------------------------------------------
+ * Random object near a point (some of them nested in the previous one,
+ * equal to it or degenerate)
+ */
+static Object randomObject(int x, int y, const Object *previous)
+{
+    Object obj;
+    obj.m_class = 0;
+    obj.m_angle = randomAngle();
+    
+    int kind = rand() % 10;
+    if(previous && kind == 0) {
+        obj = *previous;
+    }
+    else if(previous && kind <= 2) {
+        // Nested in the previous one (centered, at most half of its size)
+        const cv::Rect &bb = previous->m_bb;
+        int w = max(1, bb.width / (2 + rand() % 3)), h = max(1, bb.height / (2 + rand() % 3));
+        obj.m_bb = cv::Rect(bb.x + (bb.width - w) / 2, bb.y + (bb.height - h) / 2, w, h);
+        if(rand() % 2) {
+            obj.m_angle = previous->m_angle;
+        }
+    }
+    else {
+        obj.m_bb = cv::Rect(x + rand() % 41 - 20, y + rand() % 41 - 20, rand() % 80 - 2, rand() % 80 - 2);
+    }
+    return obj;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * The intersection of rotated boxes is the same as the exact one
+ */
+TEST(RotatedOverlap, IntersectionAgainstReference)
+{
+    RotatedBoxArray boxes;
+    srand(1);
+    
+    for(int i = 0; i < 20000; i++) {
+        int x = rand() % 500, y = rand() % 400;
+        Object a = randomObject(x, y, NULL);
+        Object b = randomObject(x, y, &a);
+        boxes.clear();
+        boxes.push_back(a.m_bb, a.m_angle);
+        boxes.push_back(b.m_bb, b.m_angle);
+        
+        double expected = referenceIntersection(a, b);
+        double tolerance = 1e-4 * (1 + max(0, max(a.m_bb.area(), b.m_bb.area())));
+        ASSERT_NEAR(expected, RotatedOverlap::intersection(boxes, 0, boxes, 1), tolerance)
+            << "angles " << a.m_angle << ", " << b.m_angle;
+        ASSERT_NEAR(expected, RotatedOverlap::intersection(boxes, 1, boxes, 0), tolerance)
+            << "angles " << a.m_angle << ", " << b.m_angle;
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * The overlaps computed by pair, row and matrix are the same and equal to
+ * the ones computed from the intersection (the prefilter rejects only the
+ * pairs which can not reach the minimal overlap)
+ */
+TEST(RotatedOverlap, RowAndMatrixSameAsPair)
+{
+    RotatedBoxArray dets, preds;
+    vector<float> out;
+    vector<int> idx;
+    cv::Mat all;
+    srand(2);
+    
+    for(int i = 0; i < 300; i++) {
+        float minOverlap = (rand() % 3 == 0) ? 0 : (rand() % 9000) / 100.0f;
+        int x = rand() % 500, y = rand() % 400;
+        
+        Objects detections, predictions;
+        for(int n = rand() % 20; n > 0; n--) {
+            detections.push_back(randomObject(x, y, detections.empty() ? NULL : &detections.back()));
+        }
+        for(int n = rand() % 20; n > 0; n--) {
+            const Object *previous = NULL;
+            if(!detections.empty() && rand() % 2) {
+                previous = &detections[rand() % detections.size()];
+            }
+            predictions.push_back(randomObject(x, y, previous));
+        }
+        dets.assign(detections);
+        preds.assign(predictions);
+        
+        RotatedOverlap::matrix(dets, preds, minOverlap, all);
+        
+        // Every other prediction in the reverse order
+        idx.clear();
+        for(int j = predictions.size() - 1; j >= 0; j -= 2) {
+            idx.push_back(j);
+        }
+        
+        out.resize(predictions.size());
+        for(unsigned int d = 0; d < detections.size(); d++) {
+            if(!idx.empty()) {
+                RotatedOverlap::row(dets, d, preds, &idx[0], idx.size(), minOverlap, &out[0]);
+            }
+            for(unsigned int k = 0; k < idx.size(); k++) {
+                ASSERT_EQ(all.at<float>(d, idx[k]), out[k]);
+            }
+            
+            for(unsigned int p = 0; p < predictions.size(); p++) {
+                float common = RotatedOverlap::intersection(dets, d, preds, p);
+                float expected = 0;
+                if(common > 0 && common * 100 >= minOverlap * dets.area[d] &&
+                   common * 100 >= minOverlap * preds.area[p]) {
+                    expected = common * 100 / max(dets.area[d], preds.area[p]);
+                }
+                ASSERT_EQ(expected, RotatedOverlap::pair(detections[d], predictions[p], minOverlap));
+                ASSERT_EQ(expected, all.at<float>(d, p));
+            }
+        }
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,259 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/matcher/box_overlap.h"
+#include "but_objdet/matcher/bit_mask.h"
+#include "but_objdet/tracker/kalman_bank.h"
+#include "but_objdet/tracker/tracker_kalman.h"
+
+using namespace but_objdet;
+using namespace std;
+
+// The batched kernels compute 8 items at once when built with AVX2
+// (BUT_OBJDET_AVX2) and run on a CPU supporting it, and the rest by the scalar
+// code, so a batch is compared with the same items computed one by one
+// (i.e. by the scalar code)
+
+
+/* -----------------------------------------------------------------------------
+ * Random box (some of them degenerate)
+ */
+static cv::Rect randomBox()
+{
+    return cv::Rect(rand() % 200, rand() % 200, rand() % 80 - 5, rand() % 80 - 5);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Overlaps of a row of boxes
+ */
+TEST(Simd, BoxOverlapRowMatchesScalar)
+{
+    srand(1);
+    for(int i = 0; i < 1000; i++) {
+        BoxArray preds;
+        int n = rand() % 40;
+        for(int j = 0; j < n; j++) {
+            preds.push_back(randomBox());
+        }
+        vector<int> idx(n);
+        for(int j = 0; j < n; j++) {
+            idx[j] = rand() % n;
+        }
+        cv::Rect det = randomBox();
+        float minOverlap = rand() % 60;
+        
+        vector<float> batch(n + 1), batchIdx(n + 1);
+        BoxOverlap::row(det, preds, NULL, n, minOverlap, &batch[0]);
+        BoxOverlap::row(det, preds, n ? &idx[0] : NULL, n, minOverlap, &batchIdx[0]);
+        for(int j = 0; j < n; j++) {
+            float single;
+            BoxOverlap::row(det, preds, &j, 1, minOverlap, &single);
+            ASSERT_EQ(single, batch[j]);
+            BoxOverlap::row(det, preds, &idx[j], 1, minOverlap, &single);
+            ASSERT_EQ(single, batchIdx[j]);
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Popcount (the builtin, which is the POPCNT instruction in the kernels
+ * built for it)
+ */
+TEST(Simd, PopcountMatchesLoop)
+{
+    srand(2);
+    for(int i = 0; i < 10000; i++) {
+        uint64 x = ((uint64)rand() << 40) ^ ((uint64)rand() << 20) ^ (uint64)rand();
+        int bits = 0;
+        for(uint64 y = x; y != 0; y >>= 1) {
+            bits += (int)(y & 1);
+        }
+        ASSERT_EQ(bits, BitMask::popcount(x));
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Updates and predictions of a bank of filters
+ */
+TEST(Simd, KalmanBankMatchesScalar)
+{
+    const int n = 37;
+    KalmanBank batch, single;
+    vector<int> slots(n);
+    srand(3);
+    for(int k = 0; k < n; k++) {
+        float measurement[KalmanBank::MEAS];
+        for(int p = 0; p < KalmanBank::MEAS; p++) {
+            measurement[p] = rand() % 500;
+        }
+        batch.add(measurement);
+        single.add(measurement);
+        slots[k] = n - 1 - k; // Not in the order of the slots
+    }
+    
+    vector<float> dt(n), measurements(KalmanBank::MEAS * n);
+    vector<float> boxes(KalmanBank::MEAS * n), variances(KalmanBank::MEAS * n);
+    for(int step = 0; step < 50; step++) {
+        for(int k = 0; k < n; k++) {
+            dt[k] = (rand() % 100) / 1000.0f;
+            for(int p = 0; p < KalmanBank::MEAS; p++) {
+                measurements[p * n + k] = rand() % 500;
+            }
+        }
+        
+        batch.update(&slots[0], &dt[0], n, &measurements[0]);
+        for(int k = 0; k < n; k++) {
+            float measurement[KalmanBank::MEAS];
+            for(int p = 0; p < KalmanBank::MEAS; p++) {
+                measurement[p] = measurements[p * n + k];
+            }
+            single.update(&slots[k], &dt[k], 1, measurement);
+        }
+        
+        for(int k = 0; k < n; k++) {
+            float a[KalmanBank::VALUES], b[KalmanBank::VALUES];
+            batch.save(slots[k], a);
+            single.save(slots[k], b);
+            for(int v = 0; v < KalmanBank::VALUES; v++) {
+                ASSERT_NEAR(b[v], a[v], 1e-5f * (1 + fabs(b[v])));
+            }
+        }
+        
+        batch.predict(&slots[0], &dt[0], n, &boxes[0], &variances[0]);
+        for(int k = 0; k < n; k++) {
+            float box[KalmanBank::MEAS], variance[KalmanBank::MEAS];
+            batch.predict(&slots[k], &dt[k], 1, box, variance);
+            for(int p = 0; p < KalmanBank::MEAS; p++) {
+                ASSERT_NEAR(box[p], boxes[p * n + k], 1e-5f * (1 + fabs(box[p])));
+                ASSERT_NEAR(variance[p], variances[p * n + k], 1e-5f * (1 + fabs(variance[p])));
+            }
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Filters of a bank give the same results as TrackerKalman (the bank is used
+ * by the tracker node instead of TrackerKalman objects)
+ */
+TEST(Simd, KalmanBankMatchesTrackerKalman)
+{
+    const int n = 13, m = 5;
+    const int MEAS = KalmanBank::MEAS;
+    KalmanBank bank;
+    vector<TrackerKalman> trackers(n);
+    vector<cv::Mat> states(n);
+    vector<int> slots(n);
+    vector<float> dt(n), measurements(MEAS * n);
+    srand(4);
+    for(int k = 0; k < n; k++) {
+        cv::Mat measurement(1, MEAS, CV_32F);
+        for(int p = 0; p < MEAS; p++) {
+            measurement.at<float>(p) = measurements[p * n + k] = rand() % 500;
+        }
+        ASSERT_TRUE(trackers[k].init(measurement, true));
+        slots[k] = bank.add(measurement.ptr<float>(0));
+    }
+    
+
+    vector<float> boxes(MEAS * n), variances(MEAS * n);
+    vector<float> times(n * m), trajectories(n * m * MEAS), trajectoryVariances(n * m * MEAS);
+    vector<int64> miliseconds(n * m);
+    for(int step = 0; step < 30; step++) {
+        // Update
+        for(int k = 0; k < n; k++) {
+            int64 ms = 20 + rand() % 80;
+            cv::Mat measurement(1, MEAS, CV_32F);
+            for(int p = 0; p < MEAS; p++) {
+                measurements[p * n + k] += rand() % 11 - 5;
+                measurement.at<float>(p) = measurements[p * n + k];
+            }
+            dt[k] = ms / 1000.0;
+            states[k] = trackers[k].update(measurement, ms).clone();
+        }
+        bank.update(&slots[0], &dt[0], n, &measurements[0]);
+        
+        for(int k = 0; k < n; k++) {
+            float filter[KalmanBank::VALUES];
+            bank.save(slots[k], filter);
+            for(int v = 0; v < KalmanBank::STATE; v++) {
+                float state = states[k].at<float>(v);
+                ASSERT_NEAR(state, filter[v], 1e-4f * (1 + fabs(state)));
+            }
+        }
+        
+        // Prediction
+        for(int k = 0; k < n; k++) {
+            miliseconds[k] = rand() % 500;
+            dt[k] = miliseconds[k] / 1000.0;
+        }
+        bank.predict(&slots[0], &dt[0], n, &boxes[0], &variances[0]);
+        for(int k = 0; k < n; k++) {
+            cv::Mat pred = trackers[k].predict(miliseconds[k]).clone(), cov;
+            trackers[k].predictCovariance(miliseconds[k], cov);
+            for(int p = 0; p < MEAS; p++) {
+                ASSERT_NEAR(pred.at<float>(p), boxes[p * n + k], 1e-4f * (1 + fabs(pred.at<float>(p))));
+                ASSERT_NEAR(cov.at<float>(p, p), variances[p * n + k], 1e-4f * (1 + cov.at<float>(p, p)));
+            }
+        }
+        
+        // Trajectories (several times per filter)
+        for(int i = 0; i < n * m; i++) {
+            miliseconds[i] = rand() % 1000;
+            times[i] = miliseconds[i] / 1000.0;
+        }
+        bank.predictTrajectories(&slots[0], &times[0], n, m, &trajectories[0], &trajectoryVariances[0]);
+        for(int k = 0; k < n; k++) {
+            for(int j = 0; j < m; j++) {
+                int64 ms = miliseconds[k * m + j];
+                cv::Mat pred = trackers[k].predict(ms).clone(), cov;
+                trackers[k].predictCovariance(ms, cov);
+                for(int p = 0; p < MEAS; p++) {
+                    float box = trajectories[(k * m + j) * MEAS + p];
+                    float variance = trajectoryVariances[(k * m + j) * MEAS + p];
+                    ASSERT_NEAR(pred.at<float>(p), box, 1e-4f * (1 + fabs(pred.at<float>(p))));
+                    ASSERT_NEAR(cov.at<float>(p, p), variance, 1e-4f * (1 + cov.at<float>(p, p)));
+                }
+            }
+        }
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
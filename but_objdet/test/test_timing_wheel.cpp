@@ -0,0 +1,373 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/tracker/timing_wheel.h"
+
+using namespace but_objdet;
+using namespace std;
+
+// Number of slots of the tracks
+const int SLOTS = 100;
+
+// The longest step of time (in ticks) which the wheel goes tick by tick
+// (longer jumps reschedule all the timers)
+const int64 MAX_STEP = 64 * 64;
+
+// The longest walk to the next deadline (covers the ranges of level 2
+// and some of level 3)
+const int64 MAX_WALK = 1 << 21;
+
+
+/**
+ * The timers kept in a plain array: a timer fires in the first tick starting
+ * at its deadline or later, but at least one tick after the tick in which
+ * it was scheduled. If the time jumps back (or it is advanced for the first
+ * time), the timers whose deadline has passed fire at once.
+ */
+class WheelModel
+{
+public:
+    WheelModel(int64 res) : resolution(res), current(0), started(false), timers(SLOTS) {}
+
+    void schedule(const TrackHandle &track, int64 deadline)
+    {
+        Timer &timer = timers[track.slot];
+        timer.scheduled = true;
+        timer.generation = track.generation;
+        timer.deadline = deadline;
+        timer.fireTick = max(tickOf(deadline), current + 1);
+    }
+
+    void cancel(const TrackHandle &track)
+    {
+        if(timers[track.slot].generation == track.generation) {
+            timers[track.slot].scheduled = false;
+        }
+    }
+
+    void advance(int64 now, vector<TrackHandle> &expired)
+    {
+        int64 nowTick = floorDiv(now, resolution);
+        bool reset = !started || nowTick < current;
+        for(int slot = 0; slot < SLOTS; slot++) {
+            Timer &timer = timers[slot];
+            if(!timer.scheduled) continue;
+            if(reset ? timer.deadline <= now : timer.fireTick <= nowTick) {
+                timer.scheduled = false;
+                expired.push_back(TrackHandle(slot, timer.generation));
+            }
+            else if(reset) {
+                timer.fireTick = tickOf(timer.deadline);
+            }
+        }
+        current = nowTick;
+        started = true;
+    }
+
+    int size() const
+    {
+        int n = 0;
+        for(int slot = 0; slot < SLOTS; slot++) {
+            n += timers[slot].scheduled;
+        }
+        return n;
+    }
+
+    /**
+     * The first tick in which a timer fires (-1 if none is scheduled).
+     */
+    int64 nextTick() const
+    {
+        int64 next = -1;
+        for(int slot = 0; slot < SLOTS; slot++) {
+            if(timers[slot].scheduled && (next == -1 || timers[slot].fireTick < next)) {
+                next = timers[slot].fireTick;
+            }
+        }
+        return next;
+    }
+
+    static int64 floorDiv(int64 a, int64 b)
+    {
+        return (a >= 0) ? a / b : -((-a + b - 1) / b);
+    }
+
+    int64 tickOf(int64 deadline) const { return -floorDiv(-deadline, resolution); }
+
+private:
+    struct Timer
+    {
+        Timer() : scheduled(false), generation(0), deadline(0), fireTick(0) {}
+        bool scheduled;
+        unsigned int generation;
+        int64 deadline, fireTick;
+    };
+
+    int64 resolution, current;
+    bool started;
+    vector<Timer> timers;
+};
+
+/* -----------------------------------------------------------------------------
+ * Random 64-bit number in [0, n)
+ */
+static int64 random64(int64 n)
+{
+    int64 r = ((int64)rand() << 31) ^ rand();
+    return r % n;
+}
+
+/* -----------------------------------------------------------------------------
+ * Random delay (in ticks) of a deadline: due in the past, in the range
+ * of one of the levels of the wheel or beyond its range (2^24 ticks)
+ */
+static int64 randomDelay()
+{
+    int level = rand() % 6;
+    if(level == 0) {
+        return -random64(100);
+    }
+    return random64((int64)1 << min(6 * level, 26));
+}
+
+/* -----------------------------------------------------------------------------
+ * Order of handles by their slots
+ */
+static bool bySlot(const TrackHandle &a, const TrackHandle &b)
+{
+    return a.slot < b.slot;
+}
+
+/* -----------------------------------------------------------------------------
+ * Advances the wheel and the model and compares the expired timers
+ */
+static void advanceBoth(TimingWheel &wheel, WheelModel &model, int64 now)
+{
+    vector<TrackHandle> expected, expired;
+    model.advance(now, expected);
+    wheel.advance(now, expired);
+    
+    sort(expired.begin(), expired.end(), bySlot);
+    ASSERT_EQ(expected.size(), expired.size()) << "now " << now;
+    for(unsigned int k = 0; k < expired.size(); k++) {
+        ASSERT_EQ(expected[k].slot, expired[k].slot);
+        ASSERT_EQ(expected[k].generation, expired[k].generation);
+    }
+    ASSERT_EQ(model.size(), wheel.size());
+}
+
+/* -----------------------------------------------------------------------------
+ * Runs random operations with the wheel and the model
+ */
+static void compareWithModel(int64 resolution, unsigned int seed)
+{
+    TimingWheel wheel(resolution);
+    WheelModel model(resolution);
+    vector<unsigned int> generations(SLOTS, 0);
+    srand(seed);
+    int64 now = random64(1000000) - 500000;
+    
+    for(int i = 0; i < 5000; i++) {
+        int slot = rand() % SLOTS;
+        int op = rand() % 100;
+        
+        // Schedule or reschedule the timer of the current track in the slot
+        if(op < 40) {
+            TrackHandle track(slot, generations[slot]);
+            int64 deadline = now + randomDelay() * resolution + rand() % resolution;
+            model.schedule(track, deadline);
+            wheel.schedule(track, deadline);
+            ASSERT_EQ(model.size(), wheel.size());
+        }
+        
+        // Cancel the timer of the current or of an older track
+        else if(op < 50) {
+            TrackHandle track(slot, generations[slot] - rand() % 2);
+            model.cancel(track);
+            wheel.cancel(track);
+            ASSERT_EQ(model.size(), wheel.size());
+        }
+        
+        // A new track in the slot (the old timer still runs)
+        else if(op < 55) {
+            generations[slot]++;
+        }
+        
+        // Time goes on
+        else if(op < 90) {
+            now += random64(MAX_STEP * resolution);
+            ASSERT_NO_FATAL_FAILURE(advanceBoth(wheel, model, now));
+        }
+        
+        // Time goes on to the next deadline (tick by tick through the levels,
+        // at most MAX_WALK ticks)
+        else if(op < 95) {
+            int64 next = model.nextTick();
+            int64 end = min(next, WheelModel::floorDiv(now, resolution) + MAX_WALK) * resolution;
+            while(next != -1 && now < end) {
+                now = min(end, now + MAX_STEP * resolution);
+                ASSERT_NO_FATAL_FAILURE(advanceBoth(wheel, model, now));
+            }
+        }
+        
+        // Time jumps back or far forward (to a whole tick, where the jump
+        // gives the same timers as going tick by tick)
+        else {
+            if(rand() % 2) {
+                now -= random64((int64)1 << 30) * resolution + rand() % resolution;
+            }
+            else {
+                now = (WheelModel::floorDiv(now, resolution) + MAX_STEP + random64((int64)1 << 30)) * resolution;
+            }
+            ASSERT_NO_FATAL_FAILURE(advanceBoth(wheel, model, now));
+        }
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * The timers fire in the same ticks as in a plain array
+ */
+TEST(TimingWheel, RandomizedAgainstModel)
+{
+    compareWithModel(1, 1);
+    compareWithModel(10, 2);
+    compareWithModel(33, 3);
+}
+
+/* -----------------------------------------------------------------------------
+ * A timer fires in its tick, a rescheduled timer fires only at the new
+ * deadline and a canceled one never (also if it was scheduled before
+ * the first advance)
+ */
+TEST(TimingWheel, ScheduleCancelReschedule)
+{
+    TimingWheel wheel(10);
+    vector<TrackHandle> expired;
+    TrackHandle a(0, 1), b(1, 1), c(2, 1);
+    
+    wheel.schedule(a, 15);
+    wheel.schedule(b, 5);
+    wheel.schedule(c, 100000);
+    wheel.advance(0, expired);
+    EXPECT_TRUE(expired.empty());
+    EXPECT_EQ(3, wheel.size());
+    
+    wheel.advance(10, expired);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_TRUE(expired[0] == b);
+    
+    // Reschedule a later, its old deadline passes
+    expired.clear();
+    wheel.schedule(a, 2000);
+    wheel.advance(25, expired);
+    EXPECT_TRUE(expired.empty());
+    
+    // A canceled timer of an older track does not cancel the new one
+    wheel.cancel(TrackHandle(0, 0));
+    EXPECT_EQ(2, wheel.size());
+    wheel.cancel(c);
+    EXPECT_EQ(1, wheel.size());
+    
+    wheel.advance(1999, expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(2000, expired);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_TRUE(expired[0] == a);
+    
+    expired.clear();
+    wheel.advance(200000, expired);
+    EXPECT_TRUE(expired.empty());
+    EXPECT_EQ(0, wheel.size());
+}
+
+/* -----------------------------------------------------------------------------
+ * Timers beyond the range of the wheel (2^24 ticks) fire in their ticks
+ * when the time goes on step by step
+ */
+TEST(TimingWheel, BeyondRange)
+{
+    TimingWheel wheel(1);
+    WheelModel model(1);
+    const int64 range = (int64)1 << 24;
+    ASSERT_NO_FATAL_FAILURE(advanceBoth(wheel, model, 7));
+    
+    int64 deadlines[] = {range - 1, range, range + 7, range + 5000, 2 * range + 123, 3 * range};
+    for(int k = 0; k < 6; k++) {
+        wheel.schedule(TrackHandle(k, 0), deadlines[k]);
+        model.schedule(TrackHandle(k, 0), deadlines[k]);
+    }
+    
+    for(int64 now = 7; now < 3 * range + MAX_STEP; ) {
+        now += MAX_STEP - rand() % 10;
+        ASSERT_NO_FATAL_FAILURE(advanceBoth(wheel, model, now));
+    }
+    EXPECT_EQ(0, wheel.size());
+}
+
+/* -----------------------------------------------------------------------------
+ * When the time jumps back, the timers due at the new time fire and the
+ * others are kept for their deadlines
+ */
+TEST(TimingWheel, TimeGoesBack)
+{
+    TimingWheel wheel(1);
+    vector<TrackHandle> expired;
+    wheel.advance(1000, expired);
+    wheel.schedule(TrackHandle(0, 0), 1010);
+    wheel.schedule(TrackHandle(1, 0), 1500);
+    
+    wheel.advance(1005, expired);
+    EXPECT_TRUE(expired.empty());
+    
+    wheel.advance(0, expired);
+    EXPECT_TRUE(expired.empty());
+    EXPECT_EQ(2, wheel.size());
+    
+    wheel.advance(1010, expired);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_EQ(0, expired[0].slot);
+    
+    // Back behind the remaining deadline
+    expired.clear();
+    wheel.advance(2000, expired);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_EQ(1, expired[0].slot);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
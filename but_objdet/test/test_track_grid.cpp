@@ -0,0 +1,187 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/tracker/track_grid.h"
+
+using namespace but_objdet;
+using namespace std;
+
+
+/**
+ * An object of the reference set.
+ */
+struct RefObject
+{
+    bool added;
+    int objClass;
+    int id;
+    cv::Rect box;
+};
+
+/* -----------------------------------------------------------------------------
+ * Objects satisfying a query found by a scan of all the objects
+ * (pairs of the distance and the slot)
+ */
+static void bruteForce(const vector<RefObject> &objects, const GridQuery &query, int objClass,
+                       const vector<int> *ids, vector<pair<float, int> > &found)
+{
+    found.clear();
+    for(unsigned int s = 0; s < objects.size(); s++) {
+        const RefObject &obj = objects[s];
+        if(!obj.added || (objClass != -1 && obj.objClass != objClass) ||
+           (ids != NULL && !binary_search(ids->begin(), ids->end(), obj.id))) {
+            continue;
+        }
+        
+        const cv::Rect &b = obj.box;
+        float dx = b.x + b.width / 2.0f - query.x;
+        float dy = b.y + b.height / 2.0f - query.y;
+        float dist = sqrt(dx * dx + dy * dy);
+        if(query.type == GridQuery::NONE || query.type == GridQuery::NEAREST) {
+            found.push_back(make_pair(query.type == GridQuery::NONE ? 0 : dist, (int)s));
+        }
+        else if(query.type == GridQuery::ROI) {
+            const cv::Rect &roi = query.roi;
+            if(b.x < roi.x + roi.width && roi.x < b.x + b.width &&
+               b.y < roi.y + roi.height && roi.y < b.y + b.height) {
+                found.push_back(make_pair(0.0f, (int)s));
+            }
+        }
+        else if(dist <= query.radius) {
+            found.push_back(make_pair(dist, (int)s));
+        }
+    }
+    
+    if(query.type == GridQuery::NEAREST) {
+        sort(found.begin(), found.end());
+        found.resize(min((int)found.size(), query.k));
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Random insertions, moves and removals, each 100th operation is followed
+ * by a random query compared with the brute force
+ */
+TEST(TrackGrid, RandomizedAgainstBruteForce)
+{
+    TrackGrid grid(32);
+    vector<RefObject> objects(3000);
+    for(unsigned int s = 0; s < objects.size(); s++) {
+        objects[s].added = false;
+    }
+    srand(3);
+    
+    for(int i = 0; i < 200000; i++) {
+        int s = rand() % objects.size();
+        int large = (rand() % 8 == 0) ? 200 : 40; // Some boxes larger than a cell
+        cv::Rect box(rand() % 2000 - 500, rand() % 2000 - 500, rand() % large, rand() % large);
+        
+        int op = rand() % 10;
+        if(op < 4) {
+            objects[s].added = true;
+            objects[s].objClass = rand() % 4;
+            objects[s].id = rand() % 50;
+            objects[s].box = box;
+            grid.insert(s, objects[s].objClass, objects[s].id, box);
+        }
+        else if(op < 7) {
+            if(objects[s].added) {
+                objects[s].box = box;
+                grid.move(s, box);
+            }
+        }
+        else if(op < 9) {
+            objects[s].added = false;
+            grid.remove(s);
+        }
+        
+        if(i % 100 != 0) {
+            continue;
+        }
+        
+        GridQuery query;
+        query.type = (rand() % 20 == 0) ? GridQuery::NONE : 1 + rand() % 3;
+        query.roi = cv::Rect(rand() % 2000 - 500, rand() % 2000 - 500, rand() % 400, rand() % 400);
+        query.x = rand() % 3000 - 1000;
+        query.y = rand() % 3000 - 1000;
+        query.radius = rand() % 300;
+        query.k = 1 + rand() % 20;
+        int objClass = rand() % 5 - 1;
+        
+        vector<int> ids;
+        if(rand() % 2) {
+            for(int n = rand() % 5; n >= 0; n--) {
+                ids.push_back(rand() % 50);
+            }
+            sort(ids.begin(), ids.end());
+        }
+        const vector<int> *idFilter = ids.empty() ? NULL : &ids;
+        
+        vector<int> slots;
+        vector<float> distances;
+        grid.query(query, objClass, slots, distances, idFilter);
+        vector<pair<float, int> > expected;
+        bruteForce(objects, query, objClass, idFilter, expected);
+        
+        ASSERT_EQ(expected.size(), slots.size());
+        ASSERT_EQ(slots.size(), distances.size());
+        if(query.type == GridQuery::NEAREST) {
+            // The same distances (the objects at equal distances can differ)
+            for(unsigned int j = 0; j < slots.size(); j++) {
+                ASSERT_NEAR(expected[j].first, distances[j], 1e-3);
+            }
+        }
+        else {
+            set<int> found(slots.begin(), slots.end()), reference;
+            for(unsigned int j = 0; j < expected.size(); j++) {
+                reference.insert(expected[j].second);
+            }
+            ASSERT_TRUE(found == reference);
+        }
+    }
+    
+    int count = 0;
+    for(unsigned int s = 0; s < objects.size(); s++) {
+        count += objects[s].added ? 1 : 0;
+    }
+    EXPECT_EQ(count, grid.size());
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,403 @@
+/******************************************************************************
+ * \file
+ *
+ * $Id:$
+ *
+ * Copyright (C) Brno University of Technology
+ *
+ * This file is part of software developed by dcgm-robotics@FIT group.
+ *
+ * Supervised by: Vitezslav Beran (beranv@fit.vutbr.cz), Michal Spanel (spanel@fit.vutbr.cz)
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "but_objdet/tracker/track_shard.h"
+
+using namespace but_objdet;
+using namespace std;
+
+
+/**
+ * A detection of an object at some time (sent in a message of its own).
+ */
+struct Sample
+{
+    int id;
+    int64 time;
+    cv::Rect box;
+};
+
+/**
+ * A shard with the numbers and the latest stamp of the messages it processed.
+ */
+struct Stream
+{
+    Stream(int ttl) : shard(ttl, 1000000), msgCount(0), latestTime(0) {}
+    
+    TrackShard shard; // Expiration by time far beyond the trajectories
+    int64 msgCount, latestTime;
+};
+
+/* -----------------------------------------------------------------------------
+ * Processes the samples in the given order (each in one message)
+ */
+static void feed(Stream &stream, const vector<Sample> &samples)
+{
+    for(unsigned int i = 0; i < samples.size(); i++) {
+        but_objdet_msgs::Detection det;
+        det.m_id = samples[i].id;
+        det.m_class = 0;
+        det.m_bb.x = samples[i].box.x;
+        det.m_bb.y = samples[i].box.y;
+        det.m_bb.width = samples[i].box.width;
+        det.m_bb.height = samples[i].box.height;
+        
+        vector<const but_objdet_msgs::Detection *> detections(1, &det);
+        stream.latestTime = max(stream.latestTime, samples[i].time);
+        stream.shard.process(detections, samples[i].time, ++stream.msgCount, stream.latestTime, false);
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Random trajectory of an object (samples sorted by time, no equal times)
+ */
+static void randomTrajectory(int id, int n, vector<Sample> &samples)
+{
+    int64 time = 1000000000 + (int64)(rand() % 1000) * 1000000;
+    cv::Rect box(rand() % 600, rand() % 400, 20 + rand() % 100, 20 + rand() % 100);
+    int vx = rand() % 11 - 5, vy = rand() % 11 - 5;
+    for(int k = 0; k < n; k++) {
+        Sample sample;
+        sample.id = id;
+        sample.time = time;
+        sample.box = box;
+        sample.box.x += rand() % 5 - 2;
+        sample.box.y += rand() % 5 - 2;
+        samples.push_back(sample);
+        
+        int64 ms = 10 + rand() % 50;
+        time += ms * 1000000;
+        box.x += vx * ms / 10;
+        box.y += vy * ms / 10;
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Snapshot of the filter of a stored detection
+ */
+static vector<float> filterOf(const TrackShard &shard, int id)
+{
+    vector<float> filter(KalmanBank::VALUES);
+    shard.filters().save(shard.tracks().find(0, id)->slot, &filter[0]);
+    return filter;
+}
+
+/* -----------------------------------------------------------------------------
+ * Value of a computed prediction (different for each slot, version, time
+ * and value)
+ */
+static float predicted(const TrackView &view, int64 reqTime, int p)
+{
+    return view.slot * 1000 + view.version * 10 + reqTime + p * 0.25f;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * The buffer against a sorted vector of the kept times: the positions,
+ * the times, the measurements and the rejection of the late measurements
+ */
+TEST(ReplayBuffer, InsertAgainstSortedVector)
+{
+    typedef ReplayBuffer<8, 2, 1> Buffer;
+    
+    srand(1);
+    for(int round = 0; round < 200; round++) {
+        Buffer buffer;
+        vector<pair<int64, float> > kept; // Times and measurements (sorted, stable)
+        
+        for(int i = 0; i < 100; i++) {
+            int64 t = (rand() % 3 == 0) ? rand() % 10 : rand() % 1000; // Some equal times
+            float measurement[2] = { (float)i, (float)t };
+            
+            int expected = upper_bound(kept.begin(), kept.end(), make_pair(t, 1e9f)) - kept.begin();
+            if(!kept.empty() && (expected == 0 || (kept.size() == 8 && expected == 1))) {
+                expected = -1;
+            }
+            else {
+                kept.insert(kept.begin() + expected, make_pair(t, (float)i));
+                if(kept.size() > 8) {
+                    kept.erase(kept.begin());
+                    expected--;
+                }
+            }
+            
+            ASSERT_EQ(expected, buffer.insert(t, measurement));
+            ASSERT_EQ((int)kept.size(), buffer.size());
+            for(int k = 0; k < buffer.size(); k++) {
+                ASSERT_EQ(kept[k].first, buffer.time(k));
+                ASSERT_EQ(kept[k].second, buffer.measurement(k)[0]);
+                ASSERT_EQ((float)kept[k].first, buffer.measurement(k)[1]);
+            }
+        }
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Measurements shuffled within the capacity of the histories (the first
+ * measurement of each object comes first) give the same filters as
+ * the measurements in order
+ */
+TEST(TrackShard, OutOfOrderSameAsInOrder)
+{
+    srand(2);
+    for(int round = 0; round < 50; round++) {
+        int objects = 1 + rand() % 5;
+        vector<Sample> inOrder, shuffled;
+        for(int id = 0; id < objects; id++) {
+            vector<Sample> samples;
+            randomTrajectory(id, 40, samples);
+            
+            // Blocks of 4 after the first measurement: the preceding
+            // measurement of a late one is always among the 8 kept ones
+            vector<Sample> late(samples);
+            for(int k = 1; k < (int)late.size(); k += 4) {
+                random_shuffle(late.begin() + k, late.begin() + min((int)late.size(), k + 4));
+            }
+            
+            // Interleaved with the other objects
+            int inPos = 0, latePos = 0;
+            for(unsigned int k = 0; k < samples.size(); k++) {
+                inPos += 1 + rand() % (inOrder.size() - inPos + 1);
+                latePos += 1 + rand() % (shuffled.size() - latePos + 1);
+                inOrder.insert(inOrder.begin() + inPos - 1, samples[k]);
+                shuffled.insert(shuffled.begin() + latePos - 1, late[k]);
+            }
+        }
+        
+        Stream expected(1000000), actual(1000000);
+        feed(expected, inOrder);
+        feed(actual, shuffled);
+        
+        ASSERT_EQ(objects, actual.shard.tracks().size());
+        for(int id = 0; id < objects; id++) {
+            const DetM &e = *expected.shard.tracks().find(0, id);
+            const DetM &a = *actual.shard.tracks().find(0, id);
+            EXPECT_EQ(e.nsTime, a.nsTime);
+            EXPECT_EQ(e.det.m_bb.x, a.det.m_bb.x);
+            EXPECT_EQ(e.det.m_bb.y, a.det.m_bb.y);
+            ASSERT_EQ(e.history.size(), a.history.size());
+            for(int k = 0; k < e.history.size(); k++) {
+                EXPECT_EQ(e.history.time(k), a.history.time(k));
+            }
+            
+            vector<float> filterE = filterOf(expected.shard, id), filterA = filterOf(actual.shard, id);
+            for(int v = 0; v < KalmanBank::VALUES; v++) {
+                EXPECT_NEAR(filterE[v], filterA[v], 1e-4 * (1 + fabs(filterE[v])))
+                    << "round " << round << ", object " << id << ", value " << v;
+            }
+        }
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Measurements older than the second oldest one of a full history (or than
+ * the oldest one of a history which is not full) are ignored
+ */
+TEST(TrackShard, TooLateIgnored)
+{
+    srand(3);
+    vector<Sample> samples;
+    randomTrajectory(0, 8, samples);
+    
+    Stream stream(1000000);
+    const TrackShard &shard = stream.shard;
+    feed(stream, vector<Sample>(samples.begin(), samples.begin() + 3));
+    
+    // Older than the oldest one
+    Sample sample = samples[0];
+    sample.time--;
+    int64 version = shard.tracks().find(0, 0)->version;
+    vector<float> filter = filterOf(shard, 0);
+    feed(stream, vector<Sample>(1, sample));
+    EXPECT_EQ(version, shard.tracks().find(0, 0)->version);
+    EXPECT_EQ(3, shard.tracks().find(0, 0)->history.size());
+    EXPECT_TRUE(filter == filterOf(shard, 0));
+    
+    // The history is full, between the oldest and the second oldest one
+    feed(stream, vector<Sample>(samples.begin() + 3, samples.end()));
+    sample.time = samples[0].time + 1;
+    version = shard.tracks().find(0, 0)->version;
+    filter = filterOf(shard, 0);
+    feed(stream, vector<Sample>(1, sample));
+    EXPECT_EQ(version, shard.tracks().find(0, 0)->version);
+    EXPECT_EQ(samples[0].time, shard.tracks().find(0, 0)->history.time(0));
+    EXPECT_TRUE(filter == filterOf(shard, 0));
+    
+    // After the second oldest one => assimilated (the oldest one is dropped)
+    sample.time = samples[1].time + 1;
+    feed(stream, vector<Sample>(1, sample));
+    EXPECT_NE(version, shard.tracks().find(0, 0)->version);
+    EXPECT_EQ(samples[1].time, shard.tracks().find(0, 0)->history.time(0));
+    EXPECT_EQ(samples[7].time, shard.tracks().find(0, 0)->nsTime);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Repeated requests for the same time are hits, a request for another time,
+ * an updated detection and a new detection in a recycled slot are misses
+ */
+TEST(PredictionCache, HitsAndMisses)
+{
+    enum { MEAS = KalmanBank::MEAS };
+    
+    srand(4);
+    PredictionCache cache;
+    vector<TrackView> views(40);
+    int64 version = 0;
+    for(unsigned int s = 0; s < views.size(); s++) {
+        views[s].slot = s;
+        views[s].version = ++version;
+    }
+    cache.resize(views.size());
+    
+    // Slot -> the stored time and version (-1 = nothing stored)
+    vector<pair<int64, int64> > stored(views.size(), make_pair((int64)-1, (int64)-1));
+    int64 hits = 0, misses = 0;
+    
+    for(int round = 0; round < 2000; round++) {
+        int op = rand() % 10;
+        
+        // A detection is updated
+        if(op == 0) {
+            views[rand() % views.size()].version = ++version;
+        }
+        
+        // A detection expires and a new one gets its slot
+        else if(op == 1) {
+            int s = rand() % views.size();
+            views[s].det.m_id = rand();
+            views[s].version = ++version;
+        }
+        
+        // New slots (the existing entries are kept)
+        else if(op == 2 && views.size() < 100) {
+            views.resize(views.size() + 1);
+            views.back().slot = views.size() - 1;
+            views.back().version = ++version;
+            stored.push_back(make_pair((int64)-1, (int64)-1));
+            cache.resize(views.size());
+        }
+        
+        // A request for a few times (repeated ones are likely)
+        int64 reqTime = rand() % 3;
+        vector<const TrackView *> tracks;
+        for(unsigned int s = 0; s < views.size(); s++) {
+            if(rand() % 2) {
+                tracks.push_back(&views[s]);
+            }
+        }
+        if(tracks.empty()) {
+            continue;
+        }
+        
+        vector<int> expected;
+        for(unsigned int k = 0; k < tracks.size(); k++) {
+            if(stored[tracks[k]->slot] != make_pair(reqTime, tracks[k]->version)) {
+                expected.push_back(k);
+            }
+        }
+        
+        vector<float> boxes(MEAS * tracks.size(), -1), variances(MEAS * tracks.size(), -1);
+        vector<int> missing;
+        cache.lookup(tracks, reqTime, &boxes[0], &variances[0], missing);
+        ASSERT_EQ(expected, missing) << "round " << round;
+        
+        // The found predictions are the stored ones, the missing
+        // ones are computed and stored
+        unsigned int m = 0;
+        for(unsigned int k = 0; k < tracks.size(); k++) {
+            bool found = (m == missing.size() || missing[m] != (int)k);
+            for(int p = 0; p < MEAS; p++) {
+                if(found) {
+                    ASSERT_EQ(predicted(*tracks[k], reqTime, p), boxes[k * MEAS + p]);
+                    ASSERT_EQ(-predicted(*tracks[k], reqTime, p), variances[k * MEAS + p]);
+                }
+                boxes[k * MEAS + p] = predicted(*tracks[k], reqTime, p);
+                variances[k * MEAS + p] = -predicted(*tracks[k], reqTime, p);
+            }
+            if(!found) {
+                stored[tracks[k]->slot] = make_pair(reqTime, tracks[k]->version);
+                m++;
+            }
+        }
+        cache.store(tracks, missing, reqTime, &boxes[0], &variances[0]);
+        
+        hits += tracks.size() - missing.size();
+        misses += missing.size();
+        ASSERT_EQ(hits, cache.hits());
+        ASSERT_EQ(misses, cache.misses());
+    }
+    
+    EXPECT_GT(hits, 10000);
+    EXPECT_GT(misses, 10000);
+}
+
+/* -----------------------------------------------------------------------------
+ * The cache relies on the versions of the shard: an updated detection
+ * and a new detection in a recycled filter slot get new versions
+ */
+TEST(PredictionCache, VersionsChangeWithSlots)
+{
+    srand(5);
+    vector<Sample> samples;
+    randomTrajectory(0, 2, samples);
+    randomTrajectory(1, 1, samples);
+    randomTrajectory(2, 1, samples);
+    
+    // Expiration after 1 message without the detection
+    Stream stream(1);
+    const TrackShard &shard = stream.shard;
+    feed(stream, vector<Sample>(samples.begin(), samples.begin() + 1));
+    int slot = shard.tracks().find(0, 0)->slot;
+    int64 version = shard.tracks().find(0, 0)->version;
+    
+    feed(stream, vector<Sample>(samples.begin() + 1, samples.begin() + 2));
+    EXPECT_EQ(slot, shard.tracks().find(0, 0)->slot);
+    EXPECT_NE(version, shard.tracks().find(0, 0)->version);
+    version = shard.tracks().find(0, 0)->version;
+    
+    // Object 0 expires by the message of object 1, object 2 gets its slot
+    feed(stream, vector<Sample>(samples.begin() + 2, samples.begin() + 3));
+    ASSERT_TRUE(shard.tracks().find(0, 0) == NULL);
+    feed(stream, vector<Sample>(samples.begin() + 3, samples.end()));
+    EXPECT_EQ(slot, shard.tracks().find(0, 2)->slot);
+    EXPECT_GT(shard.tracks().find(0, 2)->version, version);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -30,11 +30,13 @@
 #ifndef _SAMPLE_DETECTOR_NODE_
 #define _SAMPLE_DETECTOR_NODE_
 
+#include <deque>
 #include <ros/ros.h> // Main header of ROS
 #include <sensor_msgs/Image.h>
 
 #include "but_objdet/but_objdet.h"
-#include "but_objdet/matcher/matcher_overlap.h"
+#include "but_objdet/matcher/matcher_hungarian.h"
+#include "but_objdet_msgs/DetectionArray.h"
 #include "but_sample_detector/sample_detector.h"
 
 
@@ -55,13 +57,24 @@ private:
 
 	void newDataCallback(const sensor_msgs::ImageConstPtr &image);
 
+	void newPredictionsCallback(const but_objdet_msgs::DetectionArrayConstPtr &predArray);
+
+	/**
+	 * Finds the received predictions for an image (the ones with the same stamp
+	 * or, if they did not come yet, the newest older ones not older than
+	 * maxPredictionAge).
+	 * @param stamp  Stamp of the image.
+	 * @return  The predictions (NULL if there are none).
+	 */
+	but_objdet_msgs::DetectionArrayConstPtr findPredictions(const ros::Time &stamp);
+
 	int getNewObjectID();
 
 	but_objdet::Objects detections; // Current detections
 	but_objdet::Objects predictions; // Current predictions
 
 	but_sample_detector::SampleDetector *sampleDetector; // Detector
-	but_objdet::MatcherOverlap *matcherOverlap; // Matcher
+	but_objdet::MatcherHungarian *matcher; // Matcher
 
 	ros::NodeHandle nh; // NodeHandle is the main access point for communication with ROS system
 
@@ -69,8 +82,12 @@ private:
 	
 	ros::Publisher detectionsPub; // Publisher of detections
 	
-	ros::ServiceClient predictClient; // Client for comunication with tracker
-									  // (using PredictDetections service)
+	ros::Subscriber predictionsSub; // Predictions published by tracker for each image
+
+	// The last received predictions (ordered by their stamps)
+	std::deque<but_objdet_msgs::DetectionArrayConstPtr> predictionCache;
+
+	ros::Duration maxPredictionAge; // Maximal age of the used predictions
 
 	int lastObjectID; // Last assigned object ID
 };
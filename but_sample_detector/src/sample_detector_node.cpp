@@ -36,10 +36,9 @@
 
 // ObjDet API
 #include "but_objdet/but_objdet.h" // Main objects of ObjDet API
-#include "but_objdet/services_list.h" // Names of services provided by but_objdet package
+#include "but_objdet/services_list.h" // Names of services and topics provided by but_objdet package
 #include "but_objdet/convertor/convertor.h" // Translator from but_objdet messages to standard C++ structures
-#include "but_objdet/matcher/matcher_overlap.h" // Matcher (based on overlap)
-#include "but_objdet/PredictDetections.h" // Autogenerated service class
+#include "but_objdet/matcher/matcher_hungarian.h" // Matcher (one-to-one, based on overlap)
 #include "but_objdet_msgs/DetectionArray.h" // Message transfering detections/predictions
 
 #include "but_sample_detector/sample_detector_node.h"
@@ -56,6 +55,9 @@ using namespace but_objdet_msgs;
 const string imageTopic = "/camera/rgb/image_color";
 const string detectionTopic = "/but_objdet/detections";
 
+// Number of the last received predictions kept for the images
+const unsigned int predictionCacheSize = 8;
+
 
 namespace but_sample_detector
 {
@@ -66,7 +68,7 @@ namespace but_sample_detector
 SampleDetectorNode::SampleDetectorNode()
 {   
     sampleDetector = new but_sample_detector::SampleDetector(); // Detector
-    matcherOverlap = new but_objdet::MatcherOverlap(); // Matcher
+    matcher = new but_objdet::MatcherHungarian(); // Matcher
     
     // Create a window to show the incoming video and set its mouse event handler
     if(VISUAL_OUTPUT) {
@@ -83,7 +85,7 @@ SampleDetectorNode::SampleDetectorNode()
 SampleDetectorNode::~SampleDetectorNode()
 {
     delete sampleDetector;
-    delete matcherOverlap;
+    delete matcher;
 }
 
 
@@ -92,9 +94,12 @@ SampleDetectorNode::~SampleDetectorNode()
  */
 void SampleDetectorNode::rosInit()
 {
-    // Create a client for the service for predictions of detections
-    // (the name of the service is defined in but_objdet/services_list.h)
-    predictClient = nh.serviceClient<but_objdet::PredictDetections>(BUT_OBJDET_PredictDetections_SRV);
+    // Subscribe to the topic with predictions of detections, which tracker
+    // publishes for each image (the name of the topic is defined
+    // in but_objdet/services_list.h). The predictions can be also obtained
+    // by the PredictDetections service (for any time), but then each image
+    // waits for a call of the service.
+    predictionsSub = nh.subscribe(BUT_OBJDET_Predictions_TOPIC, 10, &SampleDetectorNode::newPredictionsCallback, this);
 
     // Advertise that this node is going to publish on the specified topic
     // (the second argument is the size of publishing queue)
@@ -104,6 +109,12 @@ void SampleDetectorNode::rosInit()
     // detector, you can subscribe to any other topics)
     dataSub = nh.subscribe(imageTopic, 10, &SampleDetectorNode::newDataCallback, this);
     
+    // Maximal age of the predictions used for an image (in seconds, older
+    // ones are not used)
+    double maxAge;
+    ros::param::param<double>("~max_prediction_age", maxAge, 0.5);
+    maxPredictionAge = ros::Duration(maxAge);
+    
     // Inform that the detector is running (it will be written into console)
     ROS_INFO("Sample detector is running...");
 }
@@ -126,38 +137,19 @@ void SampleDetectorNode::newDataCallback(const sensor_msgs::ImageConstPtr &image
         return;
     }
     
-    // 1) Obtain predictions from tracker via service
+    // 1) Obtain predictions from tracker (received on the topic)
     //--------------------------------------------------------------------------
-    // When using simulated Clock time, now() returns time 0 until first message
-    // has been received on /clock topic => wait for that.
-    ros::Time reqTime;
-    do {
-        reqTime = ros::Time::now();
-    } while(reqTime.sec == 0);
-    
-    // Instance of the autogenerated service class providing service
-	// for prediction of detections
-	but_objdet::PredictDetections predictSrv;
-
-    // Create a request
-    // (in this example, class_id nor object_id is specified, so predictions
-    // for all detections is returned)
-    //---------------------------------
-    predictSrv.request.header.stamp = reqTime;
-    predictSrv.request.object_id = -1;
-    predictSrv.request.class_id = -1;
-    
-    // Send request to tracker (ROS node) to obtain predictions
-    // (using PredictDetections service)
-    //---------------------------------
-    // Call the service (calls are blocking, it returns once the call is done)
-    if(predictClient.call(predictSrv)) {
+    // Tracker publishes predictions for the stamp of each image. If they did
+    // not come yet for this image, the ones for the previous image are used
+    // (intentionally, the detection does not wait for them), unless they are
+    // older than max_prediction_age.
+    DetectionArrayConstPtr predArray = findPredictions(imageMsg->header.stamp);
+    if(predArray) {
         // Translate Detection msgs to butObjects
-        predictions = Convertor::detectionsToButObjects(predictSrv.response.predictions);
+        predictions = Convertor::detectionsToButObjects(predArray->detections);
     }
     else {
-        std::string errMsg = "Failed to call service " + BUT_OBJDET_PredictDetections_SRV + ".";
-        ROS_ERROR("%s", errMsg.c_str());
+        predictions.clear();
     }
     
     // 2) Provide predictions to detector (so it can consider it during
@@ -170,16 +162,17 @@ void SampleDetectorNode::newDataCallback(const sensor_msgs::ImageConstPtr &image
     sampleDetector->detect(image, Mat(), detections, 0);
     
     // 4) Match detections and predictions
-    // To each detection is assigned the most similar prediction or none, if
-    // there is no prediction, where the overlapping area represents at least
-    // minOverlap% of both, detection BB and prediction BB (BB = Bounding Box).
+    // To each detection is assigned a prediction or none, if there is no
+    // prediction, where the overlapping area represents at least minOverlap%
+    // of both, detection BB and prediction BB (BB = Bounding Box).
     // The assigned prediction must have the same value of m_class (= class ID)
-    // as the detection.
+    // as the detection and each prediction is assigned to one detection at most
+    // (so that the total overlap is maximal), thus no two detections get
+    // the same m_id.
     //--------------------------------------------------------------------------
     Matches matches;
-    matcherOverlap->setMinOverlap(50); // minOverlap = 50%
-    if (detections.size() >= predictions.size())
-        matcherOverlap->match(detections, predictions, matches);
+    matcher->setMinOverlap(50); // minOverlap = 50%
+    matcher->match(detections, predictions, matches);
 
     // 5) Modify m_id and m_class of each detection based on matched prediction
     //--------------------------------------------------------------------------
@@ -220,6 +213,43 @@ void SampleDetectorNode::newDataCallback(const sensor_msgs::ImageConstPtr &image
 }
 
 
+/* -----------------------------------------------------------------------------
+ * Function called when predictions are received from tracker
+ */
+void SampleDetectorNode::newPredictionsCallback(const DetectionArrayConstPtr &predArray)
+{
+    // Keep the predictions ordered by the stamps (they usually come in order)
+    deque<DetectionArrayConstPtr>::iterator it = predictionCache.end();
+    while(it != predictionCache.begin() && (*(it - 1))->header.stamp > predArray->header.stamp) {
+        --it;
+    }
+    predictionCache.insert(it, predArray);
+    
+    if(predictionCache.size() > predictionCacheSize) {
+        predictionCache.pop_front();
+    }
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Finds the received predictions for an image
+ */
+DetectionArrayConstPtr SampleDetectorNode::findPredictions(const ros::Time &stamp)
+{
+    // The newest predictions not newer than the image
+    for(int i = predictionCache.size() - 1; i >= 0; i--) {
+        if(predictionCache[i]->header.stamp <= stamp) {
+            if(stamp - predictionCache[i]->header.stamp > maxPredictionAge) {
+                break;
+            }
+            return predictionCache[i];
+        }
+    }
+    
+    return DetectionArrayConstPtr();
+}
+
+
 /* =============================================================================
  * Generates a new object ID
  */